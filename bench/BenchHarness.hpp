@@ -0,0 +1,127 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace FileComparator::Bench {
+
+// Keeps a computed value alive so the optimiser cannot drop the work.
+template<typename T>
+inline void keep(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct Settings {
+    std::size_t repetitions = 10;
+    std::chrono::milliseconds minTime{50};   // per repetition
+    std::string filter;                      // run only names containing this
+};
+
+struct Result {
+    std::string name;
+    std::uint64_t iterations;   // per repetition
+    std::uint64_t bytesPerIteration;
+    std::vector<double> nsPerIteration;   // one sample per repetition
+
+    double mean() const {
+        return std::accumulate(nsPerIteration.begin(), nsPerIteration.end(), 0.0) / nsPerIteration.size();
+    }
+    double median() const {
+        auto sorted = nsPerIteration;
+        std::sort(sorted.begin(), sorted.end());
+        const std::size_t mid = sorted.size() / 2;
+        return sorted.size() % 2 ? sorted[mid] : (sorted[mid - 1] + sorted[mid]) / 2;
+    }
+    double stddev() const {
+        const double m = mean();
+        double sum = 0;
+        for (double sample : nsPerIteration) sum += (sample - m) * (sample - m);
+        return nsPerIteration.size() > 1 ? std::sqrt(sum / (nsPerIteration.size() - 1)) : 0.0;
+    }
+    double min() const { return *std::min_element(nsPerIteration.begin(), nsPerIteration.end()); }
+    double max() const { return *std::max_element(nsPerIteration.begin(), nsPerIteration.end()); }
+    // Throughput at the median, in bytes per second; 0 when not byte-based.
+    double bytesPerSecond() const { return bytesPerIteration ? bytesPerIteration * 1e9 / median() : 0.0; }
+};
+
+// A benchmark body runs `iterations` operations and is timed as a whole.
+using Body = std::function<void(std::uint64_t iterations)>;
+
+// Runs each benchmark in three phases: calibration doubles the iteration
+// count until one run lasts minTime, a warmup repetition is discarded, then
+// `repetitions` timed samples are kept.
+class Runner {
+public:
+    explicit Runner(Settings settings) : settings(std::move(settings)) {}
+
+    void run(const std::string& name, std::uint64_t bytesPerIteration, const Body& body) {
+        if (!settings.filter.empty() && name.find(settings.filter) == std::string::npos) return;
+
+        std::uint64_t iterations = 1;
+        while (time(body, iterations) < static_cast<double>(settings.minTime.count()) * 1e6 &&
+               iterations < (std::uint64_t{1} << 40)) {
+            iterations *= 2;
+        }
+        time(body, iterations);   // warmup
+
+        Result result{name, iterations, bytesPerIteration, {}};
+        for (std::size_t r = 0; r < settings.repetitions; ++r) {
+            result.nsPerIteration.push_back(time(body, iterations) / static_cast<double>(iterations));
+        }
+        printRow(result);
+        results.push_back(std::move(result));
+    }
+
+    const std::vector<Result>& all() const { return results; }
+
+    void writeJson(std::ostream& out) const {
+        out << "{\"repetitions\":" << settings.repetitions << ",\"min_time_ms\":" << settings.minTime.count()
+            << ",\"benchmarks\":[";
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            const Result& r = results[i];
+            out << (i ? "," : "") << "\n  {\"name\":\"" << r.name << "\",\"iterations\":" << r.iterations
+                << ",\"mean_ns\":" << r.mean() << ",\"median_ns\":" << r.median() << ",\"stddev_ns\":" << r.stddev()
+                << ",\"min_ns\":" << r.min() << ",\"max_ns\":" << r.max()
+                << ",\"bytes_per_second\":" << r.bytesPerSecond() << "}";
+        }
+        out << "\n]}\n";
+    }
+
+    static void printHeader() {
+        std::cout << std::left << std::setw(36) << "benchmark" << std::right << std::setw(14) << "median ns"
+                  << std::setw(12) << "stddev %" << std::setw(14) << "MB/s" << std::setw(14) << "iterations"
+                  << std::endl;
+    }
+
+private:
+    static double time(const Body& body, std::uint64_t iterations) {
+        const auto start = std::chrono::steady_clock::now();
+        body(iterations);
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    static void printRow(const Result& r) {
+        std::cout << std::left << std::setw(36) << r.name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(14) << r.median() << std::setw(12) << 100 * r.stddev() / r.mean() << std::setw(14);
+        if (r.bytesPerIteration) {
+            std::cout << r.bytesPerSecond() / 1e6;
+        } else {
+            std::cout << "-";
+        }
+        std::cout << std::setw(14) << r.iterations << std::endl;
+    }
+
+    Settings settings;
+    std::vector<Result> results;
+};
+
+} // namespace FileComparator::Bench
@@ -0,0 +1,227 @@
+#include "Corpus.hpp"
+#include "FileComparator.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace FileComparator::Bench {
+
+namespace {
+    constexpr std::size_t WRITE_BLOCK = 256 * 1024;
+    // Below this, unrelated random contents could collide by chance and
+    // blur the intended duplicate structure.
+    constexpr std::uint64_t MINIMUM_SIZE = 16;
+    constexpr std::size_t SPARSE_EXTENTS = 4;
+    constexpr std::size_t SPARSE_EXTENT_BYTES = 64 * 1024;
+
+    struct Content {
+        std::uint64_t size;
+        bool sparse;
+        std::size_t copies = 0;
+    };
+
+    struct Entry {
+        std::size_t directory;
+        std::uint32_t content;
+    };
+
+    std::uint64_t splitmix(std::uint64_t& state) {
+        std::uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    // Bytes of block `block` of content `content`; a pure function of its
+    // arguments, so every copy of a content is identical.
+    void fillBlock(std::uint64_t seed, std::uint32_t content, std::uint64_t block, char* out, std::size_t size) {
+        std::uint64_t state = seed ^ (std::uint64_t{content} * 0xD1B54A32D192ED03ULL) ^ (block * 0x8CB92BA72F3D8DD7ULL);
+        for (std::size_t i = 0; i < size; i += sizeof(std::uint64_t)) {
+            const std::uint64_t word = splitmix(state);
+            std::memcpy(out + i, &word, std::min(sizeof(word), size - i));
+        }
+    }
+
+    void writeAll(int fd, const char* data, std::size_t size, off_t offset) {
+        while (size > 0) {
+            const ssize_t n = ::pwrite(fd, data, size, offset);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) throw std::runtime_error(std::string("write failed: ") + std::strerror(errno));
+            data += n;
+            size -= static_cast<std::size_t>(n);
+            offset += n;
+        }
+    }
+
+    void writeFile(const std::string& path, std::uint64_t seed, std::uint32_t id, const Content& content,
+                   std::vector<char>& buffer) {
+        const int fd = ::open(path.c_str(), O_CREAT | O_EXCL | O_WRONLY | O_CLOEXEC, 0644);
+        if (fd < 0) throw std::runtime_error("cannot create " + path + ": " + std::strerror(errno));
+        try {
+            if (content.sparse) {
+                if (::ftruncate(fd, static_cast<off_t>(content.size)) != 0) {
+                    throw std::runtime_error("cannot size " + path);
+                }
+                for (std::size_t k = 0; k < SPARSE_EXTENTS; ++k) {
+                    const std::uint64_t offset = content.size / SPARSE_EXTENTS * k / 4096 * 4096;
+                    const std::size_t size = static_cast<std::size_t>(
+                        std::min<std::uint64_t>(SPARSE_EXTENT_BYTES, content.size - offset));
+                    fillBlock(seed, id, k, buffer.data(), size);
+                    writeAll(fd, buffer.data(), size, static_cast<off_t>(offset));
+                }
+            } else {
+                for (std::uint64_t offset = 0, block = 0; offset < content.size; offset += WRITE_BLOCK, ++block) {
+                    const std::size_t size =
+                        static_cast<std::size_t>(std::min<std::uint64_t>(WRITE_BLOCK, content.size - offset));
+                    fillBlock(seed, id, block, buffer.data(), size);
+                    writeAll(fd, buffer.data(), size, static_cast<off_t>(offset));
+                }
+            }
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+        ::close(fd);
+    }
+
+    std::uint64_t sampleSize(const CorpusSpec& spec, std::mt19937_64& rng) {
+        double size = 0;
+        if (spec.sizeDistribution == SizeDistribution::LogNormal) {
+            size = std::lognormal_distribution<double>(spec.logNormalMu, spec.logNormalSigma)(rng);
+        } else {
+            const double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+            size = static_cast<double>(spec.paretoMinimum) * std::pow(1.0 - u, -1.0 / spec.paretoAlpha);
+        }
+        if (!(size < static_cast<double>(spec.maxFileSize))) return spec.maxFileSize;
+        return std::max(MINIMUM_SIZE, static_cast<std::uint64_t>(size));
+    }
+
+    // Copies beyond the original: floor(U^(-1/alpha)), at least 1.
+    std::size_t sampleCopies(double alpha, std::mt19937_64& rng) {
+        const double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        const double copies = std::floor(std::pow(1.0 - u, -1.0 / alpha));
+        return copies < 1e9 ? std::max<std::size_t>(1, static_cast<std::size_t>(copies)) : 1000000000;
+    }
+
+    std::vector<std::string> makeDirectories(const CorpusSpec& spec) {
+        std::vector<std::string> directories{spec.root};
+        std::size_t levelBegin = 0;
+        for (std::size_t level = 0; level < spec.depth; ++level) {
+            const std::size_t levelEnd = directories.size();
+            for (std::size_t parent = levelBegin; parent < levelEnd; ++parent) {
+                for (std::size_t child = 0; child < spec.fanOut; ++child) {
+                    directories.push_back(directories[parent] + "/d" + std::to_string(child));
+                }
+            }
+            levelBegin = levelEnd;
+        }
+        return directories;
+    }
+}
+
+CorpusStats generateCorpus(const CorpusSpec& spec) {
+    if (fs::exists(spec.root)) throw std::runtime_error(spec.root + " already exists");
+    std::mt19937_64 rng(spec.seed);
+    CorpusStats stats;
+
+    // Plan the whole tree first, from one random stream, so the result does
+    // not depend on how the writing is scheduled.
+    const auto duplicates = static_cast<std::size_t>(std::llround(spec.files * spec.duplicateRatio));
+    const std::size_t originals = std::max<std::size_t>(spec.files - std::min(duplicates, spec.files), 1);
+    std::vector<Content> contents;
+    std::vector<std::uint32_t> copyable;
+    std::bernoulli_distribution sparse(spec.sparseRatio);
+    for (std::size_t i = 0; i < originals; ++i) {
+        if (sparse(rng)) {
+            contents.push_back(Content{spec.sparseSize, true});
+        } else {
+            contents.push_back(Content{sampleSize(spec, rng), false});
+            copyable.push_back(static_cast<std::uint32_t>(i));
+        }
+    }
+
+    std::vector<Entry> entries;
+    for (std::uint32_t i = 0; i < contents.size(); ++i) {
+        entries.push_back(Entry{0, i});
+    }
+    std::size_t remaining = originals < spec.files ? spec.files - originals : 0;
+    while (remaining > 0 && !copyable.empty()) {
+        const std::size_t copies = std::min(remaining, sampleCopies(spec.groupSizeAlpha, rng));
+        const std::uint32_t content = copyable[std::uniform_int_distribution<std::size_t>(0, copyable.size() - 1)(rng)];
+        contents[content].copies += copies;
+        for (std::size_t c = 0; c < copies; ++c) {
+            entries.push_back(Entry{0, content});
+        }
+        remaining -= copies;
+    }
+
+    const std::vector<std::string> directories = makeDirectories(spec);
+    std::shuffle(entries.begin(), entries.end(), rng);
+    std::uniform_int_distribution<std::size_t> pickDirectory(0, directories.size() - 1);
+    for (auto& entry : entries) {
+        entry.directory = pickDirectory(rng);
+    }
+    auto filePath = [&](std::size_t i) {
+        return directories[entries[i].directory] + "/f" + std::to_string(i) + ".dat";
+    };
+
+    for (const auto& directory : directories) {
+        fs::create_directories(directory);
+    }
+
+    // Write in parallel, one contiguous slice of entries per task.
+    {
+        ThreadPool pool(std::max<std::size_t>(spec.threads, 1));
+        std::vector<std::future<void>> tasks;
+        const std::size_t slices = std::max<std::size_t>(spec.threads, 1) * 4;
+        for (std::size_t slice = 0; slice < slices; ++slice) {
+            const std::size_t begin = entries.size() * slice / slices;
+            const std::size_t end = entries.size() * (slice + 1) / slices;
+            tasks.push_back(pool.enqueue([&, begin, end]() {
+                std::vector<char> buffer(WRITE_BLOCK);
+                for (std::size_t i = begin; i < end; ++i) {
+                    writeFile(filePath(i), spec.seed, entries[i].content, contents[entries[i].content], buffer);
+                }
+            }));
+        }
+        for (auto& task : tasks) {
+            task.get();
+        }
+    }
+
+    for (const auto& content : contents) {
+        stats.files += content.copies + 1;
+        stats.bytes += content.size * (content.copies + 1);
+        stats.sparseFiles += content.sparse;
+        if (content.copies > 0) {
+            ++stats.duplicateGroups;
+            stats.duplicateFiles += content.copies + 1;
+        }
+    }
+
+    const auto hardlinks = static_cast<std::size_t>(std::llround(spec.files * spec.hardlinkRatio));
+    const auto symlinks = static_cast<std::size_t>(std::llround(spec.files * spec.symlinkRatio));
+    std::uniform_int_distribution<std::size_t> pickEntry(0, entries.size() - 1);
+    for (std::size_t i = 0; i < hardlinks && !entries.empty(); ++i) {
+        const std::string target = filePath(pickEntry(rng));
+        fs::create_hard_link(target, directories[pickDirectory(rng)] + "/h" + std::to_string(i) + ".dat");
+        ++stats.hardlinks;
+    }
+    for (std::size_t i = 0; i < symlinks && !entries.empty(); ++i) {
+        const std::string target = filePath(pickEntry(rng));
+        fs::create_symlink(fs::absolute(target), directories[pickDirectory(rng)] + "/s" + std::to_string(i) + ".lnk");
+        ++stats.symlinks;
+    }
+    return stats;
+}
+
+} // namespace FileComparator::Bench
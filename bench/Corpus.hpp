@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <thread>
+
+namespace FileComparator::Bench {
+
+enum class SizeDistribution { LogNormal, Pareto };
+
+// A synthetic tree for end-to-end runs. The same spec and seed always give
+// the same tree, byte for byte, however many threads write it.
+struct CorpusSpec {
+    std::string root;
+    std::uint64_t seed = 1;
+    std::size_t files = 10000;
+
+    SizeDistribution sizeDistribution = SizeDistribution::LogNormal;
+    double logNormalMu = 8.0;        // median e^mu bytes, about 3 KB
+    double logNormalSigma = 2.0;
+    double paretoAlpha = 1.1;        // heavier tail as alpha approaches 1
+    std::uint64_t paretoMinimum = 512;
+    std::uint64_t maxFileSize = 256ull << 20;
+
+    // Fraction of files that repeat another file's content; the number of
+    // copies per duplicated content follows a discrete Pareto law, so most
+    // groups are pairs and a few are very large.
+    double duplicateRatio = 0.3;
+    double groupSizeAlpha = 1.5;
+
+    // Every directory has fanOut subdirectories down to depth levels; files
+    // are spread uniformly over all of them.
+    std::size_t fanOut = 8;
+    std::size_t depth = 3;
+
+    double hardlinkRatio = 0.01;   // extra names for existing files
+    double symlinkRatio = 0.01;
+    double sparseRatio = 0.0;      // files written as holes with a few data extents
+    std::uint64_t sparseSize = 1ull << 30;
+
+    std::size_t threads = std::thread::hardware_concurrency();
+};
+
+struct CorpusStats {
+    std::size_t files = 0;          // regular files written
+    std::size_t hardlinks = 0;
+    std::size_t symlinks = 0;
+    std::size_t sparseFiles = 0;
+    std::uint64_t bytes = 0;        // logical bytes of the regular files
+    std::size_t duplicateGroups = 0;
+    std::size_t duplicateFiles = 0; // files in those groups, originals included
+};
+
+// Writes the corpus under spec.root, which must not exist yet. Contents are
+// generated block by block from (seed, content id), so copies are identical
+// without being read back, and files are written in parallel. Throws
+// std::runtime_error or std::filesystem::filesystem_error.
+CorpusStats generateCorpus(const CorpusSpec& spec);
+
+} // namespace FileComparator::Bench
@@ -0,0 +1,198 @@
+#include "BenchHarness.hpp"
+#include "FileComparator.hpp"
+#include "Hashing.hpp"
+#include <boost/program_options.hpp>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+namespace po = boost::program_options;
+
+using namespace FileComparator;
+
+namespace {
+    // Files for the read-path benchmarks, removed on exit.
+    class Scratch {
+    public:
+        Scratch() {
+            const char* tmp = std::getenv("TMPDIR");
+            std::string pattern = std::string(tmp && *tmp ? tmp : "/tmp") + "/fs2-bench-XXXXXX";
+            if (!::mkdtemp(pattern.data())) throw std::runtime_error("cannot create scratch directory");
+            directory = pattern;
+        }
+        ~Scratch() {
+            std::error_code ec;
+            fs::remove_all(directory, ec);
+        }
+
+        std::string file(const std::string& name, std::size_t size) {
+            const std::string path = directory + "/" + name;
+            std::ofstream out(path, std::ios::binary);
+            std::string block(64 * 1024, '\0');
+            for (std::size_t i = 0; i < block.size(); ++i) block[i] = static_cast<char>('a' + i % 26);
+            for (std::size_t written = 0; written < size; written += block.size()) {
+                out.write(block.data(), static_cast<std::streamsize>(std::min(block.size(), size - written)));
+            }
+            return path;
+        }
+
+        // size bytes of hole with one 64 KiB data extent in the middle.
+        std::string sparseFile(const std::string& name, std::size_t size) {
+            const std::string path = directory + "/" + name;
+            const int fd = ::open(path.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+            const std::string data(64 * 1024, 'd');
+            if (fd < 0 || ::ftruncate(fd, static_cast<off_t>(size)) != 0 ||
+                ::pwrite(fd, data.data(), data.size(), static_cast<off_t>(size / 2)) < 0) {
+                throw std::runtime_error("cannot create sparse file");
+            }
+            ::close(fd);
+            return path;
+        }
+
+    private:
+        std::string directory;
+    };
+
+    Generator<std::uint64_t> counter() {
+        for (std::uint64_t i = 0;; ++i) {
+            co_yield std::move(i);
+        }
+    }
+
+    void hashingBenchmarks(Bench::Runner& runner) {
+        for (std::size_t size : {64, 4096, 64 * 1024, 1024 * 1024}) {
+            const std::string buffer(size, 'x');
+            runner.run("hash/calculateDigest/" + std::to_string(size), size, [&](std::uint64_t iterations) {
+                for (std::uint64_t i = 0; i < iterations; ++i) {
+                    Bench::keep(calculateDigest(buffer.data(), buffer.size()));
+                }
+            });
+        }
+        runner.run("hash/updateZeros/1GiB", 0, [](std::uint64_t iterations) {
+            for (std::uint64_t i = 0; i < iterations; ++i) {
+                Fnv1a hash;
+                hash.updateZeros(std::uint64_t{1} << 30);
+                Bench::keep(hash.value());
+            }
+        });
+        runner.run("hash/digestToHex", 0, [](std::uint64_t iterations) {
+            for (std::uint64_t i = 0; i < iterations; ++i) {
+                Bench::keep(digestToHex(i));
+            }
+        });
+    }
+
+    void poolBenchmarks(Bench::Runner& runner) {
+        ThreadPool& pool = sharedThreadPool();
+        runner.run("pool/enqueue_roundtrip", 0, [&](std::uint64_t iterations) {
+            for (std::uint64_t i = 0; i < iterations; ++i) {
+                pool.enqueue([i]() { return i; }).get();
+            }
+        });
+        runner.run("pool/enqueue_batch64", 0, [&](std::uint64_t iterations) {
+            std::vector<std::future<std::uint64_t>> futures;
+            for (std::uint64_t i = 0; i < iterations; i += futures.size()) {
+                futures.clear();
+                for (std::uint64_t j = 0; j < 64 && i + j < iterations; ++j) {
+                    futures.push_back(pool.enqueue([j]() { return j; }));
+                }
+                for (auto& future : futures) Bench::keep(future.get());
+            }
+        });
+    }
+
+    void generatorBenchmarks(Bench::Runner& runner) {
+        runner.run("generator/resume", 0, [](std::uint64_t iterations) {
+            auto generator = counter();
+            auto it = generator.begin();
+            for (std::uint64_t i = 0; i < iterations; ++i, ++it) {
+                Bench::keep(*it);
+            }
+        });
+        runner.run("generator/create_destroy", 0, [](std::uint64_t iterations) {
+            for (std::uint64_t i = 0; i < iterations; ++i) {
+                auto generator = counter();
+                Bench::keep(*generator.begin());
+            }
+        });
+    }
+
+    void readBenchmarks(Bench::Runner& runner, Scratch& scratch) {
+        for (std::size_t size : {std::size_t{1024}, TINY_FILE_BYTES, std::size_t{1024 * 1024}}) {
+            const std::string path = scratch.file("file-" + std::to_string(size), size);
+            const std::string suffix = "/" + std::to_string(size);
+            runner.run("read/digestFile" + suffix, size, [&](std::uint64_t iterations) {
+                for (std::uint64_t i = 0; i < iterations; ++i) Bench::keep(digestFile(path));
+            });
+            if (size <= TINY_FILE_BYTES) {
+                runner.run("read/digestTinyFile" + suffix, size, [&](std::uint64_t iterations) {
+                    for (std::uint64_t i = 0; i < iterations; ++i) {
+                        Bench::keep(digestTinyFile(AT_FDCWD, path.c_str(), size));
+                    }
+                });
+            }
+            // The legacy path: a pool task and future around the same read.
+            runner.run("read/computeHashAsync" + suffix, size, [&](std::uint64_t iterations) {
+                for (std::uint64_t i = 0; i < iterations; ++i) Bench::keep(computeHashAsync(path).get());
+            });
+        }
+        const std::size_t sparseSize = std::size_t{1} << 30;
+        const std::string sparse = scratch.sparseFile("sparse-1GiB", sparseSize);
+        runner.run("read/digestFile/sparse-1GiB", sparseSize, [&](std::uint64_t iterations) {
+            for (std::uint64_t i = 0; i < iterations; ++i) Bench::keep(digestFile(sparse));
+        });
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Bench::Settings settings;
+    std::string jsonPath;
+    std::size_t minTimeMs = 50;
+    po::options_description desc("fs2-bench options");
+    desc.add_options()
+        ("help,h", "Show help message")
+        ("filter", po::value<std::string>(&settings.filter), "Run only benchmarks whose name contains this")
+        ("repetitions", po::value<std::size_t>(&settings.repetitions), "Timed repetitions per benchmark (default 10)")
+        ("min-time", po::value<std::size_t>(&minTimeMs), "Minimum milliseconds per repetition (default 50)")
+        ("json", po::value<std::string>(&jsonPath), "Also write the results as JSON to this file");
+    try {
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+        if (vm.count("help")) {
+            std::cout << desc << std::endl;
+            return 0;
+        }
+    } catch (const po::error& e) {
+        std::cerr << "Error parsing options: " << e.what() << std::endl;
+        return 1;
+    }
+    if (settings.repetitions == 0) settings.repetitions = 1;
+    settings.minTime = std::chrono::milliseconds(minTimeMs);
+
+    Bench::Runner runner(settings);
+    Bench::Runner::printHeader();
+    try {
+        Scratch scratch;
+        hashingBenchmarks(runner);
+        poolBenchmarks(runner);
+        generatorBenchmarks(runner);
+        readBenchmarks(runner, scratch);
+    } catch (const std::exception& e) {
+        std::cerr << "Benchmark setup failed: " << e.what() << std::endl;
+        return 1;
+    }
+
+    if (!jsonPath.empty()) {
+        std::ofstream out(jsonPath);
+        if (!out) {
+            std::cerr << "Failed to open " << jsonPath << std::endl;
+            return 1;
+        }
+        runner.writeJson(out);
+    }
+    return 0;
+}
@@ -0,0 +1,237 @@
+#include "Corpus.hpp"
+#include "FileComparator.hpp"
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+namespace po = boost::program_options;
+
+using namespace FileComparator;
+
+namespace {
+    struct PassResult {
+        std::string name;
+        std::size_t files = 0;
+        std::uint64_t bytes = 0;
+        std::size_t groups = 0;
+        double firstResultSeconds = 0;
+        double totalSeconds = 0;
+        long peakRssKiB = 0;
+    };
+
+    // Runs the full grouping pipeline and prints one result line. Each pass
+    // runs in its own process, so peak RSS is per pass and the thread pool
+    // is fresh.
+    int runPass(const std::string& root) {
+        const auto start = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::time_point first{};
+        std::size_t files = 0;
+        std::size_t groups = 0;
+        std::uint64_t bytes = 0;
+        for (const auto& group : groupByContent({root})) {
+            if (groups++ == 0) first = std::chrono::steady_clock::now();
+            files += group.files.size();
+            bytes += static_cast<std::uint64_t>(group.size) * group.files.size();
+        }
+        const auto end = std::chrono::steady_clock::now();
+        if (groups == 0) first = end;
+        std::cout << files << ' ' << bytes << ' ' << groups << ' '
+                  << std::chrono::duration<double>(first - start).count() << ' '
+                  << std::chrono::duration<double>(end - start).count() << std::endl;
+        return 0;
+    }
+
+    // Drops the corpus from the caches. As root, drop_caches clears the page
+    // cache and the dentry and inode caches, and true is returned. Otherwise
+    // the files are evicted with posix_fadvise, which leaves directory and
+    // inode caches warm, and false is returned.
+    bool evictCache(const std::string& root) {
+        ::sync();
+        if (std::ofstream dropCaches("/proc/sys/vm/drop_caches"); dropCaches && (dropCaches << "3").flush()) return true;
+        for (const auto& entry : fs::recursive_directory_iterator(root)) {
+            if (!entry.is_regular_file() || entry.is_symlink()) continue;
+            const int fd = ::open(entry.path().c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) continue;
+            ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            ::close(fd);
+        }
+        return false;
+    }
+
+    // Re-executes this binary with --run-pass and reads back its result line.
+    PassResult spawnPass(const std::string& name, const std::string& root) {
+        int pipeFds[2];
+        if (::pipe(pipeFds) != 0) throw std::runtime_error("pipe failed");
+        const pid_t pid = ::fork();
+        if (pid < 0) throw std::runtime_error("fork failed");
+        if (pid == 0) {
+            ::dup2(pipeFds[1], STDOUT_FILENO);
+            ::close(pipeFds[0]);
+            ::close(pipeFds[1]);
+            ::execl("/proc/self/exe", "fs2-scale", "--run-pass", root.c_str(), static_cast<char*>(nullptr));
+            ::_exit(127);
+        }
+        ::close(pipeFds[1]);
+        std::string output;
+        char buffer[256];
+        for (ssize_t n; (n = ::read(pipeFds[0], buffer, sizeof(buffer))) != 0;) {
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) break;
+            output.append(buffer, static_cast<std::size_t>(n));
+        }
+        ::close(pipeFds[0]);
+
+        int status = 0;
+        struct rusage usage {};
+        while (::wait4(pid, &status, 0, &usage) < 0 && errno == EINTR) {}
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) throw std::runtime_error(name + " pass failed");
+
+        PassResult result{name};
+        std::istringstream(output) >> result.files >> result.bytes >> result.groups >> result.firstResultSeconds >>
+            result.totalSeconds;
+        result.peakRssKiB = usage.ru_maxrss;
+        return result;
+    }
+
+    void printResult(const PassResult& r) {
+        std::cout << std::left << std::setw(9) << r.name << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(10) << r.totalSeconds << " s" << std::setw(12) << std::setprecision(0)
+                  << r.files / r.totalSeconds << " files/s" << std::setw(10) << std::setprecision(1)
+                  << r.bytes / r.totalSeconds / 1e6 << " MB/s" << std::setw(10) << std::setprecision(3)
+                  << r.firstResultSeconds * 1e3 << " ms to first" << std::setw(10) << r.peakRssKiB / 1024
+                  << " MiB peak RSS" << std::endl;
+    }
+
+    // stats is empty for a reused corpus, whose makeup is unknown; the corpus
+    // object is then left out.
+    void writeJson(std::ostream& out, const Bench::CorpusSpec& spec, const std::optional<Bench::CorpusStats>& stats,
+                   const std::vector<PassResult>& passes) {
+        out << "{";
+        if (stats) {
+            out << "\"corpus\":{\"seed\":" << spec.seed << ",\"files\":" << stats->files
+                << ",\"bytes\":" << stats->bytes << ",\"duplicate_groups\":" << stats->duplicateGroups
+                << ",\"duplicate_files\":" << stats->duplicateFiles
+                << ",\"hardlinks\":" << stats->hardlinks << ",\"symlinks\":" << stats->symlinks
+                << ",\"sparse_files\":" << stats->sparseFiles << "},";
+        }
+        out << "\"passes\":[";
+        for (std::size_t i = 0; i < passes.size(); ++i) {
+            const PassResult& r = passes[i];
+            out << (i ? "," : "") << "\n  {\"cache\":\"" << r.name << "\",\"seconds\":" << r.totalSeconds
+                << ",\"files\":" << r.files << ",\"bytes\":" << r.bytes << ",\"groups\":" << r.groups
+                << ",\"files_per_second\":" << r.files / r.totalSeconds
+                << ",\"bytes_per_second\":" << r.bytes / r.totalSeconds
+                << ",\"first_result_seconds\":" << r.firstResultSeconds << ",\"peak_rss_kib\":" << r.peakRssKiB << "}";
+        }
+        out << "\n]}\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc == 3 && std::strcmp(argv[1], "--run-pass") == 0) return runPass(argv[2]);
+
+    Bench::CorpusSpec spec;
+    std::string distribution = "lognormal";
+    std::string jsonPath;
+    std::size_t repeats = 1;
+    bool keep = false;
+    po::options_description desc("fs2-scale options");
+    desc.add_options()
+        ("help,h", "Show help message")
+        ("root", po::value<std::string>(&spec.root), "Corpus directory (default $TMPDIR/fs2-corpus-<seed>)")
+        ("keep", po::bool_switch(&keep), "Keep the corpus, and reuse it if it already exists")
+        ("seed", po::value<std::uint64_t>(&spec.seed), "Random seed (default 1)")
+        ("files", po::value<std::size_t>(&spec.files), "Regular files to generate (default 10000)")
+        ("size-distribution", po::value<std::string>(&distribution), "lognormal (default) or pareto")
+        ("lognormal-mu", po::value<double>(&spec.logNormalMu), "Log-normal mu; median size is e^mu (default 8)")
+        ("lognormal-sigma", po::value<double>(&spec.logNormalSigma), "Log-normal sigma (default 2)")
+        ("pareto-alpha", po::value<double>(&spec.paretoAlpha), "Pareto tail index (default 1.1)")
+        ("pareto-min", po::value<std::uint64_t>(&spec.paretoMinimum), "Pareto minimum size (default 512)")
+        ("max-size", po::value<std::uint64_t>(&spec.maxFileSize), "Largest file size (default 256 MiB)")
+        ("duplicate-ratio", po::value<double>(&spec.duplicateRatio), "Fraction of files that are copies (default 0.3)")
+        ("group-alpha", po::value<double>(&spec.groupSizeAlpha), "Pareto index of copies per group (default 1.5)")
+        ("fan-out", po::value<std::size_t>(&spec.fanOut), "Subdirectories per directory (default 8)")
+        ("depth", po::value<std::size_t>(&spec.depth), "Directory levels (default 3)")
+        ("hardlink-ratio", po::value<double>(&spec.hardlinkRatio), "Extra hard links per file (default 0.01)")
+        ("symlink-ratio", po::value<double>(&spec.symlinkRatio), "Symlinks per file (default 0.01)")
+        ("sparse-ratio", po::value<double>(&spec.sparseRatio), "Fraction of files that are sparse (default 0)")
+        ("sparse-size", po::value<std::uint64_t>(&spec.sparseSize), "Logical size of sparse files (default 1 GiB)")
+        ("threads", po::value<std::size_t>(&spec.threads), "Threads writing the corpus")
+        ("repeats", po::value<std::size_t>(&repeats), "Cold and warm passes to run (default 1 each)")
+        ("json", po::value<std::string>(&jsonPath), "Also write the results as JSON to this file");
+    try {
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+        if (vm.count("help")) {
+            std::cout << desc << std::endl;
+            return 0;
+        }
+    } catch (const po::error& e) {
+        std::cerr << "Error parsing options: " << e.what() << std::endl;
+        return 1;
+    }
+    if (distribution == "pareto") {
+        spec.sizeDistribution = Bench::SizeDistribution::Pareto;
+    } else if (distribution != "lognormal") {
+        std::cerr << "Error: Unknown size distribution: " << distribution << std::endl;
+        return 1;
+    }
+    if (spec.root.empty()) {
+        const char* tmp = std::getenv("TMPDIR");
+        spec.root = std::string(tmp && *tmp ? tmp : "/tmp") + "/fs2-corpus-" + std::to_string(spec.seed);
+    }
+
+    std::optional<Bench::CorpusStats> stats;
+    std::vector<PassResult> passes;
+    bool created = false;   // only a corpus this run generated is ever removed
+    try {
+        if (keep && fs::exists(spec.root)) {
+            std::cout << "Reusing corpus at " << spec.root << std::endl;
+        } else {
+            const auto start = std::chrono::steady_clock::now();
+            stats = Bench::generateCorpus(spec);
+            created = true;
+            std::cout << "Generated " << stats->files << " files (" << stats->bytes / 1e6 << " MB, "
+                      << stats->duplicateGroups << " duplicate groups over " << stats->duplicateFiles << " files, "
+                      << stats->hardlinks << " hard links, " << stats->symlinks << " symlinks, " << stats->sparseFiles
+                      << " sparse) in " << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()
+                      << " s at " << spec.root << std::endl;
+        }
+
+        for (std::size_t r = 0; r < repeats; ++r) {
+            const bool fullyCold = evictCache(spec.root);
+            passes.push_back(spawnPass(fullyCold ? "cold" : "cold-data", spec.root));
+            printResult(passes.back());
+            passes.push_back(spawnPass("warm", spec.root));   // the cold pass just filled the cache
+            printResult(passes.back());
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        if (created && !keep) fs::remove_all(spec.root);
+        return 1;
+    }
+    if (created && !keep) fs::remove_all(spec.root);
+
+    if (!jsonPath.empty()) {
+        std::ofstream out(jsonPath);
+        if (!out) {
+            std::cerr << "Failed to open " << jsonPath << std::endl;
+            return 1;
+        }
+        writeJson(out, spec, stats, passes);
+    }
+    return 0;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Hashing.hpp"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace FileComparator {
+
+// Joins an archive's path to a member's path in virtual entries:
+// "backups/etc.tar.gz!/etc/hosts".
+inline constexpr std::string_view ARCHIVE_SEPARATOR = "!/";
+
+enum class ArchiveFormat { Tar, TarGz, Zip };
+
+// The format implied by a file name (.tar, .tar.gz, .tgz, .zip), if any.
+std::optional<ArchiveFormat> archiveFormatOf(std::string_view name);
+
+// True if path names a member inside an archive rather than a real file.
+bool isArchiveMemberPath(std::string_view path);
+
+struct ArchiveMember {
+    std::string path;   // inside the archive, '/'-separated, no leading '/'
+    std::uint64_t size;
+    Digest digest;
+};
+
+// Hashes every regular member of an archive as it streams past, without
+// extracting anything: memory is a few fixed buffers however large the
+// archive. Members that cannot be read (encrypted, unsupported compression)
+// are recorded with Errors and left out; a corrupt archive is recorded too
+// and yields the members read before the damage.
+std::vector<ArchiveMember> hashArchiveMembers(const std::string& archivePath, ArchiveFormat format);
+
+} // namespace FileComparator
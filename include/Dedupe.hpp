@@ -0,0 +1,40 @@
+#pragma once
+
+#include "FileComparator.hpp"
+#include <optional>
+#include <string>
+
+namespace FileComparator {
+
+enum class DedupeMethod { Reflink, Hardlink };
+
+struct DedupeOptions {
+    DedupeMethod method = DedupeMethod::Reflink;
+    // Link instead when the filesystem cannot share extents.
+    bool hardlinkFallback = true;
+};
+
+struct DedupeResult {
+    std::size_t filesLinked = 0;
+    std::size_t bytesReclaimed = 0;
+    std::size_t skipped = 0;    // changed since grouping, or already shared
+    std::size_t failed = 0;
+
+    DedupeResult& operator+=(const DedupeResult& other);
+};
+
+// Replaces every member of a duplicate group with a reflink (or hardlink) to
+// the first member. Reflinks go through FIDEDUPERANGE, which compares and
+// shares extents atomically in the kernel, so a member written meanwhile is
+// skipped rather than overwritten. Hardlinks are made only after a byte for
+// byte comparison through the open descriptors, and skipped if either file
+// changed since, or if a path no longer names the verified inode. A
+// hardlinked member takes the source's owner, permissions and timestamps.
+DedupeResult dedupeGroup(const DuplicateGroup& group, const DedupeOptions& options = {});
+
+// Runs dedupeGroup on the shared thread pool, so groups proceed in parallel.
+std::future<DedupeResult> dedupeGroupAsync(DuplicateGroup group, DedupeOptions options = {});
+
+std::optional<DedupeMethod> parseDedupeMethod(const std::string& name);
+
+} // namespace FileComparator
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace FileComparator::Errors {
+
+// Filesystem errors met while scanning. Nothing is printed where they
+// happen: each is folded into a count per (operation, errno) with a few
+// sample paths, and the caller reports the lot once at the end. A tree with
+// a hundred thousand unreadable entries then costs a hundred thousand
+// cheap records rather than as many exceptions and unbuffered writes.
+enum class Operation : std::uint8_t {
+    OpenDirectory,
+    ReadDirectory,
+    Stat,
+    ReadLink,
+    Open,
+    Read,
+    Archive,   // a corrupt archive, or a member that cannot be read
+    Count
+};
+
+// Sample paths kept per (operation, errno).
+inline constexpr std::size_t MAX_SAMPLES = 3;
+
+struct Summary {
+    Operation operation;
+    int error;   // errno value
+    std::uint64_t count;
+    std::vector<std::string> samples;
+};
+
+// Thread-safe.
+void record(Operation operation, int error, std::string_view path);
+
+inline void record(Operation operation, const std::error_code& ec, std::string_view path) {
+    record(operation, ec.value(), path);
+}
+
+const char* toString(Operation operation);
+
+// Errors recorded so far, most frequent first.
+std::vector<Summary> summary();
+std::uint64_t total();
+void clear();
+// Folds in errors recorded by another process, such as a shard worker,
+// keeping at most MAX_SAMPLES samples. Thread-safe.
+void merge(const Summary& errors);
+
+// One line per (operation, errno) under a total; nothing when there were
+// no errors.
+void writeReport(std::ostream& out, const std::vector<Summary>& errors = summary());
+
+// The same as NDJSON records:
+//   {"kind":"error","operation":"stat","errno":13,"message":"..","count":N,"samples":[".."]}
+void writeRecords(std::ostream& out);
+
+} // namespace FileComparator::Errors
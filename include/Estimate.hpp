@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace FileComparator {
+
+struct EstimateOptions {
+    // Share of the bytes in files that share a size to actually hash. It is
+    // a hard budget: no more than this is ever read.
+    double sampleFraction = 0.01;
+    std::uint64_t seed = 1;
+    // Files smaller than this are left out, as with GroupingOptions.
+    std::uint64_t minSize = 0;
+};
+
+struct DuplicateEstimate {
+    std::uint64_t files = 0;              // enumerated
+    std::uint64_t bytes = 0;
+    std::uint64_t candidateClasses = 0;   // sizes shared by two or more files
+    std::uint64_t candidateBytes = 0;     // size times extra copies over those: the most that can be duplicate
+    std::uint64_t sampledClasses = 0;
+    std::uint64_t sampledFiles = 0;
+    std::uint64_t hashedBytes = 0;
+    std::uint64_t budgetBytes = 0;        // sampleFraction of the candidate files' bytes
+    std::uint64_t unsampledStrata = 0;    // size ranges whose classes all cost more than the budget left
+    std::uint64_t unsampledBytes = 0;     // the most that can be duplicate in those
+    double duplicateBytes = 0;            // estimated size times extra copies over duplicate groups
+    double lower = 0;                     // 95% confidence interval
+    double upper = 0;
+    double walkSeconds = 0;
+    double hashSeconds = 0;
+};
+
+// Estimates how many bytes a full scan would find duplicated without
+// hashing the whole tree. The tree is enumerated, which is cheap next to
+// reading it, so every size class and its upper bound on duplicate bytes
+// is known exactly. Size classes are stratified by power-of-two size, a
+// random sampleFraction of each stratum's bytes is hashed whole, and each
+// stratum's share of duplicate bytes is carried to the rest with a ratio
+// estimator, which the exact upper bounds make tight. Budget left over tops
+// up strata with fewer than two classes sampled, for a variance. A stratum
+// none of whose classes fit is left unsampled: it is estimated at the
+// sample's overall ratio and the interval spans all or none of it being
+// duplicate. The interval is clamped to what the sample proved and what the
+// sizes allow.
+DuplicateEstimate estimateDuplicates(const std::vector<std::string>& roots, const EstimateOptions& options = {});
+
+void writeEstimate(std::ostream& out, const DuplicateEstimate& estimate);
+
+} // namespace FileComparator
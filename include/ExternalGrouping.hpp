@@ -0,0 +1,32 @@
+#pragma once
+
+#include "FileComparator.hpp"
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace FileComparator {
+
+struct ExternalOptions {
+    // Approximate ceiling, in bytes, on sort buffers and merge readers. Path
+    // strings and sorted runs live in spill files instead.
+    std::size_t memoryBudget = std::size_t{256} << 20;
+    // Where the spill directory is created; empty means $TMPDIR, then /tmp.
+    std::string tempDirectory;
+    GroupingOptions grouping;
+};
+
+// Parses a byte count such as "4096", "512K", "64M" or "2G" (powers of 1024).
+std::optional<std::size_t> parseByteSize(const std::string& text);
+
+// groupByContent for corpora whose metadata does not fit in memory. Scanned
+// files go through an external sort by (size, device, inode) and, once
+// hashed, by (size, digest); each sort spills runs to disk when its share of
+// the budget fills and finishes with a k-way merge. Groups carry the same
+// members and hashes as groupByContent but are yielded in a different order,
+// and a single group is still held in memory whole.
+Generator<DuplicateGroup> groupByContentExternal(std::vector<std::string> directories,
+                                                 ExternalOptions options = {});
+
+} // namespace FileComparator
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "FileMetadata.hpp"
+#include "Metrics.hpp"
 #include <string>
 #include <vector>
 #include <memory>
@@ -13,6 +15,7 @@
 #include <filesystem>
 #include <array>
 #include <iostream>
+#include <span>
 
 namespace FileComparator {
 
@@ -21,6 +24,32 @@ struct FileInfo {
     std::string name;
     std::size_t size;
     std::string hash;
+    // From the scan's one statx of the file; type Unknown when the FileInfo
+    // was built by hand, and later stages then ask the filesystem.
+    FileMetadata metadata{};
+};
+
+// Files that share identical content. Groups of one file are unique content.
+struct DuplicateGroup {
+    std::size_t size;
+    std::string hash;
+    std::vector<FileInfo> files;
+};
+
+struct GroupingOptions {
+    // Also hash files whose size no other file shares. They cannot have a
+    // duplicate in this scan, but a digest lets them be matched against
+    // other scans, as when comparing manifests.
+    bool hashUnique = false;
+    // Also list the regular members of .tar, .tar.gz/.tgz and .zip files as
+    // virtual entries "archive.zip!/member/path", hashed as they stream out
+    // of the archive. The archives themselves are still listed.
+    bool scanArchives = false;
+    // Files smaller than this are left out of the scan altogether.
+    std::uint64_t minSize = 0;
+    // Yield only groups of two or more files; unique content is skipped
+    // rather than reported as a group of one.
+    bool duplicatesOnly = false;
 };
 
 class ThreadPool {
@@ -51,12 +80,31 @@ public:
     template<class F>
     std::future<std::invoke_result_t<F>> enqueue(F&& f) {
         using return_type = std::invoke_result_t<F>;
-        auto task = std::make_shared<std::packaged_task<return_type()>>(
-            std::forward<F>(f)
-        );
+        const bool timed = Metrics::enabled();
+        std::shared_ptr<std::packaged_task<return_type()>> task;
+        if (timed) {
+            // Timed inside the task, so its metrics are in before its future
+            // is ready.
+            task = std::make_shared<std::packaged_task<return_type()>>(
+                [f = std::forward<F>(f), queued = Metrics::now()]() mutable -> return_type {
+                    struct Timing {
+                        std::uint64_t start;
+                        ~Timing() {
+                            const auto end = Metrics::now();
+                            Metrics::add(Metrics::Stage::Task, end - start);
+                            Metrics::trace("task", Metrics::Stage::Task, start, end);
+                        }
+                    } timing{Metrics::now()};
+                    Metrics::add(Metrics::Stage::QueueWait, timing.start - queued);
+                    return f();
+                });
+        } else {
+            task = std::make_shared<std::packaged_task<return_type()>>(std::forward<F>(f));
+        }
         std::future<return_type> res = task->get_future();
         {
             std::unique_lock lock(queueMutex);
+            if (timed) Metrics::observeQueueDepth(tasks.size());
             tasks.emplace([task]() { (*task)(); });
         }
         condition.notify_one();
@@ -135,10 +183,28 @@ private:
     handle coro;
 };
 
-// Forward declarations
+// Forward declarations. Coroutines take their arguments by value: the body
+// runs after the call returns, when a temporary argument would be gone.
+ThreadPool& sharedThreadPool();
 std::vector<FileInfo> scanDirectory(const std::string& directory);
+// Compares by FileInfo::hash when both are set. A missing hash comes from
+// an in-process memo keyed by (device, inode, size, mtime), checked with
+// one statx, so a file is hashed on the pool only when it is new or has
+// changed. A rewrite that keeps both size and mtime goes unnoticed.
 bool compareFiles(const FileInfo& file1, const FileInfo& file2);
+// Partitions files into classes of identical content, as compareFiles
+// would, given as indices into files: each class ascending, classes in
+// order of their first member. Only files sharing a size are read, each
+// inode once, and a file larger than HEAD_DIGEST_BYTES is read in full only
+// if another shares its head; full digests go through the memo. A file
+// that cannot be read is a class of its own. FileInfo::hash is not used.
+std::vector<std::vector<std::size_t>> compareMany(std::span<const FileInfo> files);
+// Forgets every digest compareFiles and compareMany remembered.
+void clearDigestMemo();
 Generator<FileInfo> scanDirectoryAsync(const std::string& directory);
 std::future<std::string> computeHashAsync(const std::string& path);
+// Uses file.metadata when known rather than stat-ing the file again.
+std::future<std::string> computeHashAsync(const FileInfo& file);
+Generator<DuplicateGroup> groupByContent(std::vector<std::string> directories, GroupingOptions options = {});
 
 } // namespace FileComparator
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+
+namespace FileComparator {
+
+enum class FileType : std::uint8_t { Unknown, Regular, Directory, Symlink, Other };
+
+// What one statx of an entry says about it, taken once when the entry is
+// enumerated and carried to every later stage instead of asking again. A
+// symlink is described itself, not its target; its size is the length of
+// the target path.
+struct FileMetadata {
+    FileType type = FileType::Unknown;
+    std::uint64_t size = 0;
+    std::uint64_t device = 0;
+    std::uint64_t inode = 0;
+    std::int64_t mtime = 0;     // nanoseconds since the epoch
+    std::uint64_t links = 0;
+    std::uint64_t blocks = 0;   // 512-byte units allocated
+
+    bool known() const { return type != FileType::Unknown; }
+    // Fewer bytes allocated than the size: there are holes to skip.
+    bool sparse() const { return type == FileType::Regular && blocks * 512 < size; }
+};
+
+// statx of name relative to the open directory directoryFd (AT_FDCWD for a
+// plain path), not following a final symlink. Returns 0 or the errno.
+int readMetadata(int directoryFd, const char* name, FileMetadata& metadata);
+
+} // namespace FileComparator
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "FileMetadata.hpp"
+#include "Hashing.hpp"
+#include "PathTable.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace FileComparator {
+
+using RowId = std::uint32_t;
+
+enum class DigestState : std::uint8_t { Pending, Hashed, Failed };
+
+// Columnar file metadata: one contiguous array per attribute, indexed by row.
+// Grouping passes stream through the narrow size and digest columns only;
+// device, inode and path are read just for the rows that survive.
+class FileTable {
+public:
+    RowId append(PathId path, std::uint64_t size, std::uint64_t device, std::uint64_t inode,
+                 std::int64_t mtime, std::uint64_t links = 1, std::uint64_t blocks = 0);
+
+    std::size_t size() const { return sizes.size(); }
+
+    const std::vector<std::uint64_t>& sizeColumn() const { return sizes; }
+    const std::vector<Digest>& digestColumn() const { return digests; }
+
+    std::uint64_t fileSize(RowId row) const { return sizes[row]; }
+    std::uint64_t device(RowId row) const { return devices[row]; }
+    std::uint64_t inode(RowId row) const { return inodes[row]; }
+    std::int64_t mtime(RowId row) const { return mtimes[row]; }
+    std::uint64_t links(RowId row) const { return linkCounts[row]; }
+    std::uint64_t blocks(RowId row) const { return blockCounts[row]; }
+    // The row's columns as the statx they came from.
+    FileMetadata metadata(RowId row) const {
+        return FileMetadata{FileType::Regular, sizes[row], devices[row], inodes[row], mtimes[row],
+                            linkCounts[row], blockCounts[row]};
+    }
+    PathId path(RowId row) const { return paths[row]; }
+    Digest digest(RowId row) const { return digests[row]; }
+    DigestState digestState(RowId row) const { return states[row]; }
+
+    // Distinct rows may be written concurrently once the table is populated.
+    void setDigest(RowId row, Digest digest) {
+        digests[row] = digest;
+        states[row] = DigestState::Hashed;
+    }
+    void setDigestFailed(RowId row) { states[row] = DigestState::Failed; }
+
+    // Every row, ordered by size.
+    std::vector<RowId> rowsBySize() const;
+
+private:
+    std::vector<std::uint64_t> sizes;
+    std::vector<std::uint64_t> devices;
+    std::vector<std::uint64_t> inodes;
+    std::vector<std::int64_t> mtimes;
+    std::vector<std::uint64_t> linkCounts;
+    std::vector<std::uint64_t> blockCounts;
+    std::vector<Digest> digests;
+    std::vector<DigestState> states;
+    std::vector<PathId> paths;
+};
+
+// Stable LSD radix sort of rows by column[row], 8 bits per pass. Keys are
+// gathered into a contiguous scratch array first, and passes in which every
+// key shares the same byte are skipped.
+void radixSortRows(std::vector<RowId>& rows, const std::vector<std::uint64_t>& column);
+
+} // namespace FileComparator
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "FileComparator.hpp"
+#include "FileTable.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace FileComparator {
+
+struct GroupKey {
+    std::uint64_t size;
+    Digest digest;
+
+    bool operator==(const GroupKey&) const = default;
+};
+
+// Open-addressing map from (size, digest) to the rows sharing it. Every slot
+// stores its first member inline, so the common singleton group costs no
+// allocation; further members are chained through one shared overflow array
+// instead of a vector per key.
+class FlatGroupMap {
+public:
+    explicit FlatGroupMap(std::size_t expectedKeys = 0);
+
+    void insert(const GroupKey& key, RowId member);
+
+    // Appends every group of other, keeping other's member order after ours.
+    void merge(const FlatGroupMap& other);
+
+    std::size_t groupCount() const { return used; }
+    std::size_t memberCount() const { return members; }
+
+    // Cursor access for callers that cannot use a visitor, such as
+    // coroutines: fills key and rows and returns true if slot holds a group.
+    std::size_t slotCount() const { return slots.size(); }
+    bool readGroup(std::size_t slot, GroupKey& key, std::vector<RowId>& rows) const;
+
+    // Calls visit(key, rows) for every group; rows are in insertion order.
+    template<typename Visit>
+    void forEachGroup(Visit&& visit) const {
+        GroupKey key{};
+        std::vector<RowId> rows;
+        for (std::size_t slot = 0; slot < slots.size(); ++slot) {
+            if (readGroup(slot, key, rows)) visit(key, rows);
+        }
+    }
+
+    // Builds a map over count items, where item(i) returns the (key, row) pair
+    // for index i. Contiguous ranges are grouped into thread-local partial maps
+    // on the pool and merged in range order, so the result matches a serial
+    // build. Must not be called from a pool worker.
+    template<typename Item>
+    static FlatGroupMap buildParallel(std::size_t count, Item item, std::size_t partitions,
+                                      ThreadPool& pool = sharedThreadPool()) {
+        partitions = std::max<std::size_t>(1, std::min(partitions, count / MIN_PARTITION + 1));
+        std::vector<std::future<FlatGroupMap>> partials;
+        for (std::size_t p = 0; p < partitions; ++p) {
+            const std::size_t begin = count * p / partitions;
+            const std::size_t end = count * (p + 1) / partitions;
+            partials.push_back(pool.enqueue([begin, end, &item]() {
+                FlatGroupMap partial(end - begin);
+                for (std::size_t i = begin; i < end; ++i) {
+                    const auto [key, row] = item(i);
+                    partial.insert(key, row);
+                }
+                return partial;
+            }));
+        }
+        FlatGroupMap result = partials.front().get();
+        for (std::size_t p = 1; p < partials.size(); ++p) {
+            result.merge(partials[p].get());
+        }
+        return result;
+    }
+
+private:
+    static constexpr std::uint32_t NO_LINK = UINT32_MAX;
+    static constexpr std::size_t MIN_PARTITION = 16 * 1024;
+
+    struct Slot {
+        GroupKey key;
+        RowId first;
+        std::uint32_t count;    // 0 marks an empty slot
+        std::uint32_t overflowHead;
+        std::uint32_t overflowTail;
+    };
+
+    struct Link {
+        RowId member;
+        std::uint32_t next;
+    };
+
+    static std::size_t hashKey(const GroupKey& key);
+    Slot& findSlot(const GroupKey& key);
+    void append(Slot& slot, RowId member);
+    void grow();
+
+    std::vector<Slot> slots;
+    std::vector<Link> overflow;
+    std::size_t used = 0;
+    std::size_t members = 0;
+};
+
+} // namespace FileComparator
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "FileComparator.hpp"
+#include "ManifestCompare.hpp"
+#include "TreeDiff.hpp"
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace FileComparator {
+
+enum class OutputFormat { Text, Ndjson, Csv };
+
+std::optional<OutputFormat> parseOutputFormat(const std::string& name);
+
+// Accumulates output in a large buffer and hands it to the stream in big
+// writes. Records are only flushed at record boundaries, so a reader tailing
+// the output never sees a partial record.
+class BufferedWriter {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 1 << 20;
+
+    explicit BufferedWriter(std::ostream& out, size_t capacity = DEFAULT_CAPACITY);
+    ~BufferedWriter();
+
+    BufferedWriter(const BufferedWriter&) = delete;
+    BufferedWriter& operator=(const BufferedWriter&) = delete;
+
+    void write(std::string_view text) { buffer.append(text); }
+    void put(char c) { buffer.push_back(c); }
+    void writeNumber(unsigned long long value);
+
+    // Marks the end of a record; flushes once the buffer reaches capacity.
+    void endRecord();
+    void flush();
+
+private:
+    std::ostream& out;
+    std::string buffer;
+    size_t capacity;
+};
+
+// Writes one record per group in the selected format:
+//   text   - the human-readable listing
+//   ndjson - {"kind":"duplicate","size":N,"hash":"..","files":["..",..]}
+//   csv    - kind,size,hash,path1,path2,...
+// Tree diff entries are written as {"kind":"only-left","path":".."} and
+// only-left,path respectively. Manifest comparisons name the source of each
+// file: "files":[{"source":"a.fsm","path":".."},..] and
+// kind,size,hash,source1,path1,source2,path2,...
+class GroupWriter {
+public:
+    GroupWriter(std::ostream& out, OutputFormat format);
+
+    void writeDuplicate(const DuplicateGroup& group);
+    void writeUnique(const FileInfo& file);
+    void writeDifferent(const std::string& name, const std::vector<FileInfo>& files);
+    void writeDiff(const DiffEntry& entry);
+    void writeCross(const CrossGroup& group, const std::vector<std::string>& sources);
+    // Free-form status lines; only emitted in text format.
+    void writeNote(std::string_view text);
+    void flush() { writer.flush(); }
+
+private:
+    void writeRecord(std::string_view kind, std::optional<std::size_t> size, std::string_view hash,
+                     const std::vector<FileInfo>& files);
+    void writeJsonString(std::string_view text);
+    void writeCsvField(std::string_view text);
+
+    BufferedWriter writer;
+    OutputFormat format;
+};
+
+} // namespace FileComparator
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "FileMetadata.hpp"
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace FileComparator {
+
+using Digest = std::uint64_t;
+
+// 64-bit FNV-1a, fed incrementally. Bytes are sign-extended as in the
+// original calculateHash, so digests match those of computeHashAsync.
+class Fnv1a {
+public:
+    static constexpr Digest OFFSET = 14695981039346656037ULL;
+    static constexpr Digest PRIME = 1099511628211ULL;
+
+    void update(const char* data, std::size_t size) {
+        Digest h = hash;
+        for (std::size_t i = 0; i < size; ++i) {
+            h ^= static_cast<Digest>(data[i]);
+            h *= PRIME;
+        }
+        hash = h;
+    }
+
+    // Same as update() over count zero bytes: XOR with zero is a no-op, so
+    // the run folds into one multiplication by PRIME^count, in O(log count).
+    void updateZeros(std::uint64_t count) {
+        Digest factor = 1;
+        for (Digest base = PRIME; count > 0; count >>= 1, base *= base) {
+            if (count & 1) factor *= base;
+        }
+        hash *= factor;
+    }
+
+    Digest value() const { return hash; }
+
+private:
+    Digest hash = OFFSET;
+};
+
+Digest calculateDigest(const char* data, std::size_t size);
+std::string digestToHex(Digest digest);
+std::optional<Digest> digestFromHex(const std::string& hex);
+
+// Digest of a file's content, read in fixed-size chunks; nullopt if the
+// file cannot be read, after recording the error with Errors. Symlinks are
+// not followed here. Sparse files are walked extent by extent with
+// SEEK_DATA/SEEK_HOLE and their holes folded in with Fnv1a::updateZeros,
+// so the digest is that of the logical content but only allocated bytes are
+// read.
+std::optional<Digest> digestFile(const std::string& path);
+// The same for a regular file whose metadata came from the scan: whether it
+// is sparse is known, so the file is not stat-ed again.
+std::optional<Digest> digestFile(const std::string& path, const FileMetadata& metadata);
+
+// Files at most this large are hashed where the walk finds them, with one
+// openat and a read into a stack buffer: queueing them to a pool would cost
+// more than the hashing.
+inline constexpr std::size_t TINY_FILE_BYTES = 4096;
+
+// Digest of the file name in directoryFd (AT_FDCWD for a path), of at most
+// TINY_FILE_BYTES, whose scan found it size bytes long; nullopt if it
+// cannot be read or no longer holds exactly that many bytes, in which case
+// digestFile is the fallback and records any error.
+std::optional<Digest> digestTinyFile(int directoryFd, const char* name, std::uint64_t size);
+
+// How much of a file its head digest covers. For a file no larger, the head
+// digest is its digest.
+inline constexpr std::size_t HEAD_DIGEST_BYTES = 4096;
+
+// Digest of the first HEAD_DIGEST_BYTES of a file, read with one pread;
+// nullopt if it cannot be read, after recording the error with Errors.
+std::optional<Digest> digestFileHead(const std::string& path);
+
+} // namespace FileComparator
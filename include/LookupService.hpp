@@ -0,0 +1,135 @@
+#pragma once
+
+#include "Hashing.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace FileComparator {
+
+// A local daemon answering "is this digest known?" and "which paths hold
+// it?" from a manifest or reference index kept in memory, so that upload
+// handlers and backup agents need not start a scan per question.
+//
+// Requests and responses are frames over a Unix stream socket, in the
+// ShardProtocol layout with every integer little-endian:
+//
+//   frame     := type:u8 length:u32 payload[length]
+//   Contains  := count:u32 digest:u64*count
+//             -> count:u32 bitmap[(count + 7) / 8], bit i set if digest i is known
+//   Paths     := count:u32 digest:u64*count
+//             -> count:u32 (pathCount:u32 (pathLength:u32 path)*)*count
+//
+// Each response carries the type of its request. Requests on a connection
+// are answered in order, so a client may pipeline them. A malformed request
+// closes the connection.
+enum class LookupRequest : std::uint8_t { Contains = 1, Paths = 2 };
+
+class LookupError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// The digests of a manifest's hashed files or of a reference index's
+// entries, with their paths, sorted by digest.
+class LookupTable {
+public:
+    // Reads a manifest or a reference index, told apart by its magic.
+    // Throws LookupError.
+    static std::shared_ptr<const LookupTable> load(const std::string& path);
+
+    std::size_t size() const { return digests.size(); }
+    bool contains(Digest digest) const;
+    std::vector<std::string_view> paths(Digest digest) const;
+
+private:
+    void add(Digest digest, std::string_view path);
+    void sort();
+
+    std::vector<Digest> digests;
+    std::vector<std::uint64_t> pathOffsets{0};   // path i is [pathOffsets[i], pathOffsets[i + 1])
+    std::string strings;
+};
+
+struct LookupServerOptions {
+    // How often the data file is checked for replacement. Manifests and
+    // reference indexes are replaced by rename, so a new inode or mtime
+    // means a complete new file. A new file is loaded on a thread of its
+    // own while the old one keeps serving, and swapped in once complete.
+    std::chrono::milliseconds reloadInterval{1000};
+};
+
+class LookupServer {
+public:
+    // Loads dataPath and listens on socketPath, replacing a stale socket
+    // there. Throws LookupError.
+    LookupServer(std::string dataPath, std::string socketPath, LookupServerOptions options = {});
+    ~LookupServer();
+
+    LookupServer(const LookupServer&) = delete;
+    LookupServer& operator=(const LookupServer&) = delete;
+
+    // Serves on the calling thread until stop().
+    void run();
+    // Safe from any thread and from a signal handler.
+    void stop();
+
+    // Times the data file has been loaded, the first load included.
+    std::size_t loads() const { return loadCount.load(std::memory_order_relaxed); }
+
+private:
+    struct Connection;
+
+    struct FileIdentity {
+        std::uint64_t device = 0, inode = 0, size = 0;
+        std::int64_t mtime = 0;
+        bool operator==(const FileIdentity&) const = default;
+    };
+
+    std::optional<FileIdentity> identifyData() const;
+    void startReloadIfChanged();
+    // Swaps in the table a finished reload built.
+    void finishReload();
+    bool handle(Connection& connection);
+
+    std::string dataPath;
+    std::string socketPath;
+    LookupServerOptions options;
+    std::shared_ptr<const LookupTable> table;
+    FileIdentity loaded;
+    std::thread reloader;
+    std::future<std::shared_ptr<const LookupTable>> reloading;
+    int listener = -1;
+    int wakeRead = -1;
+    int wakeWrite = -1;
+    std::atomic<std::size_t> loadCount{0};
+};
+
+// A blocking client for one connection to a LookupServer. Throws
+// LookupError if the server cannot be reached or breaks the protocol.
+class LookupClient {
+public:
+    explicit LookupClient(const std::string& socketPath);
+    ~LookupClient();
+
+    LookupClient(const LookupClient&) = delete;
+    LookupClient& operator=(const LookupClient&) = delete;
+
+    std::vector<bool> contains(const std::vector<Digest>& digests);
+    std::vector<std::vector<std::string>> paths(const std::vector<Digest>& digests);
+
+private:
+    std::string exchange(LookupRequest type, const std::vector<Digest>& digests);
+
+    int fd = -1;
+};
+
+} // namespace FileComparator
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "FileComparator.hpp"
+#include "FileTable.hpp"
+#include "Hashing.hpp"
+#include "PathTable.hpp"
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace FileComparator {
+
+// A scan saved as a versioned binary manifest, written once and memory-mapped
+// to query. Little-endian, with every block 8-byte aligned:
+//
+//   header     magic "FS2MANIF", version, block count, file and node counts
+//   directory  one {kind, element size, offset, count} entry per block
+//   blocks     string table; node parent, name offset and name length
+//              columns; file node, size, digest and flag columns; digest index
+//
+// Paths are a tree of nodes, each holding its own name and its parent, as in
+// PathTable. The digest index lists every file ordered by (size, digest), so
+// each duplicate group is one contiguous run. Readers ignore block kinds they
+// do not know, so later versions can add columns without breaking them.
+class ManifestError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+class ManifestWriter {
+public:
+    // The scanned roots become the root nodes, so relative paths are taken
+    // below them; without roots, the first path component is the root.
+    explicit ManifestWriter(const std::vector<std::string>& roots = {});
+
+    void add(const DuplicateGroup& group);
+
+    // Writes to a temporary file beside path and renames it into place.
+    // Throws ManifestError.
+    void write(const std::string& path) const;
+
+    std::size_t fileCount() const { return fileNodes.size(); }
+
+private:
+    PathId internDirectory(std::string_view directory);
+
+    PathTable nodes;
+    std::unordered_map<std::string, PathId> directories;
+    std::vector<std::uint32_t> fileNodes;
+    std::vector<std::uint64_t> sizes;
+    std::vector<std::uint64_t> digests;
+    std::vector<std::uint8_t> flags;
+};
+
+// Read-only view of a manifest file through mmap. Opening validates the
+// header and that every block lies within the file; nothing is copied.
+class Manifest {
+public:
+    explicit Manifest(const std::string& path);   // throws ManifestError
+    ~Manifest();
+
+    Manifest(const Manifest&) = delete;
+    Manifest& operator=(const Manifest&) = delete;
+
+    std::size_t fileCount() const { return files; }
+    std::uint64_t createdAt() const { return created; }
+
+    std::uint64_t fileSize(RowId row) const { return sizeColumn[row]; }
+    Digest digest(RowId row) const { return digestColumn[row]; }
+    // False for files that were never hashed because no other file shared
+    // their size (see GroupingOptions::hashUnique).
+    bool hashed(RowId row) const { return flagColumn[row] & HASHED; }
+    std::string path(RowId row) const;
+    // The path below the scanned root, which is comparable between scans of
+    // the same tree mounted at different places.
+    std::string relativePath(RowId row) const;
+    std::string_view name(RowId row) const { return nodeName(fileNodeColumn[row]); }
+
+    // The row at position i of the (size, digest) index.
+    RowId indexed(std::size_t i) const { return indexColumn[i]; }
+
+    // The stored groups, rebuilt from the index in (size, digest) order.
+    // The manifest must outlive the generator.
+    Generator<DuplicateGroup> groups() const;
+
+    FileInfo fileInfo(RowId row) const;
+
+    static constexpr std::uint8_t HASHED = 1;
+
+private:
+    std::string_view nodeName(std::uint32_t node) const;
+    std::string buildPath(RowId row, bool withRoot) const;
+
+    const char* base = nullptr;
+    std::size_t length = 0;
+    std::uint64_t files = 0;
+    std::uint64_t nodeCount = 0;
+    std::uint64_t created = 0;
+
+    const char* strings = nullptr;
+    std::uint64_t stringBytes = 0;
+    const std::uint32_t* nodeParentColumn = nullptr;
+    const std::uint64_t* nodeNameOffsetColumn = nullptr;
+    const std::uint32_t* nodeNameLengthColumn = nullptr;
+    const std::uint32_t* fileNodeColumn = nullptr;
+    const std::uint64_t* sizeColumn = nullptr;
+    const std::uint64_t* digestColumn = nullptr;
+    const std::uint8_t* flagColumn = nullptr;
+    const std::uint32_t* indexColumn = nullptr;
+};
+
+} // namespace FileComparator
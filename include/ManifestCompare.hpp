@@ -0,0 +1,39 @@
+#pragma once
+
+#include "FileComparator.hpp"
+#include "Manifest.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace FileComparator {
+
+// How one piece of content is spread over the compared manifests.
+//   Missing - absent from at least one manifest
+//   Moved   - in every manifest, but at no relative path common to all
+//   Shared  - in every manifest at a common relative path, so a migration
+//             between them would copy it again
+enum class CrossStatus { Missing, Moved, Shared };
+
+const char* toString(CrossStatus status);
+
+struct CrossFile {
+    std::size_t manifest;   // index into the compared manifests
+    std::string path;
+};
+
+struct CrossGroup {
+    CrossStatus status;
+    std::uint64_t size;
+    std::string hash;
+    std::vector<CrossFile> files;   // ordered by manifest
+};
+
+// Merge-joins the (size, digest) indexes of the manifests, so the cost is
+// linear in their total size and no filesystem is touched. Files that were
+// never hashed (saved without GroupingOptions::hashUnique) cannot be matched
+// by content; they are skipped and counted on stderr. The manifests must
+// outlive the generator.
+Generator<CrossGroup> compareManifests(std::vector<const Manifest*> manifests);
+
+} // namespace FileComparator
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+namespace FileComparator::Metrics {
+
+// Per-stage pipeline timing and counters, kept per thread and merged only
+// when reported. Everything is off by default: each probe then costs one
+// relaxed atomic load and a branch.
+enum class Stage : std::uint8_t {
+    Traverse,    // walking directories and stat-ing entries
+    Read,        // read/pread calls while hashing
+    Hash,        // folding bytes into digests
+    QueueWait,   // a pool task waiting between enqueue and start
+    Task,        // a pool task running
+    Group,       // building digest groups for a size class
+    Count
+};
+
+enum class Counter : std::uint8_t {
+    Directories,
+    Files,
+    BytesRead,
+    FilesHashed,
+    Tasks,
+    QueueDepthSum,   // queue depth seen by each enqueue, for the mean
+    Count
+};
+
+namespace Detail {
+    inline std::atomic<bool> collecting{false};
+    inline std::atomic<bool> tracing{false};
+}
+
+inline bool enabled() { return Detail::collecting.load(std::memory_order_relaxed); }
+
+// Starts collecting; with trace, every span is also kept as an event for
+// writeTrace. Call before the work to measure starts.
+void enable(bool trace);
+// Stops collecting; what was collected stays until reset.
+void disable();
+// Zeroes every stage, counter and kept event, for measuring another run in
+// the same process. Call while no measured work is running.
+void reset();
+
+// Monotonic nanoseconds.
+std::uint64_t now();
+
+void add(Stage stage, std::uint64_t nanoseconds);
+void count(Counter counter, std::uint64_t amount = 1);
+// Records the pool queue depth seen by an enqueue.
+void observeQueueDepth(std::size_t depth);
+// Adds a trace event only; name must be a string literal.
+void trace(const char* name, Stage stage, std::uint64_t start, std::uint64_t end);
+
+// Times a scope into stage and, when tracing, as a trace event.
+class Span {
+public:
+    Span(Stage stage, const char* name) : stage(stage), name(name), start(enabled() ? now() : 0) {}
+    ~Span() {
+        if (start == 0) return;
+        const std::uint64_t end = now();
+        add(stage, end - start);
+        trace(name, stage, start, end);
+    }
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+private:
+    Stage stage;
+    const char* name;
+    std::uint64_t start;
+};
+
+// A table of per-stage time and counts, plus the counters, over all threads.
+void writeSummary(std::ostream& out);
+
+// Chrome trace-event JSON (chrome://tracing, Perfetto): one complete event
+// per span, one track per thread. Each thread keeps at most a fixed number
+// of events; the summary notes any that were dropped.
+void writeTrace(std::ostream& out);
+
+} // namespace FileComparator::Metrics
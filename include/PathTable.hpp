@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace FileComparator {
+
+using PathId = std::uint32_t;
+
+// Interned storage for the paths of a scan. Each entry holds only its parent
+// and its own name, with the name bytes packed into an append-only arena, so a
+// directory prefix shared by a million files is stored once. Full paths are
+// rebuilt on demand, typically only for hashing and output.
+//
+// Not thread-safe while entries are being added; safe for concurrent reads
+// once population is complete.
+class PathTable {
+public:
+    static constexpr PathId NO_PARENT = UINT32_MAX;
+
+    PathTable() = default;
+    PathTable(const PathTable&) = delete;
+    PathTable& operator=(const PathTable&) = delete;
+    PathTable(PathTable&&) = default;
+    PathTable& operator=(PathTable&&) = default;
+
+    // Adds a root such as "dir" or "/mnt/data"; stored verbatim as one name.
+    PathId addRoot(std::string_view path) { return add(NO_PARENT, path); }
+    PathId add(PathId parent, std::string_view name);
+
+    PathId parent(PathId id) const { return entries[id].parent; }
+    std::string_view name(PathId id) const { return {entries[id].name, entries[id].length}; }
+    std::string fullPath(PathId id) const;
+    void appendPath(PathId id, std::string& out) const;
+
+    std::size_t size() const { return entries.size(); }
+    std::size_t memoryUsage() const;
+
+private:
+    static constexpr std::size_t BLOCK_SIZE = 64 * 1024;
+
+    struct Entry {
+        const char* name;
+        std::uint32_t length;
+        PathId parent;
+    };
+
+    const char* store(std::string_view name);
+
+    std::vector<Entry> entries;
+    std::vector<std::unique_ptr<char[]>> blocks;
+    std::size_t blockUsed = 0;
+    std::size_t blockCapacity = 0;
+    std::size_t arenaBytes = 0;
+};
+
+} // namespace FileComparator
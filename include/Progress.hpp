@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace FileComparator::Progress {
+
+// Live scan progress. The pipeline bumps a few relaxed atomic counters -
+// per directory entry while walking, per hash batch while hashing, per
+// group when yielding - and a Reporter thread samples them at a fixed rate.
+// Nothing is formatted or written on the scanning threads.
+enum class Counter : std::uint8_t {
+    Entries,        // directory entries seen by the walk
+    FilesQueued,    // files handed to hashing
+    BytesQueued,
+    FilesHashed,
+    BytesHashed,
+    Groups,         // groups yielded
+    Count
+};
+
+namespace Detail {
+    inline std::atomic<bool> active{false};
+    inline std::atomic<bool> walking{false};
+    inline std::atomic<std::uint64_t> counters[static_cast<std::size_t>(Counter::Count)];
+}
+
+inline bool active() { return Detail::active.load(std::memory_order_relaxed); }
+
+inline void add(Counter counter, std::uint64_t amount = 1) {
+    if (!active()) return;
+    Detail::counters[static_cast<std::size_t>(counter)].fetch_add(amount, std::memory_order_relaxed);
+}
+
+// Marks the walk phase, during which no ETA can be given: the amount of
+// work is still unknown.
+inline void setWalking(bool walking) {
+    if (active()) Detail::walking.store(walking, std::memory_order_relaxed);
+}
+
+// A byte count in decimal units, such as "12.3 MB".
+std::string formatBytes(double bytes);
+
+struct Options {
+    std::chrono::milliseconds interval{1000};
+    // Where to write; empty means stderr, which is redrawn in place when it
+    // is a terminal. A status file is replaced atomically with one JSON
+    // object per sample.
+    std::string statusFile;
+};
+
+// Samples the counters every interval until destroyed, then prints a final
+// line. Only one Reporter may exist at a time.
+class Reporter {
+public:
+    explicit Reporter(Options options);
+    ~Reporter();
+
+    Reporter(const Reporter&) = delete;
+    Reporter& operator=(const Reporter&) = delete;
+
+private:
+    void run();
+    void emit(bool final);
+
+    Options options;
+    std::chrono::steady_clock::time_point started;
+    std::chrono::steady_clock::time_point lastChange;
+    std::uint64_t lastEntries = 0;
+    std::uint64_t lastBytes = 0;
+    std::uint64_t lastFiles = 0;
+    std::chrono::steady_clock::time_point lastSample;
+    double entryRate = 0;   // smoothed, per second
+    double byteRate = 0;
+    bool terminal = false;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::thread thread;
+};
+
+} // namespace FileComparator::Progress
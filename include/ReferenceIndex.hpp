@@ -0,0 +1,129 @@
+#pragma once
+
+#include "FileMetadata.hpp"
+#include "Hashing.hpp"
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace FileComparator {
+
+// A persistent index of the contents stored in a reference tree, to ask
+// whether a new file is already there without touching that tree. Each
+// distinct content is one entry of (size, head digest, digest, one path
+// holding it), sorted in that order, and a split-block Bloom filter over
+// (size, head digest) sits in front. A file that is not stored is almost
+// always turned away by one filter probe, which touches a single cache
+// line; one that passes is looked up by binary search, and its full digest
+// is computed only if its head digest matches an entry.
+//
+// On disk it is laid out like a manifest (see Manifest.hpp): header magic
+// "FS2REFIX", then a block directory, then cache-line aligned blocks for the
+// filter, the three entry columns, path offsets and path strings.
+class ReferenceIndexError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+class ReferenceIndexWriter {
+public:
+    void add(std::uint64_t size, Digest head, Digest digest, std::string_view path);
+
+    // Drops repeated contents, keeping the first path added for each, builds
+    // the filter and writes to a temporary file beside path before renaming
+    // it into place. Throws ReferenceIndexError.
+    void write(const std::string& path) const;
+
+    std::size_t size() const { return sizes.size(); }
+
+private:
+    std::vector<std::uint64_t> sizes;
+    std::vector<std::uint64_t> heads;
+    std::vector<std::uint64_t> digests;
+    std::vector<std::uint64_t> pathOffsets{0};   // entry i's path is [pathOffsets[i], pathOffsets[i + 1])
+    std::string strings;
+};
+
+enum class ReferenceOutcome : std::uint8_t {
+    Filtered,     // turned away by the filter
+    Absent,       // passed the filter but no entry matched
+    Present,
+    Unreadable,   // the error was recorded with Errors
+};
+
+struct ReferenceResult {
+    ReferenceOutcome outcome = ReferenceOutcome::Absent;
+    std::string reference;   // a reference path with the same content, if Present
+    bool fullyHashed = false;
+};
+
+// Read-only view of an index file through mmap; nothing is copied, and
+// lookups may run concurrently.
+class ReferenceIndex {
+public:
+    explicit ReferenceIndex(const std::string& path);   // throws ReferenceIndexError
+    ~ReferenceIndex();
+
+    ReferenceIndex(const ReferenceIndex&) = delete;
+    ReferenceIndex& operator=(const ReferenceIndex&) = delete;
+
+    std::size_t size() const { return entries; }
+    std::uint64_t createdAt() const { return created; }
+
+    // False means no entry has this size and head digest.
+    bool mayContain(std::uint64_t size, Digest head) const;
+    // A path holding this content, or an empty string.
+    std::string find(std::uint64_t size, Digest head, Digest digest) const;
+
+    // Checks a regular file whose metadata came from a scan, reading its
+    // head and, only when an entry shares size and head, all of it.
+    ReferenceResult lookup(const std::string& path, const FileMetadata& metadata) const;
+
+    // Entry i, in (size, head digest, digest) order.
+    std::uint64_t entrySize(std::uint64_t entry) const { return sizeColumn[entry]; }
+    Digest entryDigest(std::uint64_t entry) const { return digestColumn[entry]; }
+    std::string entryPath(std::uint64_t entry) const;
+
+private:
+    // Entries with this size and head digest, as [first, last) positions.
+    std::pair<std::uint64_t, std::uint64_t> headRange(std::uint64_t size, Digest head) const;
+
+    const char* base = nullptr;
+    std::size_t length = 0;
+    std::uint64_t entries = 0;
+    std::uint64_t filterBlocks = 0;
+    std::uint64_t created = 0;
+
+    const std::uint64_t* filterColumn = nullptr;
+    const std::uint64_t* sizeColumn = nullptr;
+    const std::uint64_t* headColumn = nullptr;
+    const std::uint64_t* digestColumn = nullptr;
+    const std::uint64_t* pathOffsetColumn = nullptr;
+    const char* strings = nullptr;
+    std::uint64_t stringBytes = 0;
+};
+
+// Walks roots, hashes the head and content of every regular file on the
+// shared pool, and writes the index to output. Returns the number of
+// distinct contents stored. Throws ReferenceIndexError.
+std::size_t buildReferenceIndex(const std::vector<std::string>& roots, const std::string& output);
+
+struct ReferenceCheckSummary {
+    std::uint64_t files = 0;
+    std::uint64_t present = 0;
+    std::uint64_t filtered = 0;
+    std::uint64_t absent = 0;       // not filtered
+    std::uint64_t unreadable = 0;
+    std::uint64_t fullyHashed = 0;
+};
+
+// Looks up every regular file under roots, in parallel, and hands each
+// result to onFile on the calling thread in walk order.
+ReferenceCheckSummary checkReference(
+    const ReferenceIndex& index, const std::vector<std::string>& roots,
+    const std::function<void(const std::string& path, const ReferenceResult& result)>& onFile);
+
+} // namespace FileComparator
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "FileComparator.hpp"
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace FileComparator {
+
+// Everything a duplicate scan can be asked to do, for embedding the scanner
+// in another program rather than running the CLI.
+struct ScanOptions {
+    GroupingOptions grouping;
+    // Group out of core within about this many bytes (groupByContentExternal).
+    std::optional<std::size_t> memoryBudget;
+    // Where out-of-core spill files go; empty means $TMPDIR, then /tmp.
+    std::string tempDirectory;
+    // Split the scan across this many worker processes (groupByContentSharded,
+    // which needs runShardWorker called from main); 0 scans in this process.
+    std::size_t shards = 0;
+    bool pinShards = false;
+};
+
+struct ScanSummary {
+    std::uint64_t groups = 0;
+    std::uint64_t files = 0;
+    std::uint64_t duplicateGroups = 0;    // groups of two or more files
+    std::uint64_t reclaimableBytes = 0;   // size times extra copies, over those groups
+    std::uint64_t errors = 0;             // recorded with Errors during the scan
+    bool stopped = false;                 // the callback ended the scan early
+};
+
+// Receives each group as soon as its size class is resolved; returning
+// false ends the scan, abandoning work still queued.
+using GroupCallback = std::function<bool(DuplicateGroup&& group)>;
+
+// The groups of the files under roots, from whichever engine the options
+// select: in memory, out of core or sharded. Groups stream out while later
+// size classes are still being hashed. Throws std::invalid_argument for
+// options that cannot be combined (archives or shards with a memory budget).
+Generator<DuplicateGroup> scanGroups(std::vector<std::string> roots, ScanOptions options = {});
+
+// The same, delivered to onGroup on the calling thread. The error count is
+// the growth of Errors::total() over the scan, so it includes errors from
+// any other scan running at the same time. Errors of sharded workers are
+// merged into Errors as each worker finishes, so they are counted too.
+ScanSummary scanGroups(const std::vector<std::string>& roots, const GroupCallback& onGroup,
+                       const ScanOptions& options = {});
+
+} // namespace FileComparator
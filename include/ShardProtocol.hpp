@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Errors.hpp"
+#include "FileComparator.hpp"
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+namespace FileComparator {
+
+// Wire format between shard workers and the coordinator. It is independent
+// of the transport (pipe, Unix socket or TCP stream) and of the host: every
+// integer is little-endian.
+//
+//   frame   := type:u8 length:u32 payload[length]
+//   Group   := size:u64 flags:u8 [digest:u64] count:u32 (pathLength:u32 path)*
+//   End     := empty; the worker finished its shard
+//   Error   := operation:u8 errno:u32 count:u64 samples:u32 (pathLength:u32 path)*
+//
+// A file's name is the last component of its path and its size is the
+// group's, so neither is sent. Flag bit 0 says a digest follows; bit 1 says
+// the group continues in the next frame, which is how a group too large for
+// one frame is sent. A worker sends one Error frame per
+// (operation, errno) it recorded, after its groups, for the coordinator to
+// merge into its own Errors.
+enum class FrameType : std::uint8_t { Group = 1, End = 2, Error = 3 };
+
+struct Frame {
+    FrameType type;
+    DuplicateGroup group;   // set for Group frames
+    Errors::Summary error{};   // set for Error frames
+};
+
+class ProtocolError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Larger frames are treated as corruption rather than allocated.
+constexpr std::size_t MAX_FRAME_PAYLOAD = std::size_t{1} << 30;
+
+// Splits the group across frames of at most maxPayload bytes. Throws
+// ProtocolError if a single path does not fit in one.
+void encodeGroup(const DuplicateGroup& group, std::string& out, std::size_t maxPayload = MAX_FRAME_PAYLOAD);
+void encodeEnd(std::string& out);
+void encodeError(const Errors::Summary& error, std::string& out);
+
+// Reassembles frames from a byte stream delivered in arbitrary chunks.
+class FrameDecoder {
+public:
+    void feed(const char* data, std::size_t size);
+
+    // The next complete frame, or nullopt until more bytes arrive. Throws
+    // ProtocolError on a malformed frame.
+    std::optional<Frame> next();
+
+    // True if a partial frame, or part of a group, is still buffered.
+    bool hasPartialFrame() const { return position != buffer.size() || pending; }
+
+private:
+    std::string buffer;
+    std::optional<DuplicateGroup> pending;   // a group whose next frame is due
+    std::size_t position = 0;
+};
+
+} // namespace FileComparator
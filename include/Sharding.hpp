@@ -0,0 +1,54 @@
+#pragma once
+
+#include "FileComparator.hpp"
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace FileComparator {
+
+struct ShardOptions {
+    std::size_t workers = 2;
+    // Pin each worker to its own contiguous slice of the allowed CPUs, which
+    // on most machines keeps a worker on one NUMA node.
+    bool pinWorkers = false;
+    GroupingOptions grouping;
+};
+
+// Which of shardCount shards owns files of the given size. Files that could
+// be duplicates share a size, so every group falls within one shard.
+std::size_t shardOfSize(std::uint64_t size, std::size_t shardCount);
+
+// Which shard reads the archive at path when archives are scanned. Its
+// members come in all sizes, so one shard reads it and lists every member
+// rather than each shard reading it for the members of its own sizes.
+std::size_t shardOfArchive(const std::string& path, std::size_t shardCount);
+
+// groupByContent split across worker processes. Every worker walks
+// all roots but keeps only the size classes of its shard, hashes them on a
+// pool of its own and streams the groups back over a pipe (see
+// ShardProtocol.hpp), followed by the errors it recorded, which the
+// coordinator merges into its own Errors. The coordinator yields groups as
+// they arrive. A worker
+// that crashes or sends a malformed stream is reported on stderr and its
+// shard is skipped; the other shards are unaffected.
+//
+// With grouping.scanArchives, each archive is read by shardOfArchive's
+// shard alone. Its members are grouped with the files and members that
+// shard holds, so a member whose size belongs to another shard is not
+// matched against that shard's files.
+//
+// Workers are fresh copies of the running program, started through
+// /proc/self/exe, since a forked copy of a process with threads may inherit
+// a lock some other thread held. The program must therefore call
+// runShardWorker first thing in main; without it this throws
+// std::logic_error.
+Generator<DuplicateGroup> groupByContentSharded(std::vector<std::string> directories, ShardOptions options = {});
+
+// If argv asks for a shard worker, runs it and returns its exit status, for
+// main to return; otherwise returns nothing and the program goes on as
+// usual.
+std::optional<int> runShardWorker(int argc, char* argv[]);
+
+} // namespace FileComparator
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "FileComparator.hpp"
+#include <string>
+#include <string_view>
+
+namespace FileComparator {
+
+enum class DiffStatus { OnlyLeft, OnlyRight, Same, Different };
+
+struct DiffEntry {
+    DiffStatus status;
+    std::string path;   // relative to both roots, '/'-separated
+};
+
+struct DiffOptions {
+    // Hash every same-sized pair instead of trusting equal size and mtime
+    // (rsync --checksum).
+    bool checksum = false;
+};
+
+const char* toString(DiffStatus status);
+
+// Orders relative paths component by component, which is the order in which
+// diffTrees walks a tree: "a/b" sorts before "a.txt".
+int compareRelativePaths(std::string_view a, std::string_view b);
+
+// Pairs the files under two roots by relative path. Both trees are walked in
+// sorted order and merge-joined, so memory is bounded by directory fan-out
+// rather than tree size. Pairs whose sizes differ are reported without
+// hashing, as are pairs with equal size and mtime unless options.checksum is
+// set. Symlinks are compared by target and never followed.
+Generator<DiffEntry> diffTrees(std::string left, std::string right, DiffOptions options = {});
+
+} // namespace FileComparator
@@ -0,0 +1,443 @@
+#include "Archive.hpp"
+#include "Errors.hpp"
+#include "Metrics.hpp"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace FileComparator {
+
+namespace {
+    constexpr std::size_t CHUNK = 256 * 1024;
+    constexpr std::size_t TAR_BLOCK = 512;
+
+    // A corrupt archive (EBADMSG), or the errno of a failed read.
+    class ArchiveError : public std::runtime_error {
+    public:
+        explicit ArchiveError(const std::string& what, int error = EBADMSG)
+            : std::runtime_error(what), error(error) {}
+
+        int error;
+    };
+
+    class ByteSource {
+    public:
+        virtual ~ByteSource() = default;
+        // Up to size bytes; 0 only at the end of the stream.
+        virtual std::size_t read(char* out, std::size_t size) = 0;
+    };
+
+    // Bytes [begin, end) of a file, read with pread so several sources can
+    // share one descriptor.
+    class FileSource : public ByteSource {
+    public:
+        FileSource(int fd, std::uint64_t begin, std::uint64_t end) : fd(fd), position(begin), end(end) {}
+
+        std::size_t read(char* out, std::size_t size) override {
+            size = static_cast<std::size_t>(std::min<std::uint64_t>(size, end - position));
+            while (size > 0) {
+                const ssize_t n = ::pread(fd, out, size, static_cast<off_t>(position));
+                if (n < 0 && errno == EINTR) continue;
+                if (n < 0) throw ArchiveError(std::strerror(errno), errno);
+                if (n == 0) throw ArchiveError("unexpected end of file");
+                position += static_cast<std::uint64_t>(n);
+                return static_cast<std::size_t>(n);
+            }
+            return 0;
+        }
+
+    private:
+        int fd;
+        std::uint64_t position;
+        std::uint64_t end;
+    };
+
+    // zlib inflate over another source: gzip (concatenated members allowed)
+    // or the raw deflate streams of zip entries.
+    class InflateSource : public ByteSource {
+    public:
+        enum class Wrapper { Gzip, Raw };
+
+        InflateSource(ByteSource& input, Wrapper wrapper) : input(input), wrapper(wrapper), buffer(64 * 1024) {
+            if (inflateInit2(&stream, wrapper == Wrapper::Gzip ? 15 + 16 : -15) != Z_OK) {
+                throw ArchiveError("cannot initialise zlib");
+            }
+        }
+        ~InflateSource() override { inflateEnd(&stream); }
+
+        InflateSource(const InflateSource&) = delete;
+        InflateSource& operator=(const InflateSource&) = delete;
+
+        std::size_t read(char* out, std::size_t size) override {
+            while (!finished) {
+                if (stream.avail_in == 0 && !inputEnded) {
+                    const std::size_t n = input.read(buffer.data(), buffer.size());
+                    inputEnded = n == 0;
+                    stream.next_in = reinterpret_cast<Bytef*>(buffer.data());
+                    stream.avail_in = static_cast<uInt>(n);
+                }
+                stream.next_out = reinterpret_cast<Bytef*>(out);
+                stream.avail_out = static_cast<uInt>(std::min<std::size_t>(size, UINT32_MAX));
+                const int result = inflate(&stream, Z_NO_FLUSH);
+                const std::size_t produced = size - stream.avail_out;
+                if (result == Z_STREAM_END) {
+                    // Another gzip member may follow; raw streams end here.
+                    if (wrapper == Wrapper::Gzip && (stream.avail_in > 0 || refill())) {
+                        inflateReset(&stream);
+                    } else {
+                        finished = true;
+                    }
+                } else if (result == Z_BUF_ERROR && inputEnded && stream.avail_in == 0) {
+                    throw ArchiveError("truncated compressed data");
+                } else if (result != Z_OK && result != Z_BUF_ERROR) {
+                    throw ArchiveError(stream.msg ? stream.msg : "corrupt compressed data");
+                }
+                if (produced > 0) return produced;
+            }
+            return 0;
+        }
+
+    private:
+        bool refill() {
+            if (inputEnded) return false;
+            const std::size_t n = input.read(buffer.data(), buffer.size());
+            inputEnded = n == 0;
+            stream.next_in = reinterpret_cast<Bytef*>(buffer.data());
+            stream.avail_in = static_cast<uInt>(n);
+            return n > 0;
+        }
+
+        ByteSource& input;
+        Wrapper wrapper;
+        std::vector<char> buffer;
+        z_stream stream{};
+        bool inputEnded = false;
+        bool finished = false;
+    };
+
+    // Fills out completely; false if the stream ended first.
+    bool readFull(ByteSource& source, char* out, std::size_t size) {
+        std::size_t done = 0;
+        while (done < size) {
+            const std::size_t n = source.read(out + done, size - done);
+            if (n == 0) {
+                if (done == 0) return false;
+                throw ArchiveError("unexpected end of archive");
+            }
+            done += n;
+        }
+        return true;
+    }
+
+    // Hashes the next size bytes of source (all of it if size is nullopt)
+    // and returns the digest and the number of bytes seen.
+    std::pair<Digest, std::uint64_t> hashStream(ByteSource& source, std::optional<std::uint64_t> size,
+                                                std::vector<char>& buffer) {
+        Fnv1a hash;
+        std::uint64_t seen = 0;
+        while (!size || seen < *size) {
+            std::size_t want = buffer.size();
+            if (size) want = static_cast<std::size_t>(std::min<std::uint64_t>(want, *size - seen));
+            const std::size_t n = source.read(buffer.data(), want);
+            if (n == 0) {
+                if (size) throw ArchiveError("unexpected end of archive");
+                break;
+            }
+            hash.update(buffer.data(), n);
+            seen += n;
+        }
+        return {hash.value(), seen};
+    }
+
+    void skip(ByteSource& source, std::uint64_t size, std::vector<char>& buffer) {
+        hashStream(source, size, buffer);
+    }
+
+    std::string memberPath(std::string_view path) {
+        while (true) {
+            if (path.starts_with("./")) {
+                path.remove_prefix(2);
+            } else if (path.starts_with("/")) {
+                path.remove_prefix(1);
+            } else {
+                break;
+            }
+        }
+        return std::string(path);
+    }
+
+    // --- tar -------------------------------------------------------------
+
+    std::string tarField(const char* field, std::size_t width) {
+        return std::string(field, strnlen(field, width));
+    }
+
+    // Octal, or base-256 when the high bit of the first byte is set (GNU).
+    std::uint64_t tarNumber(const char* field, std::size_t width) {
+        std::uint64_t value = 0;
+        if (static_cast<unsigned char>(field[0]) & 0x80) {
+            value = static_cast<unsigned char>(field[0]) & 0x7F;
+            for (std::size_t i = 1; i < width; ++i) {
+                value = (value << 8) | static_cast<unsigned char>(field[i]);
+            }
+            return value;
+        }
+        for (std::size_t i = 0; i < width && field[i]; ++i) {
+            if (field[i] == ' ') continue;
+            if (field[i] < '0' || field[i] > '7') throw ArchiveError("bad number in tar header");
+            value = value * 8 + static_cast<std::uint64_t>(field[i] - '0');
+        }
+        return value;
+    }
+
+    bool tarChecksumMatches(const char* header) {
+        std::uint64_t sum = 0;
+        for (std::size_t i = 0; i < TAR_BLOCK; ++i) {
+            sum += (i >= 148 && i < 156) ? ' ' : static_cast<unsigned char>(header[i]);
+        }
+        return sum == tarNumber(header + 148, 8);
+    }
+
+    std::string readTarString(ByteSource& source, std::uint64_t size, std::vector<char>& buffer) {
+        if (size > CHUNK) throw ArchiveError("oversized tar metadata entry");
+        std::string text(static_cast<std::size_t>(size), '\0');
+        if (!readFull(source, text.data(), text.size())) throw ArchiveError("unexpected end of archive");
+        skip(source, (TAR_BLOCK - size % TAR_BLOCK) % TAR_BLOCK, buffer);
+        text.resize(strnlen(text.c_str(), text.size()));
+        return text;
+    }
+
+    // pax records are "<length> <key>=<value>\n".
+    void parsePax(const std::string& records, std::string& path, std::optional<std::uint64_t>& size) {
+        std::size_t position = 0;
+        while (position < records.size()) {
+            const std::size_t space = records.find(' ', position);
+            if (space == std::string::npos) break;
+            const std::uint64_t length = std::strtoull(records.c_str() + position, nullptr, 10);
+            if (length == 0 || position + length > records.size()) break;
+            const std::string record = records.substr(space + 1, position + length - space - 2);
+            const std::size_t equals = record.find('=');
+            if (equals != std::string::npos) {
+                const std::string key = record.substr(0, equals);
+                if (key == "path") path = record.substr(equals + 1);
+                if (key == "size") size = std::strtoull(record.c_str() + equals + 1, nullptr, 10);
+            }
+            position += length;
+        }
+    }
+
+    void readTar(ByteSource& source, std::vector<ArchiveMember>& members, std::vector<char>& buffer) {
+        std::array<char, TAR_BLOCK> header;
+        std::string nextPath;                       // from a GNU long name or pax header
+        std::optional<std::uint64_t> nextSize;      // from a pax header
+        while (readFull(source, header.data(), header.size())) {
+            if (std::all_of(header.begin(), header.end(), [](char c) { return c == 0; })) return;
+            if (!tarChecksumMatches(header.data())) throw ArchiveError("bad tar header checksum");
+
+            const char type = header[156];
+            const std::uint64_t size = nextSize.value_or(tarNumber(header.data() + 124, 12));
+            const std::uint64_t padding = (TAR_BLOCK - size % TAR_BLOCK) % TAR_BLOCK;
+            if (type == 'L') {
+                nextPath = readTarString(source, size, buffer);
+                continue;
+            }
+            if (type == 'x') {
+                parsePax(readTarString(source, size, buffer), nextPath, nextSize);
+                continue;
+            }
+
+            std::string path = std::move(nextPath);
+            nextPath.clear();
+            nextSize.reset();
+            if (path.empty()) {
+                path = tarField(header.data(), 100);
+                const std::string prefix = tarField(header.data() + 345, 155);
+                if (std::memcmp(header.data() + 257, "ustar", 5) == 0 && !prefix.empty()) {
+                    path = prefix + "/" + path;
+                }
+            }
+
+            if (type == '0' || type == '\0' || type == '7') {
+                const auto [digest, seen] = hashStream(source, size, buffer);
+                members.push_back(ArchiveMember{memberPath(path), seen, digest});
+                skip(source, padding, buffer);
+            } else {
+                skip(source, size + padding, buffer);   // directories, links, devices, global pax headers
+            }
+        }
+    }
+
+    // --- zip -------------------------------------------------------------
+
+    std::uint64_t little(const char* data, std::size_t bytes) {
+        std::uint64_t value = 0;
+        for (std::size_t i = 0; i < bytes; ++i) {
+            value |= static_cast<std::uint64_t>(static_cast<unsigned char>(data[i])) << (8 * i);
+        }
+        return value;
+    }
+
+    void readAt(int fd, std::uint64_t offset, char* out, std::size_t size) {
+        FileSource source(fd, offset, offset + size);
+        if (!readFull(source, out, size)) throw ArchiveError("unexpected end of file");
+    }
+
+    struct ZipDirectory {
+        std::uint64_t entries;
+        std::uint64_t offset;
+        std::uint64_t size;
+    };
+
+    ZipDirectory findZipDirectory(int fd, std::uint64_t fileSize) {
+        // The end record is 22 bytes plus a comment of up to 64 KiB.
+        const std::uint64_t tail = std::min<std::uint64_t>(fileSize, 22 + 65535);
+        std::string data(static_cast<std::size_t>(tail), '\0');
+        readAt(fd, fileSize - tail, data.data(), data.size());
+        for (std::size_t i = data.size() >= 22 ? data.size() - 22 + 1 : 0; i-- > 0;) {
+            if (little(data.data() + i, 4) != 0x06054b50) continue;
+            ZipDirectory directory{little(data.data() + i + 10, 2), little(data.data() + i + 16, 4),
+                                   little(data.data() + i + 12, 4)};
+            const std::uint64_t end = fileSize - tail + i;
+            if (directory.entries == 0xFFFF || directory.offset == 0xFFFFFFFF || directory.size == 0xFFFFFFFF) {
+                // Zip64: a locator just before the end record points at the
+                // zip64 end record.
+                if (end < 20) throw ArchiveError("missing zip64 locator");
+                char locator[20];
+                readAt(fd, end - 20, locator, sizeof(locator));
+                if (little(locator, 4) != 0x07064b50) throw ArchiveError("missing zip64 locator");
+                char record[56];
+                readAt(fd, little(locator + 8, 8), record, sizeof(record));
+                if (little(record, 4) != 0x06064b50) throw ArchiveError("bad zip64 end record");
+                directory = ZipDirectory{little(record + 32, 8), little(record + 48, 8), little(record + 40, 8)};
+            }
+            return directory;
+        }
+        throw ArchiveError("no zip end record");
+    }
+
+    void readZip(int fd, std::uint64_t fileSize, const std::string& archivePath,
+                 std::vector<ArchiveMember>& members, std::vector<char>& buffer) {
+        const ZipDirectory directory = findZipDirectory(fd, fileSize);
+        if (directory.offset > fileSize || directory.size > fileSize - directory.offset) {
+            throw ArchiveError("central directory out of bounds");
+        }
+        FileSource central(fd, directory.offset, directory.offset + directory.size);
+        for (std::uint64_t entry = 0; entry < directory.entries; ++entry) {
+            char fixed[46];
+            if (!readFull(central, fixed, sizeof(fixed)) || little(fixed, 4) != 0x02014b50) {
+                throw ArchiveError("bad central directory entry");
+            }
+            const auto flags = little(fixed + 8, 2);
+            const auto method = little(fixed + 10, 2);
+            std::uint64_t compressed = little(fixed + 20, 4);
+            std::uint64_t uncompressed = little(fixed + 24, 4);
+            std::uint64_t localOffset = little(fixed + 42, 4);
+            std::string name(little(fixed + 28, 2), '\0');
+            std::string extra(little(fixed + 30, 2), '\0');
+            if (!readFull(central, name.data(), name.size()) && !name.empty()) throw ArchiveError("truncated name");
+            if (!readFull(central, extra.data(), extra.size()) && !extra.empty()) throw ArchiveError("truncated extra");
+            skip(central, little(fixed + 32, 2), buffer);   // comment
+
+            // Zip64 sizes and offset, present only for fields that overflowed.
+            for (std::size_t i = 0; i + 4 <= extra.size();) {
+                const auto id = little(extra.data() + i, 2);
+                const auto length = little(extra.data() + i + 2, 2);
+                if (id == 0x0001) {
+                    std::size_t field = i + 4;
+                    for (std::uint64_t* value : {&uncompressed, &compressed, &localOffset}) {
+                        if (*value != 0xFFFFFFFF || field + 8 > i + 4 + length) continue;
+                        *value = little(extra.data() + field, 8);
+                        field += 8;
+                    }
+                }
+                i += 4 + length;
+            }
+
+            if (name.empty() || name.back() == '/') continue;   // directory
+            // Encrypted members and other compression methods are skipped.
+            if ((flags & 1) || (method != 0 && method != 8)) {
+                Errors::record(Errors::Operation::Archive, ENOTSUP,
+                               archivePath + std::string(ARCHIVE_SEPARATOR) + name);
+                continue;
+            }
+
+            char local[30];
+            readAt(fd, localOffset, local, sizeof(local));
+            if (little(local, 4) != 0x04034b50) throw ArchiveError("bad local header");
+            const std::uint64_t data = localOffset + 30 + little(local + 26, 2) + little(local + 28, 2);
+            if (data > fileSize || compressed > fileSize - data) throw ArchiveError("member data out of bounds");
+
+            FileSource raw(fd, data, data + compressed);
+            std::pair<Digest, std::uint64_t> hashed;
+            if (method == 0) {
+                hashed = hashStream(raw, compressed, buffer);
+            } else {
+                InflateSource inflated(raw, InflateSource::Wrapper::Raw);
+                hashed = hashStream(inflated, std::nullopt, buffer);
+            }
+            if (hashed.second != uncompressed) throw ArchiveError("size mismatch in " + name);
+            members.push_back(ArchiveMember{memberPath(name), hashed.second, hashed.first});
+        }
+    }
+}
+
+std::optional<ArchiveFormat> archiveFormatOf(std::string_view name) {
+    std::string lower(name);
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return std::tolower(c); });
+    if (lower.ends_with(".tar")) return ArchiveFormat::Tar;
+    if (lower.ends_with(".tar.gz") || lower.ends_with(".tgz")) return ArchiveFormat::TarGz;
+    if (lower.ends_with(".zip")) return ArchiveFormat::Zip;
+    return std::nullopt;
+}
+
+bool isArchiveMemberPath(std::string_view path) {
+    for (auto position = path.find(ARCHIVE_SEPARATOR); position != std::string_view::npos;
+         position = path.find(ARCHIVE_SEPARATOR, position + 1)) {
+        if (archiveFormatOf(path.substr(0, position))) return true;
+    }
+    return false;
+}
+
+std::vector<ArchiveMember> hashArchiveMembers(const std::string& archivePath, ArchiveFormat format) {
+    Metrics::Span span(Metrics::Stage::Hash, "archive");
+    std::vector<ArchiveMember> members;
+    const int fd = ::open(archivePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        Errors::record(Errors::Operation::Open, errno, archivePath);
+        return members;
+    }
+    std::vector<char> buffer(CHUNK);
+    try {
+        struct stat info;
+        if (::fstat(fd, &info) != 0) throw ArchiveError(std::strerror(errno), errno);
+        const auto fileSize = static_cast<std::uint64_t>(info.st_size);
+        FileSource file(fd, 0, fileSize);
+        switch (format) {
+            case ArchiveFormat::Tar:
+                readTar(file, members, buffer);
+                break;
+            case ArchiveFormat::TarGz: {
+                InflateSource inflated(file, InflateSource::Wrapper::Gzip);
+                readTar(inflated, members, buffer);
+                break;
+            }
+            case ArchiveFormat::Zip:
+                readZip(fd, fileSize, archivePath, members, buffer);
+                break;
+        }
+    } catch (const ArchiveError& e) {
+        Errors::record(e.error == EBADMSG ? Errors::Operation::Archive : Errors::Operation::Read, e.error,
+                       archivePath);
+    }
+    ::close(fd);
+    return members;
+}
+
+} // namespace FileComparator
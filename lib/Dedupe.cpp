@@ -0,0 +1,252 @@
+#include "Dedupe.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace FileComparator {
+
+namespace {
+    constexpr size_t VERIFY_CHUNK = 64 * 1024;
+    // Filesystems cap one FIDEDUPERANGE call (btrfs at 16 MiB).
+    constexpr std::uint64_t DEDUPE_CHUNK = 16 * 1024 * 1024;
+
+    enum class LinkOutcome { Linked, Skipped, Failed, Unsupported };
+
+    class FileDescriptor {
+    public:
+        FileDescriptor(const std::string& path, int flags) : fd(::open(path.c_str(), flags | O_CLOEXEC)) {}
+        ~FileDescriptor() { if (fd >= 0) ::close(fd); }
+        FileDescriptor(const FileDescriptor&) = delete;
+        FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+        explicit operator bool() const { return fd >= 0; }
+        int get() const { return fd; }
+
+    private:
+        int fd;
+    };
+
+    void reportFailure(const std::string& path, const std::string& reason) {
+        // One write per line so concurrent groups do not interleave.
+        std::cerr << ("Dedupe failed for " + path + ": " + reason + "\n");
+    }
+
+    bool sameTimestamp(const struct stat& a, const struct stat& b) {
+        return a.st_mtim.tv_sec == b.st_mtim.tv_sec && a.st_mtim.tv_nsec == b.st_mtim.tv_nsec &&
+               a.st_size == b.st_size;
+    }
+
+    bool identicalContent(int fd1, int fd2, std::size_t size) {
+        std::array<char, VERIFY_CHUNK> buffer1;
+        std::array<char, VERIFY_CHUNK> buffer2;
+        for (off_t offset = 0; static_cast<std::size_t>(offset) < size;) {
+            const size_t want = std::min(VERIFY_CHUNK, size - static_cast<std::size_t>(offset));
+            ssize_t read1 = ::pread(fd1, buffer1.data(), want, offset);
+            ssize_t read2 = ::pread(fd2, buffer2.data(), want, offset);
+            if (read1 <= 0 || read1 != read2) return false;
+            if (std::memcmp(buffer1.data(), buffer2.data(), static_cast<size_t>(read1)) != 0) return false;
+            offset += read1;
+        }
+        return true;
+    }
+
+    // Shares the target's extents with the source's through FIDEDUPERANGE,
+    // which compares and shares each range atomically in the kernel, so a
+    // write racing with it is never overwritten: the range then differs and
+    // is left alone.
+    LinkOutcome dedupeRange(int sourceFd, int targetFd, std::uint64_t size) {
+#ifdef FIDEDUPERANGE
+        // One destination, in the flexible array that ends the request.
+        alignas(file_dedupe_range) unsigned char buffer[sizeof(file_dedupe_range) + sizeof(file_dedupe_range_info)];
+        auto* range = reinterpret_cast<file_dedupe_range*>(buffer);
+        file_dedupe_range_info& info = range->info[0];
+        for (std::uint64_t offset = 0; offset < size;) {
+            std::memset(buffer, 0, sizeof(buffer));
+            range->src_offset = offset;
+            range->src_length = std::min<std::uint64_t>(DEDUPE_CHUNK, size - offset);
+            range->dest_count = 1;
+            info.dest_fd = targetFd;
+            info.dest_offset = offset;
+            if (::ioctl(sourceFd, FIDEDUPERANGE, range) != 0) {
+                if (errno == EOPNOTSUPP || errno == ENOTTY || errno == EXDEV || errno == EINVAL) {
+                    return LinkOutcome::Unsupported;
+                }
+                return LinkOutcome::Failed;
+            }
+            if (info.status == FILE_DEDUPE_RANGE_DIFFERS) return LinkOutcome::Skipped;
+            if (info.status < 0) {
+                errno = -info.status;
+                return errno == EOPNOTSUPP || errno == EINVAL ? LinkOutcome::Unsupported : LinkOutcome::Failed;
+            }
+            if (info.bytes_deduped == 0) {
+                errno = EIO;
+                return LinkOutcome::Failed;
+            }
+            offset += info.bytes_deduped;
+        }
+        return LinkOutcome::Linked;
+#else
+        (void)sourceFd;
+        (void)targetFd;
+        (void)size;
+        return LinkOutcome::Unsupported;
+#endif
+    }
+
+    // Links source next to target under a temporary name and renames it over
+    // target, provided the new name is the source inode that was verified and
+    // target still names the target inode that was verified.
+    LinkOutcome hardlink(const std::string& source, const struct stat& sourceStat, const std::string& target,
+                         const struct stat& verified) {
+        static std::atomic<unsigned> counter{0};
+        const fs::path targetPath(target);
+        const fs::path temp = targetPath.parent_path() /
+            (".fs2-dedupe-" + std::to_string(::getpid()) + "-" + std::to_string(counter++));
+
+        if (::link(source.c_str(), temp.c_str()) != 0) {
+            return errno == EXDEV || errno == EPERM ? LinkOutcome::Unsupported : LinkOutcome::Failed;
+        }
+
+        // The source path may have been replaced since it was opened.
+        struct stat linked;
+        if (::lstat(temp.c_str(), &linked) != 0 || linked.st_dev != sourceStat.st_dev ||
+            linked.st_ino != sourceStat.st_ino) {
+            ::unlink(temp.c_str());
+            return LinkOutcome::Skipped;
+        }
+
+        struct stat current;
+        if (::lstat(target.c_str(), &current) != 0 || current.st_dev != verified.st_dev ||
+            current.st_ino != verified.st_ino || !sameTimestamp(current, verified)) {
+            ::unlink(temp.c_str());
+            return LinkOutcome::Skipped;
+        }
+        if (::rename(temp.c_str(), target.c_str()) != 0) {
+            const int error = errno;
+            ::unlink(temp.c_str());
+            errno = error;
+            return LinkOutcome::Failed;
+        }
+        return LinkOutcome::Linked;
+    }
+
+    void dedupeFile(const FileInfo& source, int sourceFd, const struct stat& sourceStat,
+                    const FileInfo& target, const DedupeOptions& options, DedupeResult& result) {
+        const bool cloning = options.method == DedupeMethod::Reflink;
+        FileDescriptor targetFd(target.path, cloning ? O_RDWR : O_RDONLY);
+        if (!targetFd) {
+            reportFailure(target.path, std::strerror(errno));
+            ++result.failed;
+            return;
+        }
+
+        struct stat targetStat;
+        if (::fstat(targetFd.get(), &targetStat) != 0 || !S_ISREG(targetStat.st_mode)) {
+            ++result.failed;
+            return;
+        }
+        if (targetStat.st_dev == sourceStat.st_dev && targetStat.st_ino == sourceStat.st_ino) {
+            ++result.skipped;   // already the same file
+            return;
+        }
+        if (static_cast<std::size_t>(targetStat.st_size) != source.size) {
+            ++result.skipped;
+            return;
+        }
+
+        // The kernel compares while sharing, so cloning needs no userspace
+        // pass; linking does, and so does a fallback to it.
+        LinkOutcome outcome = LinkOutcome::Unsupported;
+        if (cloning) {
+            outcome = dedupeRange(sourceFd, targetFd.get(), source.size);
+        }
+        if (!cloning || (outcome == LinkOutcome::Unsupported && options.hardlinkFallback)) {
+            if (!identicalContent(sourceFd, targetFd.get(), source.size)) {
+                ++result.skipped;
+                return;
+            }
+            // A write that landed during verification shows up as a new mtime.
+            struct stat sourceNow;
+            struct stat targetNow;
+            if (::fstat(sourceFd, &sourceNow) != 0 || ::fstat(targetFd.get(), &targetNow) != 0 ||
+                !sameTimestamp(sourceNow, sourceStat) || !sameTimestamp(targetNow, targetStat)) {
+                ++result.skipped;
+                return;
+            }
+            outcome = hardlink(source.path, sourceStat, target.path, targetStat);
+            // Space comes back only once the last name of the old inode goes.
+            if (outcome == LinkOutcome::Linked && targetStat.st_nlink > 1) {
+                ++result.filesLinked;
+                return;
+            }
+        }
+
+        switch (outcome) {
+            case LinkOutcome::Linked:
+                ++result.filesLinked;
+                result.bytesReclaimed += source.size;
+                break;
+            case LinkOutcome::Skipped:
+                ++result.skipped;
+                break;
+            case LinkOutcome::Unsupported:
+            case LinkOutcome::Failed:
+                reportFailure(target.path, std::strerror(errno));
+                ++result.failed;
+                break;
+        }
+    }
+}
+
+DedupeResult& DedupeResult::operator+=(const DedupeResult& other) {
+    filesLinked += other.filesLinked;
+    bytesReclaimed += other.bytesReclaimed;
+    skipped += other.skipped;
+    failed += other.failed;
+    return *this;
+}
+
+DedupeResult dedupeGroup(const DuplicateGroup& group, const DedupeOptions& options) {
+    DedupeResult result;
+    if (group.files.size() < 2) return result;
+
+    const FileInfo& source = group.files.front();
+    FileDescriptor sourceFd(source.path, O_RDONLY);
+    struct stat sourceStat;
+    if (!sourceFd || ::fstat(sourceFd.get(), &sourceStat) != 0 ||
+        static_cast<std::size_t>(sourceStat.st_size) != source.size) {
+        result.skipped += group.files.size() - 1;
+        return result;
+    }
+
+    for (size_t i = 1; i < group.files.size(); ++i) {
+        dedupeFile(source, sourceFd.get(), sourceStat, group.files[i], options, result);
+    }
+    return result;
+}
+
+std::future<DedupeResult> dedupeGroupAsync(DuplicateGroup group, DedupeOptions options) {
+    return sharedThreadPool().enqueue([group = std::move(group), options]() {
+        return dedupeGroup(group, options);
+    });
+}
+
+std::optional<DedupeMethod> parseDedupeMethod(const std::string& name) {
+    if (name == "reflink") return DedupeMethod::Reflink;
+    if (name == "hardlink") return DedupeMethod::Hardlink;
+    return std::nullopt;
+}
+
+} // namespace FileComparator
@@ -0,0 +1,124 @@
+#include "DirectoryWalk.hpp"
+#include <algorithm>
+
+namespace FileComparator {
+
+namespace {
+    FileType listedType(unsigned char type) {
+        switch (type) {
+            case DT_REG: return FileType::Regular;
+            case DT_DIR: return FileType::Directory;
+            case DT_LNK: return FileType::Symlink;
+            case DT_UNKNOWN: return FileType::Unknown;
+            default: return FileType::Other;
+        }
+    }
+
+    bool isDotOrDotDot(const char* name) {
+        return name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+    }
+}
+
+DirectoryWalker::DirectoryWalker(const std::string& directory, WalkOptions options) : options(options) {
+    const int root = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (root < 0) {
+        // A missing root is not an error; the walk just finds nothing.
+        if (errno != ENOENT) Errors::record(Errors::Operation::OpenDirectory, errno, directory);
+        return;
+    }
+    descend(directory, root);
+}
+
+// Walks the open directory fd next, unless it is already being walked.
+void DirectoryWalker::descend(const std::filesystem::path& path, int fd) {
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+        Errors::record(Errors::Operation::Stat, errno, path.native());
+        ::close(fd);
+        return;
+    }
+    for (const auto& level : stack) {
+        if (level.device == info.st_dev && level.inode == info.st_ino) {
+            ::close(fd);
+            return;
+        }
+    }
+    DIR* dir = ::fdopendir(fd);
+    if (!dir) {
+        Errors::record(Errors::Operation::OpenDirectory, errno, path.native());
+        ::close(fd);
+        return;
+    }
+    Level level{path, {dir, ::closedir}, info.st_dev, info.st_ino, {}, 0};
+    if (options.sorted) {
+        while (true) {
+            errno = 0;
+            const dirent* found = ::readdir(dir);
+            if (!found) {
+                if (errno != 0) Errors::record(Errors::Operation::ReadDirectory, errno, path.native());
+                break;
+            }
+            if (!isDotOrDotDot(found->d_name)) level.listed.push_back(Listed{found->d_name, found->d_type});
+        }
+        std::sort(level.listed.begin(), level.listed.end(), [](const Listed& a, const Listed& b) {
+            return a.name < b.name;
+        });
+    }
+    stack.push_back(std::move(level));
+}
+
+WalkEntry* DirectoryWalker::next() {
+    current.reset();
+    while (!stack.empty()) {
+        Level& level = stack.back();
+        const char* name;
+        unsigned char listed;
+        if (options.sorted) {
+            if (level.nextListed == level.listed.size()) {
+                stack.pop_back();
+                continue;
+            }
+            // Names stay put while deeper levels are pushed: moving a
+            // Level moves its vector, not the strings in it.
+            const Listed& entry = level.listed[level.nextListed++];
+            name = entry.name.c_str();
+            listed = entry.type;
+        } else {
+            errno = 0;
+            const dirent* found = ::readdir(level.dir.get());
+            if (!found) {
+                if (errno != 0) Errors::record(Errors::Operation::ReadDirectory, errno, level.path.native());
+                stack.pop_back();
+                continue;
+            }
+            name = found->d_name;
+            if (isDotOrDotDot(name)) continue;
+            listed = found->d_type;
+        }
+
+        entryDepth = stack.size() - 1;
+        const int parent = ::dirfd(level.dir.get());
+        WalkEntry& entry = current.emplace(parent, name, level.path / name, listedType(listed));
+        const FileType type = entry.type();
+        if (type == FileType::Directory || (type == FileType::Symlink && options.followSymlinks)) {
+            // Opening follows a symlink; one to anything but a directory
+            // fails with ENOTDIR and is an ordinary entry.
+            const int fd = ::openat(parent, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (fd >= 0) {
+                entry.intoDirectory = true;
+                descend(entry.path(), fd);
+                return &entry;
+            }
+            if (type == FileType::Directory || (errno != ENOTDIR && errno != ENOENT && errno != ELOOP)) {
+                if (errno == ENOENT) continue;
+                Errors::record(Errors::Operation::OpenDirectory, errno, entry.path().native());
+                entry.intoDirectory = true;
+                return &entry;
+            }
+        }
+        if (type != FileType::Unknown) return &entry;
+    }
+    return nullptr;
+}
+
+} // namespace FileComparator
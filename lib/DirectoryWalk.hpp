@@ -0,0 +1,168 @@
+#pragma once
+
+#include "Errors.hpp"
+#include "FileMetadata.hpp"
+#include "Metrics.hpp"
+#include "Progress.hpp"
+#include <cerrno>
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace FileComparator {
+
+// Drops roots that repeat or lie inside another root; their files would
+// otherwise be reported as duplicates of themselves.
+std::vector<std::string> distinctRoots(const std::vector<std::string>& directories);
+
+// An entry met by a DirectoryWalker. Its type comes from the directory
+// listing where the filesystem reports one; metadata() is a single statx
+// relative to the open directory, made at most once however often it is
+// asked for.
+class WalkEntry {
+public:
+    WalkEntry(int directoryFd, const char* name, std::filesystem::path path, FileType listed)
+        : directoryFd(directoryFd), entryName(name), entryPath(std::move(path)), listed(listed) {}
+
+    const std::filesystem::path& path() const { return entryPath; }
+    // The open directory holding the entry, and its name there; both are
+    // valid only until the walk moves on.
+    int directory() const { return directoryFd; }
+    const char* name() const { return entryName; }
+    // A directory the walk goes into next, or tried to; a failure to open it
+    // has been recorded with Errors.
+    bool descended() const { return intoDirectory; }
+
+    // The entry's own type, not following a symlink; Unknown if it cannot
+    // be stat-ed.
+    FileType type() {
+        if (listed != FileType::Unknown) return listed;
+        const FileMetadata* known = metadata();
+        return known ? known->type : FileType::Unknown;
+    }
+
+    // nullptr if the statx fails, which is recorded with Errors unless the
+    // entry has simply gone since it was listed.
+    const FileMetadata* metadata() {
+        if (!fetched) {
+            fetched = true;
+            error = readMetadata(directoryFd, entryName, data);
+            if (error != 0 && error != ENOENT) Errors::record(Errors::Operation::Stat, error, entryPath.native());
+        }
+        return error == 0 ? &data : nullptr;
+    }
+
+private:
+    friend class DirectoryWalker;
+
+    int directoryFd;
+    const char* entryName;
+    std::filesystem::path entryPath;
+    FileType listed;
+    bool intoDirectory = false;
+    bool fetched = false;
+    int error = 0;
+    FileMetadata data;
+};
+
+struct WalkOptions {
+    // Each directory's entries in byte order of their names rather than as
+    // readdir lists them, so that two trees can be walked side by side.
+    bool sorted = false;
+    // Go through symlinks to directories; otherwise every symlink is an
+    // ordinary entry.
+    bool followSymlinks = true;
+};
+
+// Walks directory depth first, one entry per call to next(). Directories
+// are read with readdir and entries stat-ed relative to their directory's
+// descriptor, so a path is never resolved from the root again. Nothing
+// throws: unreadable directories and entries are recorded with Errors and
+// skipped, and a symlink back to a directory being walked is not followed,
+// so loops end.
+class DirectoryWalker {
+public:
+    explicit DirectoryWalker(const std::string& directory, WalkOptions options = {});
+
+    DirectoryWalker(const DirectoryWalker&) = delete;
+    DirectoryWalker& operator=(const DirectoryWalker&) = delete;
+
+    // The next entry, valid until the following call, or nullptr once the
+    // walk is done. A directory comes back, descended, before anything in
+    // it.
+    WalkEntry* next();
+    // Directories between the root and the last entry; 0 for the root's own.
+    std::size_t depth() const { return entryDepth; }
+
+private:
+    struct Listed {
+        std::string name;
+        unsigned char type;
+    };
+
+    struct Level {
+        std::filesystem::path path;
+        std::unique_ptr<DIR, int (*)(DIR*)> dir;
+        dev_t device;
+        ino_t inode;
+        std::vector<Listed> listed;   // the whole directory, for a sorted walk
+        std::size_t nextListed = 0;
+    };
+
+    void descend(const std::filesystem::path& path, int fd);
+
+    WalkOptions options;
+    std::vector<Level> stack;
+    std::optional<WalkEntry> current;
+    std::size_t entryDepth = 0;
+};
+
+// Walks directory, following directory symlinks, with onDirectory(depth,
+// path) run as each directory is entered and onEntry(depth, WalkEntry&) for
+// everything else.
+template<typename OnDirectory, typename OnEntry>
+void walkTree(const std::string& directory, OnDirectory&& onDirectory, OnEntry&& onEntry) {
+    DirectoryWalker walker(directory);
+    while (WalkEntry* entry = walker.next()) {
+        if (entry->descended()) {
+            onDirectory(walker.depth(), entry->path());
+        } else {
+            onEntry(walker.depth(), *entry);
+        }
+    }
+}
+
+// walkTree restricted to regular files, with onFile(depth, WalkEntry&,
+// metadata) given each file's statx. Symlinked files are skipped: a symlink's
+// "content" is its target path, which must never be reported as a
+// duplicate of a real file.
+template<typename OnDirectory, typename OnFile>
+void walkRegularFiles(const std::string& directory, OnDirectory&& onDirectory, OnFile&& onFile) {
+    namespace fs = std::filesystem;
+    Metrics::Span span(Metrics::Stage::Traverse, "walk");
+    const bool counting = Metrics::enabled();
+    walkTree(
+        directory,
+        [&](std::size_t depth, const fs::path& path) {
+            if (counting) Metrics::count(Metrics::Counter::Directories);
+            Progress::add(Progress::Counter::Entries);
+            onDirectory(depth, path);
+        },
+        [&](std::size_t depth, WalkEntry& entry) {
+            if (entry.type() != FileType::Regular) return;
+            const FileMetadata* metadata = entry.metadata();
+            if (!metadata || metadata->type != FileType::Regular) return;
+            if (counting) Metrics::count(Metrics::Counter::Files);
+            Progress::add(Progress::Counter::Entries);
+            onFile(depth, entry, *metadata);
+        });
+}
+
+} // namespace FileComparator
@@ -0,0 +1,123 @@
+#include "Errors.hpp"
+#include "JsonString.hpp"
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace FileComparator::Errors {
+
+namespace {
+    struct Bucket {
+        std::uint64_t count = 0;
+        std::vector<std::string> samples;
+    };
+
+    struct Registry {
+        std::mutex mutex;
+        std::map<std::pair<Operation, int>, Bucket> buckets;
+    };
+
+    Registry& registry() {
+        static Registry instance;
+        return instance;
+    }
+
+    void writeJsonString(std::ostream& out, std::string_view text) {
+        FileComparator::writeJsonString(text, [&](std::string_view piece) { out << piece; });
+    }
+}
+
+void record(Operation operation, int error, std::string_view path) {
+    Registry& all = registry();
+    std::lock_guard lock(all.mutex);
+    Bucket& bucket = all.buckets[{operation, error}];
+    ++bucket.count;
+    if (bucket.samples.size() < MAX_SAMPLES) bucket.samples.emplace_back(path);
+}
+
+const char* toString(Operation operation) {
+    switch (operation) {
+        case Operation::OpenDirectory: return "open directory";
+        case Operation::ReadDirectory: return "read directory";
+        case Operation::Stat: return "stat";
+        case Operation::ReadLink: return "read link";
+        case Operation::Open: return "open";
+        case Operation::Read: return "read";
+        case Operation::Archive: return "read archive";
+        case Operation::Count: break;
+    }
+    return "unknown";
+}
+
+std::vector<Summary> summary() {
+    std::vector<Summary> result;
+    {
+        Registry& all = registry();
+        std::lock_guard lock(all.mutex);
+        for (const auto& [key, bucket] : all.buckets) {
+            result.push_back(Summary{key.first, key.second, bucket.count, bucket.samples});
+        }
+    }
+    std::stable_sort(result.begin(), result.end(), [](const Summary& a, const Summary& b) {
+        return a.count > b.count;
+    });
+    return result;
+}
+
+std::uint64_t total() {
+    Registry& all = registry();
+    std::lock_guard lock(all.mutex);
+    std::uint64_t count = 0;
+    for (const auto& entry : all.buckets) count += entry.second.count;
+    return count;
+}
+
+void clear() {
+    Registry& all = registry();
+    std::lock_guard lock(all.mutex);
+    all.buckets.clear();
+}
+
+void merge(const Summary& errors) {
+    Registry& all = registry();
+    std::lock_guard lock(all.mutex);
+    Bucket& bucket = all.buckets[{errors.operation, errors.error}];
+    bucket.count += errors.count;
+    for (const auto& sample : errors.samples) {
+        if (bucket.samples.size() == MAX_SAMPLES) break;
+        bucket.samples.push_back(sample);
+    }
+}
+
+void writeReport(std::ostream& out, const std::vector<Summary>& errors) {
+    if (errors.empty()) return;
+    std::uint64_t count = 0;
+    for (const auto& error : errors) count += error.count;
+    out << count << (count == 1 ? " error" : " errors") << " while scanning; the affected entries were skipped:\n";
+    for (const auto& error : errors) {
+        out << "  " << error.count << " x " << toString(error.operation) << ": "
+            << std::generic_category().message(error.error) << ", e.g.";
+        for (std::size_t i = 0; i < error.samples.size(); ++i) {
+            out << (i ? ", " : " ") << error.samples[i];
+        }
+        out << '\n';
+    }
+}
+
+void writeRecords(std::ostream& out) {
+    for (const auto& error : summary()) {
+        out << "{\"kind\":\"error\",\"operation\":";
+        writeJsonString(out, toString(error.operation));
+        out << ",\"errno\":" << error.error << ",\"message\":";
+        writeJsonString(out, std::generic_category().message(error.error));
+        out << ",\"count\":" << error.count << ",\"samples\":[";
+        for (std::size_t i = 0; i < error.samples.size(); ++i) {
+            if (i) out << ',';
+            writeJsonString(out, error.samples[i]);
+        }
+        out << "]}\n";
+    }
+}
+
+} // namespace FileComparator::Errors
@@ -0,0 +1,261 @@
+#include "Estimate.hpp"
+#include "DirectoryWalk.hpp"
+#include "GroupingEngine.hpp"
+#include "Progress.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+namespace FileComparator {
+
+namespace {
+    constexpr double Z_95 = 1.959963984540054;
+    constexpr std::size_t HASH_BATCH_FILES = 64;
+    // Fewer than two sampled classes give no variance.
+    constexpr std::size_t MIN_SAMPLED_CLASSES = 2;
+
+    struct Stratum {
+        std::vector<std::pair<std::size_t, std::size_t>> classes;   // [begin, end) in rows by size
+        double bound = 0;   // sum of size * (count - 1)
+        double cost = 0;    // sum of size * count, the bytes a census would hash
+        std::size_t taken = 0;   // classes[0, taken) are sampled
+    };
+
+    struct Sample {
+        std::size_t stratum;
+        std::vector<RowId> rows;   // ordered by device and inode
+        double bound = 0;
+        double duplicate = 0;
+    };
+
+    double secondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+DuplicateEstimate estimateDuplicates(const std::vector<std::string>& roots, const EstimateOptions& options) {
+    DuplicateEstimate estimate;
+    PathTable paths;
+    FileTable files;
+
+    auto started = std::chrono::steady_clock::now();
+    std::function<bool(std::uint64_t)> keepSize;
+    if (options.minSize > 0) {
+        keepSize = [minSize = options.minSize](std::uint64_t size) { return size >= minSize; };
+    }
+    Progress::setWalking(true);
+    for (const auto& root : distinctRoots(roots)) {
+        collectRegularFiles(root, keepSize, paths, files);
+    }
+    Progress::setWalking(false);
+    estimate.walkSeconds = secondsSince(started);
+    estimate.files = files.size();
+    for (std::uint64_t size : files.sizeColumn()) estimate.bytes += size;
+
+    // Only a size shared by two files can hold duplicates, so every other
+    // file is known to contribute nothing without being read.
+    const std::vector<RowId> rows = files.rowsBySize();
+    std::array<Stratum, 64> strata;
+    for (std::size_t begin = 0; begin < rows.size();) {
+        std::size_t end = begin + 1;
+        const std::uint64_t size = files.fileSize(rows[begin]);
+        while (end < rows.size() && files.fileSize(rows[end]) == size) ++end;
+        if (end - begin > 1 && size > 0) {
+            Stratum& stratum = strata[static_cast<std::size_t>(std::bit_width(size)) - 1];
+            const double count = static_cast<double>(end - begin);
+            stratum.classes.emplace_back(begin, end);
+            stratum.bound += static_cast<double>(size) * (count - 1);
+            stratum.cost += static_cast<double>(size) * count;
+            ++estimate.candidateClasses;
+            estimate.candidateBytes += size * (end - begin - 1);
+        }
+        begin = end;
+    }
+
+    // Within each stratum, classes are taken in random order while they fit
+    // its share of the budget. What is left then tops up the strata with
+    // fewer than MIN_SAMPLED_CLASSES, cheapest first, as far as it goes.
+    std::mt19937_64 rng(options.seed);
+    double totalCost = 0;
+    for (auto& stratum : strata) {
+        std::shuffle(stratum.classes.begin(), stratum.classes.end(), rng);
+        totalCost += stratum.cost;
+    }
+    const double budget = options.sampleFraction * totalCost;
+    estimate.budgetBytes = static_cast<std::uint64_t>(budget);
+    auto classCost = [&](std::pair<std::size_t, std::size_t> sizeClass) {
+        return static_cast<double>(files.fileSize(rows[sizeClass.first])) *
+               static_cast<double>(sizeClass.second - sizeClass.first);
+    };
+    double spent = 0;
+    for (auto& stratum : strata) {
+        const double share = options.sampleFraction * stratum.cost;
+        double stratumSpent = 0;
+        while (stratum.taken < stratum.classes.size() &&
+               stratumSpent + classCost(stratum.classes[stratum.taken]) <= share) {
+            stratumSpent += classCost(stratum.classes[stratum.taken++]);
+        }
+        spent += stratumSpent;
+    }
+    for (auto& stratum : strata) {
+        while (stratum.taken < std::min(MIN_SAMPLED_CLASSES, stratum.classes.size()) &&
+               spent + classCost(stratum.classes[stratum.taken]) <= budget) {
+            spent += classCost(stratum.classes[stratum.taken++]);
+        }
+    }
+
+    std::vector<Sample> samples;
+    for (std::size_t s = 0; s < strata.size(); ++s) {
+        const auto& classes = strata[s].classes;
+        if (!classes.empty() && strata[s].taken == 0) {
+            ++estimate.unsampledStrata;
+            estimate.unsampledBytes += static_cast<std::uint64_t>(strata[s].bound);
+        }
+        for (std::size_t taken = 0; taken < strata[s].taken; ++taken) {
+            const auto [begin, end] = classes[taken];
+            Sample sample{s, std::vector<RowId>(rows.begin() + begin, rows.begin() + end)};
+            std::sort(sample.rows.begin(), sample.rows.end(), [&](RowId a, RowId b) {
+                return files.device(a) != files.device(b) ? files.device(a) < files.device(b)
+                                                          : files.inode(a) < files.inode(b);
+            });
+            const auto size = static_cast<double>(files.fileSize(sample.rows.front()));
+            sample.bound = size * static_cast<double>(sample.rows.size() - 1);
+            samples.push_back(std::move(sample));
+        }
+    }
+
+    // Hashed exactly as a full scan would, one inode per batch slot.
+    started = std::chrono::steady_clock::now();
+    auto sameInode = [&](RowId a, RowId b) {
+        return files.device(a) == files.device(b) && files.inode(a) == files.inode(b);
+    };
+    std::vector<std::future<void>> batches;
+    std::vector<RowId> batch;
+    auto submit = [&]() {
+        std::uint64_t bytes = 0;
+        for (RowId row : batch) bytes += files.fileSize(row);
+        Progress::add(Progress::Counter::FilesQueued, batch.size());
+        Progress::add(Progress::Counter::BytesQueued, bytes);
+        batches.push_back(sharedThreadPool().enqueue([&files, &paths, batch = std::move(batch)]() {
+            for (RowId row : batch) {
+                auto digest = digestFile(paths.fullPath(files.path(row)), files.metadata(row));
+                if (digest) {
+                    files.setDigest(row, *digest);
+                } else {
+                    files.setDigestFailed(row);
+                }
+            }
+            Progress::add(Progress::Counter::FilesHashed, batch.size());
+        }));
+        batch.clear();
+    };
+    for (const auto& sample : samples) {
+        for (std::size_t i = 0; i < sample.rows.size(); ++i) {
+            if (i > 0 && sameInode(sample.rows[i], sample.rows[i - 1])) continue;
+            batch.push_back(sample.rows[i]);
+            estimate.hashedBytes += files.fileSize(sample.rows[i]);
+            if (batch.size() == HASH_BATCH_FILES) submit();
+        }
+        estimate.sampledFiles += sample.rows.size();
+    }
+    if (!batch.empty()) submit();
+    // The tasks borrow the tables, so all must finish before any failure
+    // is rethrown.
+    for (auto& task : batches) task.wait();
+    for (auto& task : batches) task.get();
+    estimate.hashSeconds = secondsSince(started);
+    estimate.sampledClasses = samples.size();
+
+    // A class's duplicate bytes are its size times the copies beyond one per
+    // distinct content. A file that could not be read counts as distinct.
+    for (auto& sample : samples) {
+        std::vector<Digest> digests;
+        std::size_t distinct = 0;
+        RowId leader = sample.rows.front();
+        for (std::size_t i = 0; i < sample.rows.size(); ++i) {
+            // Other names for an inode share the digest of its first.
+            if (i > 0 && !sameInode(sample.rows[i], leader)) leader = sample.rows[i];
+            if (files.digestState(leader) == DigestState::Hashed) {
+                digests.push_back(files.digest(leader));
+            } else {
+                ++distinct;
+            }
+        }
+        std::sort(digests.begin(), digests.end());
+        distinct += static_cast<std::size_t>(std::unique(digests.begin(), digests.end()) - digests.begin());
+        const auto size = static_cast<double>(files.fileSize(sample.rows.front()));
+        sample.duplicate = size * static_cast<double>(sample.rows.size() - distinct);
+    }
+
+    // Ratio estimator per stratum: duplicate bytes track each class's bound
+    // closely, and the stratum's total bound is known exactly.
+    double total = 0;
+    double variance = 0;
+    double proven = 0;      // duplicate bytes the sample found
+    double disproven = 0;   // bound the sample showed not to be duplicate
+    double unsampled = 0;   // bound of the strata left unsampled
+    for (std::size_t s = 0; s < strata.size(); ++s) {
+        double sampledBound = 0;
+        double sampledDuplicate = 0;
+        std::size_t sampled = 0;
+        for (const auto& sample : samples) {
+            if (sample.stratum != s) continue;
+            sampledBound += sample.bound;
+            sampledDuplicate += sample.duplicate;
+            ++sampled;
+        }
+        if (sampled == 0) {
+            unsampled += strata[s].bound;
+            continue;
+        }
+        proven += sampledDuplicate;
+        disproven += sampledBound - sampledDuplicate;
+        const auto population = static_cast<double>(strata[s].classes.size());
+        const double ratio = sampledBound > 0 ? sampledDuplicate / sampledBound : 0;
+        total += ratio * strata[s].bound;
+        if (sampled >= population || sampled < 2) continue;
+        double squares = 0;
+        for (const auto& sample : samples) {
+            if (sample.stratum != s) continue;
+            const double residual = sample.duplicate - ratio * sample.bound;
+            squares += residual * residual;
+        }
+        const auto n = static_cast<double>(sampled);
+        variance += population * population * (1 - n / population) * (squares / (n - 1)) / n;
+    }
+    // Unsampled strata take the ratio over all samples for the point
+    // estimate, but anything from none to all of their bound for the
+    // interval.
+    const double sampledBound = proven + disproven;
+    const double pooled = sampledBound > 0 ? proven / sampledBound : 0;
+    const double margin = Z_95 * std::sqrt(variance);
+    const double ceiling = static_cast<double>(estimate.candidateBytes) - disproven;
+    estimate.lower = std::clamp(total - margin, proven, ceiling);
+    estimate.upper = std::clamp(total + margin + unsampled, proven, ceiling);
+    estimate.duplicateBytes = std::clamp(total + pooled * unsampled, estimate.lower, estimate.upper);
+    return estimate;
+}
+
+void writeEstimate(std::ostream& out, const DuplicateEstimate& estimate) {
+    const auto bytes = [](double value) { return Progress::formatBytes(value); };
+    out << "Enumerated " << estimate.files << " files, " << bytes(static_cast<double>(estimate.bytes)) << ", in "
+        << estimate.walkSeconds << " s.\n";
+    out << estimate.candidateClasses << " sizes are shared by two or more files; at most "
+        << bytes(static_cast<double>(estimate.candidateBytes)) << " can be duplicate.\n";
+    out << "Hashed " << estimate.sampledClasses << " of those sizes (" << estimate.sampledFiles << " files, "
+        << bytes(static_cast<double>(estimate.hashedBytes)) << " of a "
+        << bytes(static_cast<double>(estimate.budgetBytes)) << " budget) in " << estimate.hashSeconds << " s.\n";
+    if (estimate.unsampledStrata > 0) {
+        out << estimate.unsampledStrata << " size ranges, holding at most "
+            << bytes(static_cast<double>(estimate.unsampledBytes))
+            << " that can be duplicate, had no size cheap enough to sample; the interval allows for all or none "
+               "of it.\n";
+    }
+    out << "Estimated duplicate bytes: " << bytes(estimate.duplicateBytes) << " (95% confidence "
+        << bytes(estimate.lower) << " to " << bytes(estimate.upper) << ").\n";
+}
+
+} // namespace FileComparator
@@ -0,0 +1,473 @@
+#include "ExternalGrouping.hpp"
+#include "DirectoryWalk.hpp"
+#include "Hashing.hpp"
+#include "Progress.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <queue>
+#include <system_error>
+#include <tuple>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace FileComparator {
+
+namespace {
+    constexpr std::size_t IO_BUFFER = 64 * 1024;
+    constexpr std::size_t MIN_RUN_RECORDS = 64;
+    // Files hashed per round, and per pool task within a round.
+    constexpr std::size_t HASH_WINDOW = 4096;
+    constexpr std::size_t HASH_BATCH_FILES = 64;
+
+    [[noreturn]] void throwErrno(const std::string& what) {
+        throw std::system_error(errno, std::generic_category(), what);
+    }
+
+    // Private scratch directory, removed with everything left in it.
+    class SpillDirectory {
+    public:
+        explicit SpillDirectory(std::string parent) {
+            if (parent.empty()) {
+                const char* tmp = std::getenv("TMPDIR");
+                parent = tmp && *tmp ? tmp : "/tmp";
+            }
+            std::string pattern = parent + "/fs2-spill-XXXXXX";
+            if (!::mkdtemp(pattern.data())) throwErrno("Cannot create spill directory in " + parent);
+            path = std::move(pattern);
+        }
+        ~SpillDirectory() {
+            std::error_code ec;
+            fs::remove_all(path, ec);
+        }
+        SpillDirectory(const SpillDirectory&) = delete;
+        SpillDirectory& operator=(const SpillDirectory&) = delete;
+
+        std::string file(const std::string& name) const { return path + "/" + name; }
+
+    private:
+        std::string path;
+    };
+
+    // Append-only temporary file behind a write buffer. Once flushed it may
+    // be read by offset from any thread. Unlinked on destruction.
+    class SpillFile {
+    public:
+        explicit SpillFile(std::string path) : path(std::move(path)) {
+            fd = ::open(this->path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+            if (fd < 0) throwErrno("Cannot create spill file " + this->path);
+            buffer.reserve(IO_BUFFER);
+        }
+        ~SpillFile() {
+            ::close(fd);
+            ::unlink(path.c_str());
+        }
+        SpillFile(const SpillFile&) = delete;
+        SpillFile& operator=(const SpillFile&) = delete;
+
+        std::uint64_t size() const { return written + buffer.size(); }
+
+        void append(const void* data, std::size_t size) {
+            const auto* bytes = static_cast<const char*>(data);
+            if (buffer.size() + size > IO_BUFFER) flush();
+            if (size > IO_BUFFER) {
+                writeAll(bytes, size);
+            } else {
+                buffer.insert(buffer.end(), bytes, bytes + size);
+            }
+        }
+
+        void flush() {
+            writeAll(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+
+        void readAt(std::uint64_t offset, void* data, std::size_t size) const {
+            auto* out = static_cast<char*>(data);
+            while (size > 0) {
+                const ssize_t n = ::pread(fd, out, size, static_cast<off_t>(offset));
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) {
+                    if (n == 0) errno = EIO;
+                    throwErrno("Cannot read spill file " + path);
+                }
+                out += n;
+                offset += static_cast<std::uint64_t>(n);
+                size -= static_cast<std::size_t>(n);
+            }
+        }
+
+    private:
+        void writeAll(const char* data, std::size_t size) {
+            while (size > 0) {
+                const ssize_t n = ::write(fd, data, size);
+                if (n < 0 && errno == EINTR) continue;
+                if (n < 0) throwErrno("Cannot write spill file " + path);
+                data += n;
+                size -= static_cast<std::size_t>(n);
+                written += static_cast<std::uint64_t>(n);
+            }
+        }
+
+        std::string path;
+        int fd = -1;
+        std::vector<char> buffer;
+        std::uint64_t written = 0;
+    };
+
+    // Full paths, length-prefixed and addressed by offset. Offsets grow in
+    // enumeration order, so they also serve as the final sort key.
+    class PathStore {
+    public:
+        explicit PathStore(std::string path) : file(std::move(path)) {}
+
+        std::uint64_t add(const std::string& path) {
+            const std::uint64_t offset = file.size();
+            const auto length = static_cast<std::uint32_t>(path.size());
+            file.append(&length, sizeof(length));
+            file.append(path.data(), path.size());
+            return offset;
+        }
+
+        void seal() { file.flush(); }
+
+        std::string get(std::uint64_t offset) const {
+            std::uint32_t length = 0;
+            file.readAt(offset, &length, sizeof(length));
+            std::string path(length, '\0');
+            file.readAt(offset + sizeof(length), path.data(), length);
+            return path;
+        }
+
+    private:
+        SpillFile file;
+    };
+
+    struct ScanRecord {
+        std::uint64_t size;
+        std::uint64_t device;
+        std::uint64_t inode;
+        std::uint64_t path;
+        std::uint64_t blocks;   // from the walk's statx, so hashing need not stat again
+
+        bool operator<(const ScanRecord& other) const {
+            return std::tie(size, device, inode, path) < std::tie(other.size, other.device, other.inode, other.path);
+        }
+    };
+
+    struct DigestRecord {
+        std::uint64_t size;
+        Digest digest;
+        std::uint64_t path;
+
+        bool operator<(const DigestRecord& other) const {
+            return std::tie(size, digest, path) < std::tie(other.size, other.digest, other.path);
+        }
+    };
+
+    // Sequential reader over one sorted run.
+    template<typename Record>
+    class RunReader {
+    public:
+        RunReader(const SpillFile& file, std::size_t bufferRecords)
+            : file(&file), total(file.size() / sizeof(Record)), buffer(bufferRecords) {}
+
+        // Loads the next record into current; false at the end of the run.
+        bool next() {
+            if (position == filled) {
+                if (consumed == total) return false;
+                filled = static_cast<std::size_t>(std::min<std::uint64_t>(buffer.size(), total - consumed));
+                file->readAt(consumed * sizeof(Record), buffer.data(), filled * sizeof(Record));
+                consumed += filled;
+                position = 0;
+            }
+            current = buffer[position++];
+            return true;
+        }
+
+        Record current{};
+
+    private:
+        const SpillFile* file;
+        std::uint64_t total;
+        std::uint64_t consumed = 0;
+        std::vector<Record> buffer;
+        std::size_t position = 0;
+        std::size_t filled = 0;
+    };
+
+    // K-way merge of runs[begin, end) through a min-heap of readers.
+    template<typename Record>
+    class RunMerger {
+    public:
+        RunMerger(const std::vector<std::unique_ptr<SpillFile>>& runs, std::size_t begin, std::size_t end,
+                  std::size_t bufferRecords)
+            : heap(Later{this}) {
+            readers.reserve(end - begin);
+            for (std::size_t i = begin; i < end; ++i) {
+                readers.emplace_back(*runs[i], bufferRecords);
+                if (readers.back().next()) heap.push(readers.size() - 1);
+            }
+        }
+        RunMerger(const RunMerger&) = delete;
+        RunMerger& operator=(const RunMerger&) = delete;
+
+        bool next(Record& out) {
+            if (heap.empty()) return false;
+            const std::size_t reader = heap.top();
+            heap.pop();
+            out = readers[reader].current;
+            if (readers[reader].next()) heap.push(reader);
+            return true;
+        }
+
+    private:
+        struct Later {
+            const RunMerger* merger;
+            bool operator()(std::size_t a, std::size_t b) const {
+                return merger->readers[b].current < merger->readers[a].current;
+            }
+        };
+
+        std::vector<RunReader<Record>> readers;
+        std::priority_queue<std::size_t, std::vector<std::size_t>, Later> heap;
+    };
+
+    // Sorts an unbounded stream of records in bounded memory. A full buffer
+    // is sorted and spilled as a run; at the end, runs are merged at most
+    // fanIn at a time until one merge can feed next() directly. Input that
+    // never fills the buffer is sorted in place and never touches disk.
+    template<typename Record>
+    class ExternalSorter {
+    public:
+        ExternalSorter(const SpillDirectory& directory, std::string prefix, std::size_t budget)
+            : directory(directory), prefix(std::move(prefix)),
+              capacity(std::max(MIN_RUN_RECORDS, budget / sizeof(Record))),
+              fanIn(std::max<std::size_t>(2, budget / IO_BUFFER)),
+              readerRecords(std::max<std::size_t>(1, std::min(IO_BUFFER, budget / fanIn) / sizeof(Record))) {}
+
+        void add(const Record& record) {
+            buffer.push_back(record);
+            if (buffer.size() == capacity) spill();
+        }
+
+        // Ends input; records then come out of next() in ascending order.
+        void finish() {
+            if (runs.empty()) {
+                std::sort(buffer.begin(), buffer.end());
+                return;
+            }
+            if (!buffer.empty()) spill();
+            std::vector<Record>().swap(buffer);
+            while (runs.size() > fanIn) mergePass();
+            merger = std::make_unique<RunMerger<Record>>(runs, 0, runs.size(), readerRecords);
+        }
+
+        bool next(Record& out) {
+            if (merger) return merger->next(out);
+            if (position == buffer.size()) return false;
+            out = buffer[position++];
+            return true;
+        }
+
+    private:
+        std::unique_ptr<SpillFile> newRun() {
+            return std::make_unique<SpillFile>(directory.file(prefix + "-" + std::to_string(nextRun++)));
+        }
+
+        void spill() {
+            std::sort(buffer.begin(), buffer.end());
+            auto run = newRun();
+            run->append(buffer.data(), buffer.size() * sizeof(Record));
+            run->flush();
+            runs.push_back(std::move(run));
+            buffer.clear();
+        }
+
+        void mergePass() {
+            std::vector<std::unique_ptr<SpillFile>> merged;
+            for (std::size_t begin = 0; begin < runs.size(); begin += fanIn) {
+                const std::size_t end = std::min(begin + fanIn, runs.size());
+                auto run = newRun();
+                RunMerger<Record> pass(runs, begin, end, readerRecords);
+                Record record;
+                while (pass.next(record)) {
+                    run->append(&record, sizeof(record));
+                }
+                run->flush();
+                merged.push_back(std::move(run));
+            }
+            runs = std::move(merged);
+        }
+
+        const SpillDirectory& directory;
+        std::string prefix;
+        std::size_t capacity;
+        std::size_t fanIn;
+        std::size_t readerRecords;
+        std::size_t nextRun = 0;
+        std::vector<Record> buffer;
+        std::size_t position = 0;
+        std::vector<std::unique_ptr<SpillFile>> runs;
+        std::unique_ptr<RunMerger<Record>> merger;
+    };
+
+    bool sameInode(const ScanRecord& a, const ScanRecord& b) {
+        return a.size == b.size && a.device == b.device && a.inode == b.inode;
+    }
+
+    // Hashes one window of scan records, ordered by (size, device, inode),
+    // on the shared pool. Only the first name of each inode is read; the
+    // others reuse its digest. last carries the previous window's final
+    // record and digest, since the names of an inode may straddle windows.
+    void digestWindow(const std::vector<ScanRecord>& window, const PathStore& paths,
+                      std::optional<std::pair<ScanRecord, std::optional<Digest>>>& last,
+                      ExternalSorter<DigestRecord>& out) {
+        std::vector<bool> alias(window.size());
+        std::vector<std::size_t> leaders;
+        for (std::size_t i = 0; i < window.size(); ++i) {
+            alias[i] = i > 0 ? sameInode(window[i], window[i - 1]) : last && sameInode(window[i], last->first);
+            if (!alias[i]) leaders.push_back(i);
+        }
+
+        std::vector<std::optional<Digest>> digests(window.size());
+        std::vector<std::future<void>> batches;
+        for (std::size_t begin = 0; begin < leaders.size(); begin += HASH_BATCH_FILES) {
+            const std::size_t end = std::min(begin + HASH_BATCH_FILES, leaders.size());
+            std::uint64_t bytes = 0;
+            for (std::size_t k = begin; k < end; ++k) bytes += window[leaders[k]].size;
+            Progress::add(Progress::Counter::FilesQueued, end - begin);
+            Progress::add(Progress::Counter::BytesQueued, bytes);
+            batches.push_back(sharedThreadPool().enqueue([&, begin, end]() {
+                for (std::size_t k = begin; k < end; ++k) {
+                    const ScanRecord& record = window[leaders[k]];
+                    FileMetadata metadata;
+                    metadata.type = FileType::Regular;
+                    metadata.size = record.size;
+                    metadata.device = record.device;
+                    metadata.inode = record.inode;
+                    metadata.blocks = record.blocks;
+                    digests[leaders[k]] = digestFile(paths.get(record.path), metadata);
+                }
+                Progress::add(Progress::Counter::FilesHashed, end - begin);
+            }));
+        }
+        // Every task borrows the locals above, so all must finish before
+        // the first failure is rethrown.
+        for (auto& batch : batches) batch.wait();
+        for (auto& batch : batches) batch.get();
+
+        for (std::size_t i = 0; i < window.size(); ++i) {
+            if (alias[i]) digests[i] = i > 0 ? digests[i - 1] : last->second;
+            if (!digests[i]) continue;   // digestFile has recorded why
+            out.add(DigestRecord{window[i].size, *digests[i], window[i].path});
+        }
+        if (!window.empty()) last.emplace(window.back(), digests.back());
+    }
+
+    FileInfo makeInfo(const PathStore& paths, std::uint64_t offset, std::uint64_t size, const std::string& hash) {
+        std::string path = paths.get(offset);
+        const auto slash = path.find_last_of('/');
+        std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+        return FileInfo{std::move(path), std::move(name), size, hash};
+    }
+}
+
+std::optional<std::size_t> parseByteSize(const std::string& text) {
+    std::size_t digits = 0;
+    while (digits < text.size() && std::isdigit(static_cast<unsigned char>(text[digits]))) ++digits;
+    if (digits == 0 || digits > 19) return std::nullopt;
+
+    std::size_t shift = 0;
+    const std::string suffix = text.substr(digits);
+    if (suffix.size() > 1) return std::nullopt;
+    if (suffix.size() == 1) {
+        switch (std::toupper(static_cast<unsigned char>(suffix[0]))) {
+            case 'K': shift = 10; break;
+            case 'M': shift = 20; break;
+            case 'G': shift = 30; break;
+            case 'T': shift = 40; break;
+            default: return std::nullopt;
+        }
+    }
+    const std::size_t value = std::stoull(text.substr(0, digits));
+    if (value > (SIZE_MAX >> shift)) return std::nullopt;
+    return value << shift;
+}
+
+Generator<DuplicateGroup> groupByContentExternal(std::vector<std::string> directories, ExternalOptions options) {
+    try {
+        SpillDirectory spill(options.tempDirectory);
+        PathStore paths(spill.file("paths"));
+        // The two sorts overlap: the first is merged while the second fills.
+        const std::size_t sortBudget = options.memoryBudget / 2;
+
+        ExternalSorter<ScanRecord> scanned(spill, "scan", sortBudget);
+        Progress::setWalking(true);
+        for (const auto& directory : distinctRoots(directories)) {
+            walkRegularFiles(
+                directory,
+                [](std::size_t, const fs::path&) {},
+                [&](std::size_t, WalkEntry& entry, const FileMetadata& metadata) {
+                    if (metadata.size < options.grouping.minSize) return;
+                    scanned.add(ScanRecord{metadata.size, metadata.device, metadata.inode,
+                                           paths.add(entry.path().native()), metadata.blocks});
+                });
+        }
+        Progress::setWalking(false);
+        paths.seal();
+        scanned.finish();
+
+        // Size classes stream out of the merge in order. Unless hashUnique is
+        // set, a file alone in its class is yielded at once, unhashed; the
+        // rest are hashed a window at a time and fed to the second sort.
+        ExternalSorter<DigestRecord> digested(spill, "digest", sortBudget);
+        std::vector<ScanRecord> window;
+        std::optional<std::pair<ScanRecord, std::optional<Digest>>> last;
+        ScanRecord lookahead{};
+        bool more = scanned.next(lookahead);
+        std::optional<std::uint64_t> classSize;
+        while (more) {
+            const ScanRecord record = lookahead;
+            more = scanned.next(lookahead);
+            const bool classStart = classSize != record.size;
+            classSize = record.size;
+            if (classStart && !(more && lookahead.size == record.size) && !options.grouping.hashUnique) {
+                if (options.grouping.duplicatesOnly) continue;
+                DuplicateGroup group{record.size, std::string(), {makeInfo(paths, record.path, record.size, "")}};
+                co_yield std::move(group);
+                continue;
+            }
+            window.push_back(record);
+            if (window.size() == HASH_WINDOW) {
+                digestWindow(window, paths, last, digested);
+                window.clear();
+            }
+        }
+        digestWindow(window, paths, last, digested);
+        std::vector<ScanRecord>().swap(window);
+        digested.finish();
+
+        DigestRecord entry{};
+        bool pending = digested.next(entry);
+        while (pending) {
+            const Digest digest = entry.digest;
+            DuplicateGroup group{entry.size, entry.size != 0 ? digestToHex(digest) : std::string(), {}};
+            do {
+                group.files.push_back(makeInfo(paths, entry.path, entry.size, group.hash));
+                pending = digested.next(entry);
+            } while (pending && entry.size == group.size && entry.digest == digest);
+            if (options.grouping.duplicatesOnly && group.files.size() < 2) continue;
+            co_yield std::move(group);
+        }
+    } catch (const std::system_error& e) {
+        std::cerr << "Spill error: " << e.what() << std::endl;
+    }
+}
+
+} // namespace FileComparator
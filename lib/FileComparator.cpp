@@ -1,103 +1,294 @@
 #include "FileComparator.hpp"
+#include "Archive.hpp"
+#include "DirectoryWalk.hpp"
+#include "Errors.hpp"
+#include "FileTable.hpp"
+#include "FlatGroupMap.hpp"
+#include "GroupingEngine.hpp"
+#include "Hashing.hpp"
+#include "PathTable.hpp"
+#include "Progress.hpp"
 #include <filesystem>
 #include <fstream>
 #include <array>
-#include <iomanip>
-#include <sstream>
 #include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
 #include <numeric>
+#include <optional>
+#include <tuple>
+#include <unordered_map>
 
 namespace fs = std::filesystem;
 
 namespace FileComparator {
 
 namespace {
-    constexpr size_t BUFFER_SIZE = 8192;
     ThreadPool pool;  // Global thread pool
 
     std::string calculateHash(const char* data, size_t size) {
-        constexpr uint64_t FNV_PRIME = 1099511628211ULL;
-        constexpr uint64_t FNV_OFFSET = 14695981039346656037ULL;
+        return digestToHex(calculateDigest(data, size));
+    }
 
-        uint64_t hash = FNV_OFFSET;
-        for (size_t i = 0; i < size; ++i) {
-            hash ^= static_cast<uint64_t>(data[i]);
-            hash *= FNV_PRIME;
+    // Hash of a file or symlink described by metadata; errors are recorded
+    // with Errors and give an empty hash.
+    std::string hashFile(const std::string& path, const FileMetadata& metadata) {
+        if (metadata.type == FileType::Symlink) {
+            // For symlinks, hash the target path
+            std::error_code ec;
+            const std::string targetPath = fs::read_symlink(path, ec).string();
+            if (ec) {
+                Errors::record(Errors::Operation::ReadLink, ec, path);
+                return std::string();
+            }
+            return calculateHash(targetPath.data(), targetPath.size());
         }
 
-        std::stringstream ss;
-        ss << std::hex << std::setfill('0') << std::setw(16) << hash;
-        return ss.str();
+        // Streamed (and sparse-aware) rather than read whole into memory.
+        if (metadata.size == 0) return std::string();
+        auto digest = digestFile(path, metadata);
+        return digest ? digestToHex(*digest) : std::string();
     }
 
-    std::string getFileContent(const fs::path& path) {
-        try {
-            if (fs::is_symlink(path)) {
-                return fs::read_symlink(path).string(); // Use symlink target as content
-            }
+    std::string hashPath(const std::string& path) {
+        FileMetadata metadata;
+        if (const int error = readMetadata(AT_FDCWD, path.c_str(), metadata)) {
+            Errors::record(Errors::Operation::Stat, error, path);
+            return std::string();
+        }
+        return hashFile(path, metadata);
+    }
 
-            std::ifstream file(path, std::ios::binary);
-            if (!file) return std::string();
+    // Digests compareFiles and compareMany have computed, for files that
+    // have not changed since. Cleared when full rather than tracking use.
+    struct MemoKey {
+        std::uint64_t device;
+        std::uint64_t inode;
+        std::uint64_t size;
+        std::int64_t mtime;
+        bool operator==(const MemoKey&) const = default;
+    };
 
-            file.seekg(0, std::ios::end);
-            size_t size = file.tellg();
-            file.seekg(0, std::ios::beg);
+    struct MemoKeyHash {
+        std::size_t operator()(const MemoKey& key) const {
+            std::uint64_t h = key.inode * 0x9e3779b97f4a7c15ULL;
+            h ^= key.device + 0x7f4a7c159e3779b9ULL + (h << 6) + (h >> 2);
+            h ^= key.size + 0x7f4a7c159e3779b9ULL + (h << 6) + (h >> 2);
+            h ^= static_cast<std::uint64_t>(key.mtime) + 0x7f4a7c159e3779b9ULL + (h << 6) + (h >> 2);
+            return static_cast<std::size_t>(h);
+        }
+    };
 
-            std::string content(size, '\0');
-            file.read(content.data(), size);
-            return content;
-        } catch (...) {
-            return std::string();
+    constexpr std::size_t DIGEST_MEMO_ENTRIES = 1 << 16;
+    std::mutex memoMutex;
+    std::unordered_map<MemoKey, std::string, MemoKeyHash> digestMemo;
+
+    MemoKey memoKey(const FileMetadata& metadata) {
+        return MemoKey{metadata.device, metadata.inode, metadata.size, metadata.mtime};
+    }
+
+    std::optional<std::string> rememberedHash(const FileMetadata& metadata) {
+        std::lock_guard lock(memoMutex);
+        auto it = digestMemo.find(memoKey(metadata));
+        if (it == digestMemo.end()) return std::nullopt;
+        return it->second;
+    }
+
+    std::string memoizedHash(const std::string& path, const FileMetadata& metadata) {
+        if (auto hash = rememberedHash(metadata)) return *hash;
+        std::string hash = hashFile(path, metadata);
+        if (!hash.empty()) {
+            std::lock_guard lock(memoMutex);
+            if (digestMemo.size() >= DIGEST_MEMO_ENTRIES) digestMemo.clear();
+            digestMemo.insert_or_assign(memoKey(metadata), hash);
+        }
+        return hash;
+    }
+
+    // Hash of the file at path as it is now, from the memo when it has not
+    // changed and otherwise computed on the pool; nullopt if it could not be
+    // read. An empty file hashes to an empty string.
+    std::future<std::optional<std::string>> memoizedHashAsync(const std::string& path) {
+        FileMetadata metadata;
+        std::optional<std::optional<std::string>> known;
+        if (const int error = readMetadata(AT_FDCWD, path.c_str(), metadata)) {
+            Errors::record(Errors::Operation::Stat, error, path);
+            known.emplace();
+        } else if (metadata.type == FileType::Regular && metadata.size == 0) {
+            known.emplace(std::string());
+        } else if (auto hash = rememberedHash(metadata)) {
+            known.emplace(std::move(*hash));
+        }
+        if (known) {
+            std::promise<std::optional<std::string>> ready;
+            ready.set_value(std::move(*known));
+            return ready.get_future();
+        }
+        return pool.enqueue([path, metadata]() -> std::optional<std::string> {
+            std::string hash = memoizedHash(path, metadata);
+            if (hash.empty()) return std::nullopt;
+            return hash;
+        });
+    }
+
+    // Rows handed to one hash task: enough to amortise the queue hop, few
+    // enough bytes that a class of large files still spreads across workers.
+    constexpr size_t HASH_BATCH_FILES = 64;
+    constexpr std::uint64_t HASH_BATCH_BYTES = 16 * 1024 * 1024;
+    // Size classes at least this large are grouped by digest in parallel.
+    constexpr size_t PARALLEL_GROUPING_ROWS = 64 * 1024;
+
+    // Archive members get a device no real file has and inodes of their own,
+    // so inode aliasing never merges them.
+    constexpr std::uint64_t ARCHIVE_DEVICE = UINT64_MAX;
+
+    // Adds every regular member of the archives among the collected files as
+    // an already-hashed row named "archive.tar!/member/path" beside its
+    // archive. Each archive is streamed by its own pool task. With
+    // ownsArchive, only the archives it accepts are read.
+    void appendArchiveMembers(const std::function<bool(std::uint64_t)>& keepSize,
+                              const std::function<bool(const std::string&)>& ownsArchive, PathTable& paths,
+                              FileTable& files, ThreadPool& hashPool) {
+        std::vector<std::pair<RowId, std::future<std::vector<ArchiveMember>>>> archives;
+        const RowId collected = static_cast<RowId>(files.size());
+        for (RowId row = 0; row < collected; ++row) {
+            const auto format = archiveFormatOf(paths.name(files.path(row)));
+            if (!format) continue;
+            std::string path = paths.fullPath(files.path(row));
+            if (ownsArchive && !ownsArchive(path)) continue;
+            archives.emplace_back(row, hashPool.enqueue([path = std::move(path), format = *format]() {
+                return hashArchiveMembers(path, format);
+            }));
+        }
+
+        std::uint64_t nextInode = 0;
+        for (auto& [archive, members] : archives) {
+            const PathId parent = paths.parent(files.path(archive));
+            const std::string prefix = std::string(paths.name(files.path(archive))) + std::string(ARCHIVE_SEPARATOR);
+            for (const auto& member : members.get()) {
+                if (keepSize && !keepSize(member.size)) continue;
+                const RowId row = files.append(paths.add(parent, prefix + member.path), member.size, ARCHIVE_DEVICE,
+                                               nextInode++, files.mtime(archive));
+                files.setDigest(row, member.digest);
+            }
+        }
+    }
+}
+
+std::vector<std::string> distinctRoots(const std::vector<std::string>& directories) {
+    std::vector<std::pair<std::string, std::string>> roots;
+    for (const auto& directory : directories) {
+        std::error_code ec;
+        auto canonical = fs::weakly_canonical(directory, ec);
+        roots.emplace_back(ec ? directory : canonical.string(), directory);
+    }
+    auto contains = [](const std::string& outer, const std::string& inner) {
+        return inner.size() > outer.size() && inner.compare(0, outer.size(), outer) == 0 &&
+               (outer.back() == '/' || inner[outer.size()] == '/');
+    };
+
+    std::vector<std::string> result;
+    for (size_t i = 0; i < roots.size(); ++i) {
+        bool covered = false;
+        for (size_t j = 0; j < roots.size() && !covered; ++j) {
+            if (i == j) continue;
+            covered = contains(roots[j].first, roots[i].first) ||
+                      (roots[j].first == roots[i].first && j < i);
         }
+        if (!covered) result.push_back(roots[i].second);
     }
+    return result;
+}
+
+namespace {
+    // A failure leaves the row pending; its batch retries with digestFile,
+    // which records the error.
+    void hashTinyRow(FileTable& files, RowId row, int directoryFd, const char* name) {
+        const auto digest = digestTinyFile(directoryFd, name, files.fileSize(row));
+        if (!digest) return;
+        files.setDigest(row, *digest);
+        Progress::add(Progress::Counter::FilesQueued);
+        Progress::add(Progress::Counter::BytesQueued, files.fileSize(row));
+        Progress::add(Progress::Counter::FilesHashed);
+    }
+}
+
+// Directories are interned as they are entered, so every file costs one
+// table entry holding just its own name.
+void collectRegularFiles(const std::string& directory, const std::function<bool(std::uint64_t)>& keepSize,
+                         PathTable& paths, FileTable& files, bool keepArchives, TinyFileClasses* tiny) {
+    // parents[d] is the directory whose entries sit at depth d.
+    std::vector<PathId> parents{paths.addRoot(directory)};
+    walkRegularFiles(
+        directory,
+        [&](size_t depth, const fs::path& path) {
+            parents.resize(depth + 1);
+            parents.push_back(paths.add(parents[depth], path.filename().native()));
+        },
+        [&](size_t depth, WalkEntry& entry, const FileMetadata& metadata) {
+            const bool kept = !keepSize || keepSize(metadata.size);
+            if (!kept && !(keepArchives && archiveFormatOf(entry.name()))) return;
+            const RowId row = files.append(paths.add(parents[depth], entry.name()), metadata.size, metadata.device,
+                                           metadata.inode, metadata.mtime, metadata.links, metadata.blocks);
+            if (!tiny || !kept || metadata.size == 0 || metadata.size > TINY_FILE_BYTES) return;
+            RowId& first = tiny->first[metadata.size];
+            if (first == TinyFileClasses::NONE) {
+                first = row;
+                return;
+            }
+            if (first != TinyFileClasses::HASHED) {
+                // Its directory may be closed by now.
+                hashTinyRow(files, first, AT_FDCWD, paths.fullPath(files.path(first)).c_str());
+                first = TinyFileClasses::HASHED;
+            }
+            hashTinyRow(files, row, entry.directory(), entry.name());
+        });
+}
+
+ThreadPool& sharedThreadPool() {
+    return pool;
 }
 
 Generator<FileInfo> scanDirectoryAsync(const std::string& directory) {
-    try {
-        const fs::path dir_path(directory);
-        if (!fs::exists(dir_path)) co_return;
-
-        std::vector<std::future<std::string>> hashFutures;
-        std::vector<fs::path> paths;
-
-        fs::recursive_directory_iterator dirIt(
-            dir_path,
-            fs::directory_options::follow_directory_symlink | 
-            fs::directory_options::skip_permission_denied
-        );
-
-        for (const auto& entry : dirIt) {
-            try {
-                if (entry.is_regular_file() || entry.is_symlink()) {
-                    fs::path filePath = entry.path();
-                    paths.push_back(filePath);
-                    hashFutures.push_back(computeHashAsync(filePath.string()));
+    std::vector<std::future<std::string>> hashFutures;
+    std::vector<std::string> inlineHashes;   // tiny files, whose futures stay empty
+    std::vector<fs::path> paths;
+    std::vector<FileMetadata> metadata;
+
+    walkTree(
+        directory, [](std::size_t, const fs::path&) {},
+        [&](std::size_t, WalkEntry& entry) {
+            const FileType type = entry.type();
+            if (type != FileType::Regular && type != FileType::Symlink) return;
+            const FileMetadata* known = entry.metadata();
+            if (!known || (known->type != FileType::Regular && known->type != FileType::Symlink)) return;
+            paths.push_back(entry.path());
+            metadata.push_back(*known);
+            if (known->type == FileType::Regular && known->size <= TINY_FILE_BYTES) {
+                auto digest = known->size > 0 ? digestTinyFile(entry.directory(), entry.name(), known->size)
+                                              : std::optional<Digest>();
+                if (known->size == 0 || digest) {
+                    inlineHashes.push_back(known->size > 0 ? digestToHex(*digest) : std::string());
+                    hashFutures.emplace_back();
+                    return;
                 }
-            } catch (const fs::filesystem_error& e) {
-                std::cerr << "Error processing entry: " << e.what() << std::endl;
-                continue;
             }
-        }
+            inlineHashes.emplace_back();
+            hashFutures.push_back(pool.enqueue([path = entry.path().string(), known = *known]() {
+                return hashFile(path, known);
+            }));
+        });
 
-        for (size_t i = 0; i < paths.size(); ++i) {
-            try {
-                size_t fileSize = fs::is_symlink(paths[i]) ? 
-                    fs::read_symlink(paths[i]).string().length() :
-                    fs::file_size(paths[i]);
-
-                co_yield FileInfo{
-                    paths[i].string(),
-                    paths[i].filename().string(),
-                    fileSize,
-                    hashFutures[i].get()
-                };
-            } catch (const fs::filesystem_error& e) {
-                std::cerr << "Error yielding file info: " << e.what() << std::endl;
-                continue;
-            }
-        }
-    } catch (const fs::filesystem_error& e) {
-        std::cerr << "Filesystem error: " << e.what() << std::endl;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        FileInfo info{
+            paths[i].string(),
+            paths[i].filename().string(),
+            metadata[i].size,
+            hashFutures[i].valid() ? hashFutures[i].get() : std::move(inlineHashes[i]),
+            metadata[i]
+        };
+        co_yield std::move(info);
     }
 }
 
@@ -112,31 +303,335 @@ std::vector<FileInfo> scanDirectory(const std::string& directory) {
 
 std::future<std::string> computeHashAsync(const std::string& path) {
     return pool.enqueue([path]() {
-        try {
-            if (fs::is_symlink(path)) {
-                // For symlinks, hash the target path
-                std::string targetPath = fs::read_symlink(path).string();
-                return calculateHash(targetPath.data(), targetPath.size());
-            }
+        return hashPath(path);
+    });
+}
 
-            std::string content = getFileContent(path);
-            if (content.empty()) return std::string();
+std::future<std::string> computeHashAsync(const FileInfo& file) {
+    if (!file.metadata.known()) return computeHashAsync(file.path);
+    return pool.enqueue([path = file.path, metadata = file.metadata]() {
+        return hashFile(path, metadata);
+    });
+}
 
-            return calculateHash(content.data(), content.size());
-        } catch (...) {
-            return std::string();
+bool compareFiles(const FileInfo& file1, const FileInfo& file2) {
+    if (!file1.hash.empty() && !file2.hash.empty()) return file1.hash == file2.hash;
+
+    // Only a missing hash is looked up, both at once if both are.
+    using HashFuture = std::future<std::optional<std::string>>;
+    auto future1 = file1.hash.empty() ? memoizedHashAsync(file1.path) : HashFuture();
+    auto future2 = file2.hash.empty() ? memoizedHashAsync(file2.path) : HashFuture();
+    const auto hash1 = future1.valid() ? future1.get() : std::optional(file1.hash);
+    const auto hash2 = future2.valid() ? future2.get() : std::optional(file2.hash);
+    // An unreadable file matches nothing, not even another unreadable one.
+    return hash1 && hash2 && *hash1 == *hash2;
+}
+
+std::vector<std::vector<std::size_t>> compareMany(std::span<const FileInfo> files) {
+    // Names of one inode share its content and are read once, as one.
+    struct Inode {
+        std::string path;
+        FileMetadata metadata;
+        std::vector<std::size_t> members;
+        Digest head = 0;
+        std::string hash;
+        bool failed = false;
+    };
+    std::vector<std::vector<std::size_t>> classes;
+    std::vector<Inode> inodes;
+    std::map<std::pair<std::uint64_t, std::uint64_t>, std::size_t> byInode;
+    for (std::size_t i = 0; i < files.size(); ++i) {
+        FileMetadata metadata;
+        if (const int error = readMetadata(AT_FDCWD, files[i].path.c_str(), metadata)) {
+            Errors::record(Errors::Operation::Stat, error, files[i].path);
+            classes.push_back({i});
+            continue;
         }
+        auto [it, added] = byInode.try_emplace({metadata.device, metadata.inode}, inodes.size());
+        if (added) inodes.push_back(Inode{files[i].path, metadata, {}, 0, {}, false});
+        inodes[it->second].members.push_back(i);
+    }
+
+    // Only inodes of one type and size can match; runs of them are
+    // narrowed by the digest of their head before any is read in full.
+    std::vector<std::size_t> order(inodes.size());
+    std::iota(order.begin(), order.end(), std::size_t{0});
+    std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+        const auto& x = inodes[a].metadata;
+        const auto& y = inodes[b].metadata;
+        return std::tie(x.type, x.size, a) < std::tie(y.type, y.size, b);
     });
+    auto sameRun = [&](std::size_t a, std::size_t b) {
+        return inodes[a].metadata.type == inodes[b].metadata.type && inodes[a].metadata.size == inodes[b].metadata.size;
+    };
+    auto byHead = [&](std::size_t a, std::size_t b) {
+        return std::tie(inodes[a].failed, inodes[a].head, a) < std::tie(inodes[b].failed, inodes[b].head, b);
+    };
+    auto runEnd = [&](std::size_t begin, auto&& same) {
+        std::size_t end = begin + 1;
+        while (end < order.size() && same(order[begin], order[end])) ++end;
+        return end;
+    };
+
+    std::vector<std::future<void>> reads;
+    for (std::size_t begin = 0; begin < order.size();) {
+        const std::size_t end = runEnd(begin, sameRun);
+        const FileMetadata& metadata = inodes[order[begin]].metadata;
+        if (end - begin > 1 && metadata.type == FileType::Regular && metadata.size > HEAD_DIGEST_BYTES) {
+            for (std::size_t i = begin; i < end; ++i) {
+                reads.push_back(pool.enqueue([&inode = inodes[order[i]]]() {
+                    const auto head = digestFileHead(inode.path);
+                    inode.head = head.value_or(0);
+                    inode.failed = !head;
+                }));
+            }
+        }
+        begin = end;
+    }
+    for (auto& read : reads) read.wait();
+    for (auto& read : reads) read.get();
+
+    // Inodes still sharing type, size and head are hashed in full.
+    reads.clear();
+    for (std::size_t begin = 0; begin < order.size();) {
+        const std::size_t end = runEnd(begin, sameRun);
+        std::sort(order.begin() + static_cast<std::ptrdiff_t>(begin), order.begin() + static_cast<std::ptrdiff_t>(end),
+                  byHead);
+        for (std::size_t first = begin; first < end;) {
+            std::size_t last = first + 1;
+            while (last < end && !inodes[order[first]].failed && !inodes[order[last]].failed &&
+                   inodes[order[last]].head == inodes[order[first]].head) {
+                ++last;
+            }
+            const bool empty = inodes[order[first]].metadata.type == FileType::Regular &&
+                               inodes[order[first]].metadata.size == 0;
+            if (last - first > 1 && !empty) {
+                for (std::size_t i = first; i < last; ++i) {
+                    reads.push_back(pool.enqueue([&inode = inodes[order[i]]]() {
+                        inode.hash = memoizedHash(inode.path, inode.metadata);
+                        inode.failed = inode.hash.empty();
+                    }));
+                }
+            }
+            first = last;
+        }
+        begin = end;
+    }
+    for (auto& read : reads) read.wait();
+    for (auto& read : reads) read.get();
+
+    // Within a run, inodes match on head and hash; an inode never hashed
+    // had nothing to match, and a failed one matches nothing.
+    for (std::size_t begin = 0; begin < order.size();) {
+        const std::size_t end = runEnd(begin, sameRun);
+        std::map<std::pair<Digest, std::string>, std::size_t> matches;
+        for (std::size_t i = begin; i < end; ++i) {
+            const Inode& inode = inodes[order[i]];
+            std::size_t target = classes.size();
+            if (!inode.failed) {
+                target = matches.try_emplace({inode.head, inode.hash}, classes.size()).first->second;
+            }
+            if (target == classes.size()) classes.emplace_back();
+            classes[target].insert(classes[target].end(), inode.members.begin(), inode.members.end());
+        }
+        begin = end;
+    }
+
+    for (auto& members : classes) std::sort(members.begin(), members.end());
+    std::sort(classes.begin(), classes.end());
+    return classes;
 }
 
-bool compareFiles(const FileInfo& file1, const FileInfo& file2) {
-    if (file1.hash.empty() || file2.hash.empty()) {
-        auto future1 = computeHashAsync(file1.path);
-        auto future2 = computeHashAsync(file2.path);
-        
-        return future1.get() == future2.get();
+void clearDigestMemo() {
+    std::lock_guard lock(memoMutex);
+    digestMemo.clear();
+}
+
+Generator<DuplicateGroup> groupByContent(std::vector<std::string> directories, GroupingOptions options) {
+    return groupRegularFiles(std::move(directories), options, {}, &pool);
+}
+
+Generator<DuplicateGroup> groupRegularFiles(std::vector<std::string> directories, GroupingOptions options,
+                                            std::function<bool(std::uint64_t)> keepSize, ThreadPool* hashPool,
+                                            std::function<bool(const std::string&)> ownsArchive) {
+    // Shared with the hash tasks, which rebuild paths and fill in digests, and
+    // may still be queued if the consumer abandons the generator early.
+    auto paths = std::make_shared<PathTable>();
+    auto files = std::make_shared<FileTable>();
+    // Set when the generator frame is destroyed, finished or abandoned;
+    // queued batches then stop before their next file instead of reading
+    // files nobody will see.
+    auto cancelled = std::make_shared<std::atomic<bool>>(false);
+    struct CancelOnExit {
+        std::shared_ptr<std::atomic<bool>> flag;
+        ~CancelOnExit() { flag->store(true, std::memory_order_relaxed); }
+    } cancelOnExit{cancelled};
+    if (options.minSize > 0) {
+        keepSize = [keepSize = std::move(keepSize), minSize = options.minSize](std::uint64_t size) {
+            return size >= minSize && (!keepSize || keepSize(size));
+        };
+    }
+    // An owner reads its archives whatever their size and keeps all their
+    // members, so only the minimum size applies to those.
+    const bool ownedArchives = options.scanArchives && ownsArchive && keepSize;
+    Progress::setWalking(true);
+    TinyFileClasses tiny;
+    for (const auto& directory : distinctRoots(directories)) {
+        collectRegularFiles(directory, keepSize, *paths, *files, ownedArchives, &tiny);
+    }
+    if (options.scanArchives) {
+        std::function<bool(std::uint64_t)> keepMember = keepSize;
+        if (ownedArchives) {
+            keepMember = [minSize = options.minSize](std::uint64_t size) { return size >= minSize; };
+        }
+        appendArchiveMembers(keepMember, ownsArchive, *paths, *files, *hashPool);
+    }
+    Progress::setWalking(false);
+
+    std::vector<RowId> rows = files->rowsBySize();
+    std::optional<ThreadPool> groupingPool;   // started by the first class large enough to need it
+    if (ownedArchives) {
+        // Archives kept only to be read.
+        std::erase_if(rows, [&](RowId row) {
+            return files->device(row) != ARCHIVE_DEVICE && !keepSize(files->fileSize(row));
+        });
+    }
+
+    auto makeInfo = [&](RowId row) {
+        const bool hashed = files->digestState(row) == DigestState::Hashed && files->fileSize(row) != 0;
+        // Archive member names carry their path inside the archive.
+        const std::string_view name = paths->name(files->path(row));
+        return FileInfo{paths->fullPath(files->path(row)), std::string(name.substr(name.rfind('/') + 1)),
+                        files->fileSize(row), hashed ? digestToHex(files->digest(row)) : std::string(),
+                        files->metadata(row)};
+    };
+
+    // A size shared by no other file cannot have a duplicate, so only rows in
+    // multi-member size classes are hashed (unless options.hashUnique asks
+    // for every digest), and rows naming the same inode are hashed once. All
+    // batches are queued up front and the classes are then resolved smallest
+    // first, so groups stream out while the pool is still working on later
+    // classes.
+    struct SizeClass {
+        std::vector<RowId> rows;     // ordered by device and inode
+        size_t batchEnd;
+    };
+    std::vector<SizeClass> classes;
+    std::vector<std::future<void>> batches;
+    for (size_t begin = 0; begin < rows.size();) {
+        size_t end = begin + 1;
+        while (end < rows.size() && files->fileSize(rows[end]) == files->fileSize(rows[begin])) ++end;
+
+        SizeClass sizeClass{std::vector<RowId>(rows.begin() + begin, rows.begin() + end), 0};
+        if (sizeClass.rows.size() > 1 || options.hashUnique) {
+            std::sort(sizeClass.rows.begin(), sizeClass.rows.end(), [&](RowId a, RowId b) {
+                return files->device(a) != files->device(b) ? files->device(a) < files->device(b)
+                                                            : files->inode(a) < files->inode(b);
+            });
+            std::vector<RowId> batch;
+            std::uint64_t batchBytes = 0;
+            auto submit = [&]() {
+                Progress::add(Progress::Counter::FilesQueued, batch.size());
+                Progress::add(Progress::Counter::BytesQueued, batchBytes);
+                batches.push_back(hashPool->enqueue([paths, files, cancelled, batch = std::move(batch)]() {
+                    for (RowId row : batch) {
+                        if (cancelled->load(std::memory_order_relaxed)) return;
+                        auto digest = digestFile(paths->fullPath(files->path(row)), files->metadata(row));
+                        if (digest) {
+                            files->setDigest(row, *digest);
+                        } else {
+                            files->setDigestFailed(row);
+                        }
+                    }
+                    Progress::add(Progress::Counter::FilesHashed, batch.size());
+                }));
+                batch.clear();
+                batchBytes = 0;
+            };
+            for (size_t i = 0; i < sizeClass.rows.size(); ++i) {
+                const RowId row = sizeClass.rows[i];
+                if (i > 0 && files->device(row) == files->device(sizeClass.rows[i - 1]) &&
+                    files->inode(row) == files->inode(sizeClass.rows[i - 1])) {
+                    continue;
+                }
+                if (files->digestState(row) == DigestState::Hashed) continue;   // tiny file or archive member
+                batch.push_back(row);
+                batchBytes += files->fileSize(row);
+                if (batch.size() == HASH_BATCH_FILES || batchBytes >= HASH_BATCH_BYTES) submit();
+            }
+            if (!batch.empty()) submit();
+        }
+        sizeClass.batchEnd = batches.size();
+        classes.push_back(std::move(sizeClass));
+        begin = end;
+    }
+
+    size_t batchesDone = 0;
+    for (auto& sizeClass : classes) {
+        if (sizeClass.rows.size() == 1 && !options.hashUnique) {
+            if (options.duplicatesOnly) continue;
+            // Archive members arrive hashed; keep unique files unhashed either way.
+            FileInfo info = makeInfo(sizeClass.rows[0]);
+            info.hash.clear();
+            DuplicateGroup group{files->fileSize(sizeClass.rows[0]), std::string(), {std::move(info)}};
+            co_yield std::move(group);
+            continue;
+        }
+        for (; batchesDone < sizeClass.batchEnd; ++batchesDone) {
+            batches[batchesDone].get();
+        }
+
+        std::vector<RowId> members;
+        for (size_t i = 0; i < sizeClass.rows.size(); ++i) {
+            const RowId row = sizeClass.rows[i];
+            const RowId previous = i > 0 ? sizeClass.rows[i - 1] : row;
+            if (row != previous && files->device(row) == files->device(previous) &&
+                files->inode(row) == files->inode(previous)) {
+                // Another name for an inode already hashed.
+                if (files->digestState(previous) == DigestState::Hashed) {
+                    files->setDigest(row, files->digest(previous));
+                } else {
+                    files->setDigestFailed(row);
+                }
+            }
+            // digestFile has recorded why.
+            if (files->digestState(row) != DigestState::Hashed) continue;
+            members.push_back(row);
+        }
+        std::sort(members.begin(), members.end());   // enumeration order within each group
+        auto memberKey = [&](size_t i) {
+            const RowId row = members[i];
+            return std::pair{GroupKey{files->fileSize(row), files->digest(row)}, row};
+        };
+        FlatGroupMap groups(members.size());
+        {
+            Metrics::Span span(Metrics::Stage::Group, "group");
+            if (members.size() >= PARALLEL_GROUPING_ROWS) {
+                // Not on hashPool: every later class's batches are already
+                // queued there, and this class would wait behind them all.
+                if (!groupingPool) groupingPool.emplace();
+                groups = FlatGroupMap::buildParallel(members.size(), memberKey, std::thread::hardware_concurrency(),
+                                                     *groupingPool);
+            } else {
+                for (size_t i = 0; i < members.size(); ++i) {
+                    auto item = memberKey(i);
+                    groups.insert(item.first, item.second);
+                }
+            }
+        }
+
+        GroupKey key{};
+        std::vector<RowId> groupRows;
+        for (size_t slot = 0; slot < groups.slotCount(); ++slot) {
+            if (!groups.readGroup(slot, key, groupRows)) continue;
+            if (options.duplicatesOnly && groupRows.size() < 2) continue;
+            DuplicateGroup group{key.size, makeInfo(groupRows.front()).hash, {}};
+            for (RowId row : groupRows) {
+                group.files.push_back(makeInfo(row));
+            }
+            co_yield std::move(group);
+        }
     }
-    return file1.hash == file2.hash;
 }
 
 } // namespace FileComparator
@@ -0,0 +1,38 @@
+#include "FileMetadata.hpp"
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+namespace FileComparator {
+
+namespace {
+    constexpr unsigned int WANTED =
+        STATX_TYPE | STATX_SIZE | STATX_INO | STATX_MTIME | STATX_NLINK | STATX_BLOCKS;
+
+    FileType typeOf(std::uint16_t mode) {
+        switch (mode & S_IFMT) {
+            case S_IFREG: return FileType::Regular;
+            case S_IFDIR: return FileType::Directory;
+            case S_IFLNK: return FileType::Symlink;
+            default: return FileType::Other;
+        }
+    }
+}
+
+int readMetadata(int directoryFd, const char* name, FileMetadata& metadata) {
+    struct statx info;
+    if (::statx(directoryFd, name, AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT, WANTED, &info) != 0) return errno;
+    metadata.type = typeOf(info.stx_mode);
+    metadata.size = info.stx_size;
+    metadata.device = makedev(info.stx_dev_major, info.stx_dev_minor);
+    metadata.inode = info.stx_ino;
+    metadata.mtime = static_cast<std::int64_t>(info.stx_mtime.tv_sec) * 1000000000 + info.stx_mtime.tv_nsec;
+    metadata.links = info.stx_nlink;
+    // Filesystems that cannot tell leave blocks out of the mask; treat such
+    // files as dense rather than as all hole.
+    metadata.blocks = (info.stx_mask & STATX_BLOCKS) ? info.stx_blocks : (metadata.size + 511) / 512;
+    return 0;
+}
+
+} // namespace FileComparator
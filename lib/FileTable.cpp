@@ -0,0 +1,69 @@
+#include "FileTable.hpp"
+#include <array>
+#include <numeric>
+
+namespace FileComparator {
+
+RowId FileTable::append(PathId path, std::uint64_t size, std::uint64_t device, std::uint64_t inode,
+                        std::int64_t mtime, std::uint64_t links, std::uint64_t blocks) {
+    sizes.push_back(size);
+    devices.push_back(device);
+    inodes.push_back(inode);
+    mtimes.push_back(mtime);
+    linkCounts.push_back(links);
+    blockCounts.push_back(blocks);
+    digests.push_back(0);
+    states.push_back(DigestState::Pending);
+    paths.push_back(path);
+    return static_cast<RowId>(sizes.size() - 1);
+}
+
+std::vector<RowId> FileTable::rowsBySize() const {
+    std::vector<RowId> rows(size());
+    std::iota(rows.begin(), rows.end(), RowId{0});
+    radixSortRows(rows, sizes);
+    return rows;
+}
+
+void radixSortRows(std::vector<RowId>& rows, const std::vector<std::uint64_t>& column) {
+    struct Item {
+        std::uint64_t key;
+        RowId row;
+    };
+    const std::size_t count = rows.size();
+    if (count < 2) return;
+
+    std::vector<Item> items(count);
+    std::vector<Item> scratch(count);
+    std::array<std::array<std::size_t, 256>, 8> histograms{};
+    for (std::size_t i = 0; i < count; ++i) {
+        const std::uint64_t key = column[rows[i]];
+        items[i] = Item{key, rows[i]};
+        for (int pass = 0; pass < 8; ++pass) {
+            ++histograms[pass][(key >> (pass * 8)) & 0xFF];
+        }
+    }
+
+    for (int pass = 0; pass < 8; ++pass) {
+        auto& histogram = histograms[pass];
+        const int shift = pass * 8;
+        if (histogram[(items[0].key >> shift) & 0xFF] == count) continue;
+
+        std::size_t offset = 0;
+        for (auto& bucket : histogram) {
+            const std::size_t bucketSize = bucket;
+            bucket = offset;
+            offset += bucketSize;
+        }
+        for (const Item& item : items) {
+            scratch[histogram[(item.key >> shift) & 0xFF]++] = item;
+        }
+        items.swap(scratch);
+    }
+
+    for (std::size_t i = 0; i < count; ++i) {
+        rows[i] = items[i].row;
+    }
+}
+
+} // namespace FileComparator
@@ -0,0 +1,87 @@
+#include "FlatGroupMap.hpp"
+#include <bit>
+
+namespace FileComparator {
+
+FlatGroupMap::FlatGroupMap(std::size_t expectedKeys) {
+    // Keep the load factor at or below one half.
+    slots.resize(std::bit_ceil(std::max<std::size_t>(16, expectedKeys * 2)));
+}
+
+std::size_t FlatGroupMap::hashKey(const GroupKey& key) {
+    // splitmix64 finaliser over both halves; FNV digests are poorly mixed.
+    std::uint64_t x = key.digest ^ (key.size * 0x9E3779B97F4A7C15ULL);
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return static_cast<std::size_t>(x ^ (x >> 31));
+}
+
+FlatGroupMap::Slot& FlatGroupMap::findSlot(const GroupKey& key) {
+    const std::size_t mask = slots.size() - 1;
+    for (std::size_t index = hashKey(key) & mask;; index = (index + 1) & mask) {
+        Slot& slot = slots[index];
+        if (slot.count == 0 || slot.key == key) return slot;
+    }
+}
+
+void FlatGroupMap::append(Slot& slot, RowId member) {
+    if (slot.count++ == 0) {
+        slot.first = member;
+        slot.overflowHead = NO_LINK;
+        slot.overflowTail = NO_LINK;
+        ++used;
+    } else {
+        const auto link = static_cast<std::uint32_t>(overflow.size());
+        overflow.push_back(Link{member, NO_LINK});
+        if (slot.overflowTail == NO_LINK) {
+            slot.overflowHead = link;
+        } else {
+            overflow[slot.overflowTail].next = link;
+        }
+        slot.overflowTail = link;
+    }
+    ++members;
+}
+
+void FlatGroupMap::insert(const GroupKey& key, RowId member) {
+    if ((used + 1) * 2 > slots.size()) grow();
+    Slot& slot = findSlot(key);
+    slot.key = key;
+    append(slot, member);
+}
+
+void FlatGroupMap::merge(const FlatGroupMap& other) {
+    for (const Slot& theirs : other.slots) {
+        if (theirs.count == 0) continue;
+        if ((used + 1) * 2 > slots.size()) grow();
+        Slot& ours = findSlot(theirs.key);
+        ours.key = theirs.key;
+        append(ours, theirs.first);
+        for (std::uint32_t link = theirs.overflowHead; link != NO_LINK; link = other.overflow[link].next) {
+            append(ours, other.overflow[link].member);
+        }
+    }
+}
+
+bool FlatGroupMap::readGroup(std::size_t slot, GroupKey& key, std::vector<RowId>& rows) const {
+    const Slot& entry = slots[slot];
+    if (entry.count == 0) return false;
+    key = entry.key;
+    rows.clear();
+    rows.push_back(entry.first);
+    for (std::uint32_t link = entry.overflowHead; link != NO_LINK; link = overflow[link].next) {
+        rows.push_back(overflow[link].member);
+    }
+    return true;
+}
+
+void FlatGroupMap::grow() {
+    std::vector<Slot> previous(slots.size() * 2);
+    previous.swap(slots);
+    // Chains live in the overflow array and move with their slot untouched.
+    for (const Slot& slot : previous) {
+        if (slot.count != 0) findSlot(slot.key) = slot;
+    }
+}
+
+} // namespace FileComparator
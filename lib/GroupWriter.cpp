@@ -0,0 +1,232 @@
+#include "GroupWriter.hpp"
+#include "JsonString.hpp"
+#include <charconv>
+
+namespace FileComparator {
+
+std::optional<OutputFormat> parseOutputFormat(const std::string& name) {
+    if (name == "text") return OutputFormat::Text;
+    if (name == "ndjson") return OutputFormat::Ndjson;
+    if (name == "csv") return OutputFormat::Csv;
+    return std::nullopt;
+}
+
+BufferedWriter::BufferedWriter(std::ostream& out, size_t capacity)
+    : out(out), capacity(capacity) {
+    buffer.reserve(capacity + capacity / 4);
+}
+
+BufferedWriter::~BufferedWriter() {
+    flush();
+}
+
+void BufferedWriter::writeNumber(unsigned long long value) {
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    buffer.append(digits, result.ptr);
+}
+
+void BufferedWriter::endRecord() {
+    if (buffer.size() >= capacity) {
+        flush();
+    }
+}
+
+void BufferedWriter::flush() {
+    if (!buffer.empty()) {
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        buffer.clear();
+    }
+    out.flush();
+}
+
+GroupWriter::GroupWriter(std::ostream& out, OutputFormat format)
+    : writer(out), format(format) {}
+
+void GroupWriter::writeDuplicate(const DuplicateGroup& group) {
+    if (format == OutputFormat::Text) {
+        writer.write("Duplicate content (");
+        writer.writeNumber(group.size);
+        writer.write(" bytes) found in locations:\n");
+        for (const auto& file : group.files) {
+            writer.write("  ");
+            writer.write(file.path);
+            writer.put('\n');
+        }
+        writer.endRecord();
+        return;
+    }
+    writeRecord("duplicate", group.size, group.hash, group.files);
+}
+
+void GroupWriter::writeUnique(const FileInfo& file) {
+    if (format == OutputFormat::Text) {
+        writer.write("Unique file: ");
+        writer.write(file.path);
+        writer.put('\n');
+        writer.endRecord();
+        return;
+    }
+    writeRecord("unique", file.size, file.hash, {file});
+}
+
+void GroupWriter::writeDifferent(const std::string& name, const std::vector<FileInfo>& files) {
+    if (format == OutputFormat::Text) {
+        writer.write("Different content for file: ");
+        writer.write(name);
+        writer.write(" found in locations:\n");
+        for (const auto& file : files) {
+            writer.write("  ");
+            writer.write(file.path);
+            writer.put('\n');
+        }
+        writer.endRecord();
+        return;
+    }
+    writeRecord("different", std::nullopt, std::string_view(), files);
+}
+
+void GroupWriter::writeDiff(const DiffEntry& entry) {
+    switch (format) {
+        case OutputFormat::Text:
+            switch (entry.status) {
+                case DiffStatus::OnlyLeft: writer.write("Only in left: "); break;
+                case DiffStatus::OnlyRight: writer.write("Only in right: "); break;
+                case DiffStatus::Same: writer.write("Same: "); break;
+                case DiffStatus::Different: writer.write("Different: "); break;
+            }
+            writer.write(entry.path);
+            break;
+        case OutputFormat::Ndjson:
+            writer.write("{\"kind\":\"");
+            writer.write(toString(entry.status));
+            writer.write("\",\"path\":");
+            writeJsonString(entry.path);
+            writer.put('}');
+            break;
+        case OutputFormat::Csv:
+            writer.write(toString(entry.status));
+            writer.put(',');
+            writeCsvField(entry.path);
+            break;
+    }
+    writer.put('\n');
+    writer.endRecord();
+}
+
+void GroupWriter::writeCross(const CrossGroup& group, const std::vector<std::string>& sources) {
+    switch (format) {
+        case OutputFormat::Text:
+            switch (group.status) {
+                case CrossStatus::Missing: writer.write("Content missing from some manifests ("); break;
+                case CrossStatus::Moved: writer.write("Content moved ("); break;
+                case CrossStatus::Shared: writer.write("Content shared by all manifests ("); break;
+            }
+            writer.writeNumber(group.size);
+            writer.write(" bytes):\n");
+            for (const auto& file : group.files) {
+                writer.write("  ");
+                writer.write(sources[file.manifest]);
+                writer.write(": ");
+                writer.write(file.path);
+                writer.put('\n');
+            }
+            break;
+        case OutputFormat::Ndjson:
+            writer.write("{\"kind\":\"");
+            writer.write(toString(group.status));
+            writer.write("\",\"size\":");
+            writer.writeNumber(group.size);
+            if (!group.hash.empty()) {
+                writer.write(",\"hash\":");
+                writeJsonString(group.hash);
+            }
+            writer.write(",\"files\":[");
+            for (size_t i = 0; i < group.files.size(); ++i) {
+                if (i) writer.put(',');
+                writer.write("{\"source\":");
+                writeJsonString(sources[group.files[i].manifest]);
+                writer.write(",\"path\":");
+                writeJsonString(group.files[i].path);
+                writer.put('}');
+            }
+            writer.write("]}\n");
+            break;
+        case OutputFormat::Csv:
+            writer.write(toString(group.status));
+            writer.put(',');
+            writer.writeNumber(group.size);
+            writer.put(',');
+            writer.write(group.hash);
+            for (const auto& file : group.files) {
+                writer.put(',');
+                writeCsvField(sources[file.manifest]);
+                writer.put(',');
+                writeCsvField(file.path);
+            }
+            writer.put('\n');
+            break;
+    }
+    writer.endRecord();
+}
+
+void GroupWriter::writeNote(std::string_view text) {
+    if (format != OutputFormat::Text) return;
+    writer.write(text);
+    writer.put('\n');
+    writer.endRecord();
+}
+
+void GroupWriter::writeRecord(std::string_view kind, std::optional<std::size_t> size, std::string_view hash,
+                              const std::vector<FileInfo>& files) {
+    if (format == OutputFormat::Ndjson) {
+        writer.write("{\"kind\":\"");
+        writer.write(kind);
+        writer.put('"');
+        if (size) {
+            writer.write(",\"size\":");
+            writer.writeNumber(*size);
+        }
+        if (!hash.empty()) {
+            writer.write(",\"hash\":");
+            writeJsonString(hash);
+        }
+        writer.write(",\"files\":[");
+        for (size_t i = 0; i < files.size(); ++i) {
+            if (i) writer.put(',');
+            writeJsonString(files[i].path);
+        }
+        writer.write("]}\n");
+    } else {
+        writer.write(kind);
+        writer.put(',');
+        if (size) writer.writeNumber(*size);
+        writer.put(',');
+        writer.write(hash);
+        for (const auto& file : files) {
+            writer.put(',');
+            writeCsvField(file.path);
+        }
+        writer.put('\n');
+    }
+    writer.endRecord();
+}
+
+void GroupWriter::writeJsonString(std::string_view text) {
+    FileComparator::writeJsonString(text, [this](std::string_view piece) { writer.write(piece); });
+}
+
+void GroupWriter::writeCsvField(std::string_view text) {
+    if (text.find_first_of(",\"\r\n") == std::string_view::npos) {
+        writer.write(text);
+        return;
+    }
+    writer.put('"');
+    for (char c : text) {
+        if (c == '"') writer.put('"');
+        writer.put(c);
+    }
+    writer.put('"');
+}
+
+} // namespace FileComparator
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "FileComparator.hpp"
+#include "FileTable.hpp"
+#include "PathTable.hpp"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace FileComparator {
+
+// The first file of each size up to TINY_FILE_BYTES that the walks have
+// kept. Once a second file of that size turns up, both are hashed on the
+// walk thread, so a tiny file whose size no other file shares is not read.
+struct TinyFileClasses {
+    static constexpr RowId NONE = UINT32_MAX;
+    static constexpr RowId HASHED = UINT32_MAX - 1;   // the first has been hashed
+    std::vector<RowId> first = std::vector<RowId>(TINY_FILE_BYTES + 1, NONE);
+};
+
+// Walks directory into paths and files, dropping files whose size fails
+// keepSize (an empty keepSize keeps every file) unless keepArchives is set
+// and they are archives. With tiny, kept tiny files sharing a size are
+// hashed as they are found; a failure leaves them pending.
+void collectRegularFiles(const std::string& directory, const std::function<bool(std::uint64_t)>& keepSize,
+                         PathTable& paths, FileTable& files, bool keepArchives = false,
+                         TinyFileClasses* tiny = nullptr);
+
+// The engine behind groupByContent. Files whose size fails keepSize are
+// dropped as they are scanned (an empty keepSize keeps every file). Tiny
+// files are hashed by the walk, the rest on hashPool, which must outlive the
+// generator. Very large classes are grouped in parallel on a pool of the
+// generator's own. With options.scanArchives and an ownsArchive, only the
+// archives it accepts are read, and every member of those is kept whatever
+// its size; an archive failing keepSize is read but not listed itself.
+Generator<DuplicateGroup> groupRegularFiles(std::vector<std::string> directories, GroupingOptions options,
+                                            std::function<bool(std::uint64_t)> keepSize, ThreadPool* hashPool,
+                                            std::function<bool(const std::string&)> ownsArchive = {});
+
+} // namespace FileComparator
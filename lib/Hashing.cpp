@@ -0,0 +1,213 @@
+#include "Hashing.hpp"
+#include "Errors.hpp"
+#include "Metrics.hpp"
+#include "Progress.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace FileComparator {
+
+namespace {
+    constexpr std::size_t READ_CHUNK = 256 * 1024;
+
+    // Start of a read for the metrics; 0 while they are off.
+    std::uint64_t readClock() {
+        return Metrics::enabled() ? Metrics::now() : 0;
+    }
+
+    // Folds count freshly read bytes into hash, charging the read begun at
+    // readStart and the hashing to their stages when metrics are on. Bytes
+    // are reported to Progress per chunk, so one huge file still shows
+    // movement.
+    void consume(Fnv1a& hash, const char* data, std::size_t count, std::uint64_t readStart) {
+        Progress::add(Progress::Counter::BytesHashed, count);
+        if (readStart == 0) {
+            hash.update(data, count);
+            return;
+        }
+        const std::uint64_t hashStart = Metrics::now();
+        Metrics::add(Metrics::Stage::Read, hashStart - readStart);
+        Metrics::count(Metrics::Counter::BytesRead, count);
+        hash.update(data, count);
+        Metrics::add(Metrics::Stage::Hash, Metrics::now() - hashStart);
+    }
+
+    // Counts a hashed file and traces it as one event.
+    struct FileProbe {
+        std::uint64_t start = readClock();
+        ~FileProbe() {
+            if (start == 0) return;
+            Metrics::count(Metrics::Counter::FilesHashed);
+            Metrics::trace("digestFile", Metrics::Stage::Hash, start, Metrics::now());
+        }
+    };
+
+    // Hashes [offset, end) with pread; false on a read error. A file that
+    // shrinks underneath simply ends early.
+    bool hashRange(int fd, off_t offset, off_t end, std::string& buffer, Fnv1a& hash) {
+        while (offset < end) {
+            const auto want = static_cast<std::size_t>(std::min<off_t>(end - offset, static_cast<off_t>(buffer.size())));
+            const std::uint64_t started = readClock();
+            ssize_t count = ::pread(fd, buffer.data(), want, offset);
+            if (count < 0 && errno == EINTR) continue;
+            if (count < 0) return false;
+            if (count == 0) break;
+            consume(hash, buffer.data(), static_cast<std::size_t>(count), started);
+            offset += count;
+        }
+        return true;
+    }
+
+    // Walks the data extents of a sparse file; holes count as zero runs.
+    // Falls back to plain reads where the filesystem lacks SEEK_DATA.
+    bool hashSparse(int fd, off_t size, std::string& buffer, Fnv1a& hash) {
+        off_t offset = 0;
+        while (offset < size) {
+            off_t data = ::lseek(fd, offset, SEEK_DATA);
+            if (data < 0 && errno == ENXIO) data = size;   // nothing but hole to the end
+            if (data < 0) return hashRange(fd, offset, size, buffer, hash);
+            data = std::min(data, size);
+            hash.updateZeros(static_cast<std::uint64_t>(data - offset));
+            Progress::add(Progress::Counter::BytesHashed, static_cast<std::uint64_t>(data - offset));
+            if (data == size) break;
+
+            off_t hole = ::lseek(fd, data, SEEK_HOLE);
+            if (hole < 0) return hashRange(fd, data, size, buffer, hash);
+            hole = std::min(hole, size);
+            if (!hashRange(fd, data, hole, buffer, hash)) return false;
+            offset = hole;
+        }
+        return true;
+    }
+
+    // Digest of the file open on fd, which it closes; sparse says whether to
+    // walk its extents.
+    std::optional<Digest> digestOpenFile(int fd, const std::string& path, bool sparse, off_t size) {
+        thread_local std::string buffer(READ_CHUNK, '\0');
+        Fnv1a hash;
+        if (sparse) {
+            const bool ok = hashSparse(fd, size, buffer, hash);
+            if (!ok) Errors::record(Errors::Operation::Read, errno, path);
+            ::close(fd);
+            return ok ? std::optional<Digest>(hash.value()) : std::nullopt;
+        }
+        while (true) {
+            const std::uint64_t started = readClock();
+            ssize_t count = ::read(fd, buffer.data(), buffer.size());
+            if (count < 0 && errno == EINTR) continue;
+            if (count < 0) {
+                Errors::record(Errors::Operation::Read, errno, path);
+                ::close(fd);
+                return std::nullopt;
+            }
+            if (count == 0) break;
+            consume(hash, buffer.data(), static_cast<std::size_t>(count), started);
+        }
+        ::close(fd);
+        return hash.value();
+    }
+
+    int openForDigest(const std::string& path) {
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) Errors::record(Errors::Operation::Open, errno, path);
+        return fd;
+    }
+}
+
+Digest calculateDigest(const char* data, std::size_t size) {
+    Fnv1a hash;
+    hash.update(data, size);
+    return hash.value();
+}
+
+std::string digestToHex(Digest digest) {
+    static constexpr char HEX[] = "0123456789abcdef";
+    std::string hex(16, '0');
+    for (int i = 15; i >= 0; --i) {
+        hex[static_cast<size_t>(i)] = HEX[digest & 0xF];
+        digest >>= 4;
+    }
+    return hex;
+}
+
+std::optional<Digest> digestFromHex(const std::string& hex) {
+    Digest digest = 0;
+    auto result = std::from_chars(hex.data(), hex.data() + hex.size(), digest, 16);
+    if (result.ec != std::errc() || result.ptr != hex.data() + hex.size()) return std::nullopt;
+    return digest;
+}
+
+std::optional<Digest> digestFile(const std::string& path) {
+    FileProbe probe;
+    const int fd = openForDigest(path);
+    if (fd < 0) return std::nullopt;
+    struct stat info;
+    const bool sparse = ::fstat(fd, &info) == 0 && S_ISREG(info.st_mode) &&
+                        static_cast<off_t>(info.st_blocks) * 512 < info.st_size;
+    return digestOpenFile(fd, path, sparse, sparse ? info.st_size : 0);
+}
+
+std::optional<Digest> digestFile(const std::string& path, const FileMetadata& metadata) {
+    FileProbe probe;
+    const int fd = openForDigest(path);
+    if (fd < 0) return std::nullopt;
+    // The extent walk stops at the size the scan saw; a file grown since is
+    // hashed as far as that, like one that grows while being read.
+    return digestOpenFile(fd, path, metadata.sparse(), static_cast<off_t>(metadata.size));
+}
+
+std::optional<Digest> digestTinyFile(int directoryFd, const char* name, std::uint64_t size) {
+    FileProbe probe;
+    const std::uint64_t started = readClock();
+    const int fd = ::openat(directoryFd, name, O_RDONLY | O_CLOEXEC | O_NOCTTY);
+    if (fd < 0) return std::nullopt;
+
+    // One byte of slack tells a file that has grown apart from one that
+    // exactly fills the buffer.
+    char buffer[TINY_FILE_BYTES + 1];
+    std::size_t filled = 0;
+    while (filled < sizeof(buffer)) {
+        const ssize_t count = ::read(fd, buffer + filled, sizeof(buffer) - filled);
+        if (count < 0 && errno == EINTR) continue;
+        if (count < 0) {
+            ::close(fd);
+            return std::nullopt;
+        }
+        if (count == 0) break;
+        filled += static_cast<std::size_t>(count);
+    }
+    ::close(fd);
+    if (filled != size || filled > TINY_FILE_BYTES) return std::nullopt;
+    Fnv1a hash;
+    consume(hash, buffer, filled, started);
+    return hash.value();
+}
+
+std::optional<Digest> digestFileHead(const std::string& path) {
+    const std::uint64_t started = readClock();
+    const int fd = openForDigest(path);
+    if (fd < 0) return std::nullopt;
+    char buffer[HEAD_DIGEST_BYTES];
+    std::size_t filled = 0;
+    while (filled < sizeof(buffer)) {
+        ssize_t count = ::pread(fd, buffer + filled, sizeof(buffer) - filled, static_cast<off_t>(filled));
+        if (count < 0 && errno == EINTR) continue;
+        if (count < 0) {
+            Errors::record(Errors::Operation::Read, errno, path);
+            ::close(fd);
+            return std::nullopt;
+        }
+        if (count == 0) break;
+        filled += static_cast<std::size_t>(count);
+    }
+    ::close(fd);
+    Fnv1a hash;
+    consume(hash, buffer, filled, started);
+    return hash.value();
+}
+
+} // namespace FileComparator
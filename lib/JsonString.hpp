@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+namespace FileComparator {
+
+// Writes text as a quoted JSON string, handing it to emit(std::string_view)
+// as runs of plain bytes and escapes. Bytes of 0x80 and up pass through, so
+// UTF-8 stays as it is.
+template<typename Emit>
+void writeJsonString(std::string_view text, Emit&& emit) {
+    static constexpr char HEX[] = "0123456789abcdef";
+    emit(std::string_view("\""));
+    std::size_t run = 0;
+    for (std::size_t i = 0; i < text.size(); ++i) {
+        const auto c = static_cast<unsigned char>(text[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        if (i > run) emit(text.substr(run, i - run));
+        run = i + 1;
+        switch (c) {
+            case '"': emit(std::string_view("\\\"")); break;
+            case '\\': emit(std::string_view("\\\\")); break;
+            case '\n': emit(std::string_view("\\n")); break;
+            case '\r': emit(std::string_view("\\r")); break;
+            case '\t': emit(std::string_view("\\t")); break;
+            default: {
+                const char code[] = {'\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 0xF]};
+                emit(std::string_view(code, sizeof(code)));
+            }
+        }
+    }
+    if (run < text.size()) emit(text.substr(run));
+    emit(std::string_view("\""));
+}
+
+} // namespace FileComparator
@@ -0,0 +1,495 @@
+#include "LookupService.hpp"
+#include "FileTable.hpp"
+#include "Manifest.hpp"
+#include "ReferenceIndex.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <numeric>
+#include <thread>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace FileComparator {
+
+namespace {
+    constexpr std::size_t HEADER_SIZE = 5;
+    // Larger requests are treated as corruption rather than buffered.
+    constexpr std::uint32_t MAX_REQUEST = 1u << 26;
+    // A client that stops reading is not read from either until it catches up.
+    constexpr std::size_t MAX_PENDING_OUTPUT = 1u << 20;
+    constexpr std::size_t READ_CHUNK = 64 * 1024;
+    // Bytes on the wake pipe.
+    constexpr char WAKE_STOP = 0;
+    constexpr char WAKE_RELOADED = 1;
+    constexpr char MANIFEST_MAGIC[8] = {'F', 'S', '2', 'M', 'A', 'N', 'I', 'F'};
+    constexpr char REFERENCE_MAGIC[8] = {'F', 'S', '2', 'R', 'E', 'F', 'I', 'X'};
+
+    template<typename T>
+    void putLittle(std::string& out, T value) {
+        for (std::size_t i = 0; i < sizeof(T); ++i) {
+            out.push_back(static_cast<char>(static_cast<std::uint64_t>(value) >> (8 * i)));
+        }
+    }
+
+    template<typename T>
+    T getLittle(const char* data) {
+        std::uint64_t value = 0;
+        for (std::size_t i = 0; i < sizeof(T); ++i) {
+            value |= static_cast<std::uint64_t>(static_cast<unsigned char>(data[i])) << (8 * i);
+        }
+        return static_cast<T>(value);
+    }
+
+    void putFrame(std::string& out, LookupRequest type, const std::string& payload) {
+        out.push_back(static_cast<char>(type));
+        putLittle<std::uint32_t>(out, static_cast<std::uint32_t>(payload.size()));
+        out.append(payload);
+    }
+
+    // Bounds-checked reader over a response payload.
+    class ResponseReader {
+    public:
+        explicit ResponseReader(const std::string& payload) : payload(payload) {}
+
+        template<typename T>
+        T get() {
+            require(sizeof(T));
+            const T value = getLittle<T>(payload.data() + offset);
+            offset += sizeof(T);
+            return value;
+        }
+
+        std::string getString(std::size_t length) {
+            require(length);
+            std::string value(payload.data() + offset, length);
+            offset += length;
+            return value;
+        }
+
+        bool done() const { return offset == payload.size(); }
+
+    private:
+        void require(std::size_t bytes) const {
+            if (payload.size() - offset < bytes) throw LookupError("truncated lookup response");
+        }
+
+        const std::string& payload;
+        std::size_t offset = 0;
+    };
+
+    std::string socketError(const std::string& what, const std::string& path) {
+        return what + " " + path + ": " + std::strerror(errno);
+    }
+
+    bool fillAddress(const std::string& path, sockaddr_un& address) {
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) return false;
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        return true;
+    }
+
+    bool sendAll(int fd, const char* data, std::size_t size) {
+        while (size > 0) {
+            const ssize_t n = ::send(fd, data, size, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) return false;
+            data += n;
+            size -= static_cast<std::size_t>(n);
+        }
+        return true;
+    }
+
+    bool receiveAll(int fd, char* data, std::size_t size) {
+        while (size > 0) {
+            const ssize_t n = ::recv(fd, data, size, 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            data += n;
+            size -= static_cast<std::size_t>(n);
+        }
+        return true;
+    }
+}
+
+void LookupTable::add(Digest digest, std::string_view path) {
+    digests.push_back(digest);
+    strings.append(path);
+    pathOffsets.push_back(strings.size());
+}
+
+void LookupTable::sort() {
+    std::vector<RowId> order(digests.size());
+    std::iota(order.begin(), order.end(), RowId{0});
+    radixSortRows(order, digests);
+
+    std::vector<Digest> sortedDigests;
+    std::vector<std::uint64_t> sortedOffsets{0};
+    std::string sortedStrings;
+    sortedDigests.reserve(digests.size());
+    sortedOffsets.reserve(pathOffsets.size());
+    sortedStrings.reserve(strings.size());
+    for (RowId row : order) {
+        sortedDigests.push_back(digests[row]);
+        sortedStrings.append(strings, pathOffsets[row], pathOffsets[row + 1] - pathOffsets[row]);
+        sortedOffsets.push_back(sortedStrings.size());
+    }
+    digests = std::move(sortedDigests);
+    pathOffsets = std::move(sortedOffsets);
+    strings = std::move(sortedStrings);
+}
+
+std::shared_ptr<const LookupTable> LookupTable::load(const std::string& path) {
+    char magic[8] = {};
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) throw LookupError("Cannot open " + path + ": " + std::strerror(errno));
+        in.read(magic, sizeof(magic));
+    }
+
+    auto table = std::make_shared<LookupTable>();
+    try {
+        if (std::memcmp(magic, MANIFEST_MAGIC, sizeof(magic)) == 0) {
+            const Manifest manifest(path);
+            for (RowId row = 0; row < manifest.fileCount(); ++row) {
+                // A file alone in its size class was never hashed.
+                if (manifest.hashed(row)) table->add(manifest.digest(row), manifest.path(row));
+            }
+        } else if (std::memcmp(magic, REFERENCE_MAGIC, sizeof(magic)) == 0) {
+            const ReferenceIndex index(path);
+            for (std::uint64_t entry = 0; entry < index.size(); ++entry) {
+                table->add(index.entryDigest(entry), index.entryPath(entry));
+            }
+        } else {
+            throw LookupError("Not a manifest or reference index: " + path);
+        }
+    } catch (const ManifestError& e) {
+        throw LookupError(e.what());
+    } catch (const ReferenceIndexError& e) {
+        throw LookupError(e.what());
+    }
+    table->sort();
+    return table;
+}
+
+bool LookupTable::contains(Digest digest) const {
+    return std::binary_search(digests.begin(), digests.end(), digest);
+}
+
+std::vector<std::string_view> LookupTable::paths(Digest digest) const {
+    std::vector<std::string_view> result;
+    const auto [first, last] = std::equal_range(digests.begin(), digests.end(), digest);
+    for (auto it = first; it != last; ++it) {
+        const auto i = static_cast<std::size_t>(it - digests.begin());
+        result.emplace_back(strings.data() + pathOffsets[i], pathOffsets[i + 1] - pathOffsets[i]);
+    }
+    return result;
+}
+
+struct LookupServer::Connection {
+    explicit Connection(int fd) : fd(fd) {}
+    ~Connection() { ::close(fd); }
+
+    int fd;
+    std::string in;
+    std::string out;
+    std::size_t written = 0;
+    bool closed = false;
+};
+
+LookupServer::LookupServer(std::string dataPath, std::string socketPath, LookupServerOptions options)
+    : dataPath(std::move(dataPath)), socketPath(std::move(socketPath)), options(options) {
+    const auto current = identifyData();
+    if (!current) throw LookupError(socketError("Cannot open", this->dataPath));
+    loaded = *current;
+    table = LookupTable::load(this->dataPath);
+    loadCount.fetch_add(1, std::memory_order_relaxed);
+
+    // The destructor does not run if the constructor throws.
+    auto fail = [&](const std::string& reason) {
+        if (listener >= 0) ::close(listener);
+        if (wakeRead >= 0) ::close(wakeRead);
+        if (wakeWrite >= 0) ::close(wakeWrite);
+        throw LookupError(reason);
+    };
+
+    int wake[2];
+    if (::pipe2(wake, O_CLOEXEC | O_NONBLOCK) != 0) fail(std::string("Cannot create pipe: ") + std::strerror(errno));
+    wakeRead = wake[0];
+    wakeWrite = wake[1];
+
+    sockaddr_un address;
+    if (!fillAddress(this->socketPath, address)) fail("Socket path too long: " + this->socketPath);
+    listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (listener < 0) fail(socketError("Cannot create socket for", this->socketPath));
+
+    // A socket left by a server that died is replaced; a live one is not.
+    struct stat info;
+    if (::lstat(this->socketPath.c_str(), &info) == 0) {
+        if (!S_ISSOCK(info.st_mode)) fail("Not a socket: " + this->socketPath);
+        const int probe = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        const bool live = probe >= 0 &&
+                          ::connect(probe, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+        if (probe >= 0) ::close(probe);
+        if (live) fail("Already serving on " + this->socketPath);
+        ::unlink(this->socketPath.c_str());
+    }
+    if (::bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        fail(socketError("Cannot bind", this->socketPath));
+    }
+    if (::listen(listener, SOMAXCONN) != 0) fail(socketError("Cannot listen on", this->socketPath));
+}
+
+LookupServer::~LookupServer() {
+    // The reloader writes to the wake pipe when it is done.
+    if (reloader.joinable()) reloader.join();
+    ::close(listener);
+    ::close(wakeRead);
+    ::close(wakeWrite);
+    ::unlink(socketPath.c_str());
+}
+
+void LookupServer::stop() {
+    [[maybe_unused]] const ssize_t n = ::write(wakeWrite, &WAKE_STOP, 1);
+}
+
+std::optional<LookupServer::FileIdentity> LookupServer::identifyData() const {
+    struct stat info;
+    if (::stat(dataPath.c_str(), &info) != 0) return std::nullopt;
+    return FileIdentity{static_cast<std::uint64_t>(info.st_dev), static_cast<std::uint64_t>(info.st_ino),
+                        static_cast<std::uint64_t>(info.st_size),
+                        static_cast<std::int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec};
+}
+
+void LookupServer::startReloadIfChanged() {
+    if (reloading.valid()) return;   // one load at a time
+    // Between unlink and rename there may briefly be no file; keep serving.
+    const auto current = identifyData();
+    if (!current || *current == loaded) return;
+    // A file that fails to load is not retried until it changes again.
+    loaded = *current;
+    if (reloader.joinable()) reloader.join();
+    std::packaged_task<std::shared_ptr<const LookupTable>()> load([path = dataPath] {
+        return LookupTable::load(path);
+    });
+    reloading = load.get_future();
+    // The result is set before the wake byte is written, so the serving
+    // thread always finds it ready.
+    reloader = std::thread([this, load = std::move(load)]() mutable {
+        load();
+        [[maybe_unused]] const ssize_t n = ::write(wakeWrite, &WAKE_RELOADED, 1);
+    });
+}
+
+void LookupServer::finishReload() {
+    if (!reloading.valid() || reloading.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return;
+    try {
+        table = reloading.get();
+        loadCount.fetch_add(1, std::memory_order_relaxed);
+    } catch (const std::exception& e) {
+        // Anything the load threw, a short allocation included, leaves the
+        // old table in service.
+        std::cerr << e.what() << "; still serving the previous version." << std::endl;
+    }
+}
+
+bool LookupServer::handle(Connection& connection) {
+    std::size_t position = 0;
+    const std::string& in = connection.in;
+    while (in.size() - position >= HEADER_SIZE) {
+        const auto type = static_cast<LookupRequest>(static_cast<unsigned char>(in[position]));
+        const auto length = getLittle<std::uint32_t>(in.data() + position + 1);
+        if (length > MAX_REQUEST) return false;
+        if (in.size() - position - HEADER_SIZE < length) break;
+
+        const char* payload = in.data() + position + HEADER_SIZE;
+        if (length < 4) return false;
+        const auto count = getLittle<std::uint32_t>(payload);
+        if (length != 4 + std::uint64_t{8} * count) return false;
+        const char* digests = payload + 4;
+
+        std::string response;
+        putLittle<std::uint32_t>(response, count);
+        switch (type) {
+            case LookupRequest::Contains: {
+                std::string bitmap((count + 7) / 8, '\0');
+                for (std::uint32_t i = 0; i < count; ++i) {
+                    if (table->contains(getLittle<std::uint64_t>(digests + 8 * i))) {
+                        bitmap[i / 8] = static_cast<char>(bitmap[i / 8] | (1 << (i % 8)));
+                    }
+                }
+                response.append(bitmap);
+                break;
+            }
+            case LookupRequest::Paths:
+                for (std::uint32_t i = 0; i < count; ++i) {
+                    const auto paths = table->paths(getLittle<std::uint64_t>(digests + 8 * i));
+                    putLittle<std::uint32_t>(response, static_cast<std::uint32_t>(paths.size()));
+                    for (const auto path : paths) {
+                        putLittle<std::uint32_t>(response, static_cast<std::uint32_t>(path.size()));
+                        response.append(path);
+                    }
+                }
+                break;
+            default:
+                return false;
+        }
+        putFrame(connection.out, type, response);
+        position += HEADER_SIZE + length;
+    }
+    connection.in.erase(0, position);
+    return true;
+}
+
+void LookupServer::run() {
+    std::vector<std::unique_ptr<Connection>> connections;
+    std::vector<pollfd> fds;
+    auto nextCheck = std::chrono::steady_clock::now() + options.reloadInterval;
+    char chunk[READ_CHUNK];
+
+    while (true) {
+        fds.assign({pollfd{wakeRead, POLLIN, 0}, pollfd{listener, POLLIN, 0}});
+        for (const auto& connection : connections) {
+            short events = 0;
+            if (connection->out.size() - connection->written < MAX_PENDING_OUTPUT) events |= POLLIN;
+            if (connection->written < connection->out.size()) events |= POLLOUT;
+            fds.push_back(pollfd{connection->fd, events, 0});
+        }
+        const auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(
+            nextCheck - std::chrono::steady_clock::now());
+        const int ready = ::poll(fds.data(), fds.size(), static_cast<int>(std::max<std::int64_t>(0, wait.count())));
+        if (ready < 0 && errno != EINTR) throw LookupError(std::string("poll failed: ") + std::strerror(errno));
+        if (fds[0].revents) {
+            char wakes[64];
+            bool stopping = false;
+            ssize_t n;
+            while ((n = ::read(wakeRead, wakes, sizeof(wakes))) > 0) {
+                stopping |= std::find(wakes, wakes + n, WAKE_STOP) != wakes + n;
+            }
+            if (stopping) break;
+            finishReload();
+        }
+        if (std::chrono::steady_clock::now() >= nextCheck) {
+            startReloadIfChanged();
+            nextCheck = std::chrono::steady_clock::now() + options.reloadInterval;
+        }
+        if (ready <= 0) continue;
+
+        for (std::size_t i = 0; i < connections.size(); ++i) {
+            Connection& connection = *connections[i];
+            const short revents = fds[i + 2].revents;
+            if (revents & (POLLIN | POLLHUP | POLLERR)) {
+                while (connection.out.size() - connection.written < MAX_PENDING_OUTPUT) {
+                    const ssize_t n = ::recv(connection.fd, chunk, sizeof(chunk), 0);
+                    if (n < 0 && errno == EINTR) continue;
+                    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+                    if (n <= 0) {
+                        connection.closed = true;
+                        break;
+                    }
+                    connection.in.append(chunk, static_cast<std::size_t>(n));
+                    if (!handle(connection)) {
+                        connection.closed = true;
+                        break;
+                    }
+                }
+            }
+            // Answers go out as soon as they are ready rather than a poll later.
+            while (!connection.closed && connection.written < connection.out.size()) {
+                const ssize_t n = ::send(connection.fd, connection.out.data() + connection.written,
+                                         connection.out.size() - connection.written, MSG_NOSIGNAL);
+                if (n < 0 && errno == EINTR) continue;
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+                if (n < 0) {
+                    connection.closed = true;
+                    break;
+                }
+                connection.written += static_cast<std::size_t>(n);
+            }
+            if (connection.written == connection.out.size()) {
+                connection.out.clear();
+                connection.written = 0;
+            }
+        }
+        std::erase_if(connections, [](const auto& connection) { return connection->closed; });
+
+        if (fds[1].revents & POLLIN) {
+            while (true) {
+                const int fd = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+                if (fd < 0) break;
+                connections.push_back(std::make_unique<Connection>(fd));
+            }
+        }
+    }
+}
+
+LookupClient::LookupClient(const std::string& socketPath) {
+    sockaddr_un address;
+    if (!fillAddress(socketPath, address)) throw LookupError("Socket path too long: " + socketPath);
+    fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) throw LookupError(socketError("Cannot create socket for", socketPath));
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        const std::string reason = socketError("Cannot connect to", socketPath);
+        ::close(fd);
+        throw LookupError(reason);
+    }
+}
+
+LookupClient::~LookupClient() {
+    ::close(fd);
+}
+
+std::string LookupClient::exchange(LookupRequest type, const std::vector<Digest>& digests) {
+    std::string payload;
+    payload.reserve(4 + 8 * digests.size());
+    putLittle<std::uint32_t>(payload, static_cast<std::uint32_t>(digests.size()));
+    for (Digest digest : digests) putLittle<std::uint64_t>(payload, digest);
+    std::string request;
+    putFrame(request, type, payload);
+    if (!sendAll(fd, request.data(), request.size())) {
+        throw LookupError(std::string("Cannot send lookup request: ") + std::strerror(errno));
+    }
+
+    char header[HEADER_SIZE];
+    if (!receiveAll(fd, header, sizeof(header))) throw LookupError("Lookup server closed the connection");
+    if (static_cast<LookupRequest>(static_cast<unsigned char>(header[0])) != type) {
+        throw LookupError("Lookup response of the wrong type");
+    }
+    std::string response(getLittle<std::uint32_t>(header + 1), '\0');
+    if (!receiveAll(fd, response.data(), response.size())) throw LookupError("Lookup server closed the connection");
+    return response;
+}
+
+std::vector<bool> LookupClient::contains(const std::vector<Digest>& digests) {
+    const std::string response = exchange(LookupRequest::Contains, digests);
+    ResponseReader reader(response);
+    if (reader.get<std::uint32_t>() != digests.size()) throw LookupError("Lookup response of the wrong length");
+    const std::string bitmap = reader.getString((digests.size() + 7) / 8);
+    if (!reader.done()) throw LookupError("Trailing bytes in lookup response");
+    std::vector<bool> known(digests.size());
+    for (std::size_t i = 0; i < digests.size(); ++i) known[i] = (bitmap[i / 8] >> (i % 8)) & 1;
+    return known;
+}
+
+std::vector<std::vector<std::string>> LookupClient::paths(const std::vector<Digest>& digests) {
+    const std::string response = exchange(LookupRequest::Paths, digests);
+    ResponseReader reader(response);
+    if (reader.get<std::uint32_t>() != digests.size()) throw LookupError("Lookup response of the wrong length");
+    std::vector<std::vector<std::string>> result(digests.size());
+    for (auto& paths : result) {
+        const auto count = reader.get<std::uint32_t>();
+        for (std::uint32_t i = 0; i < count; ++i) paths.push_back(reader.getString(reader.get<std::uint32_t>()));
+    }
+    if (!reader.done()) throw LookupError("Trailing bytes in lookup response");
+    return result;
+}
+
+} // namespace FileComparator
@@ -0,0 +1,363 @@
+#include "Manifest.hpp"
+#include "DirectoryWalk.hpp"
+#include <bit>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace FileComparator {
+
+// Columns are written and mapped in host order.
+static_assert(std::endian::native == std::endian::little, "manifests assume a little-endian host");
+
+namespace {
+    constexpr char MAGIC[8] = {'F', 'S', '2', 'M', 'A', 'N', 'I', 'F'};
+    constexpr std::uint32_t VERSION = 1;
+    constexpr std::size_t ALIGNMENT = 8;
+    // Guards path reconstruction against parent cycles in a corrupt file.
+    constexpr std::size_t MAX_DEPTH = 4096;
+
+    struct Header {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t blockCount;
+        std::uint64_t fileCount;
+        std::uint64_t nodeCount;
+        std::uint64_t createdAt;   // seconds since the epoch
+    };
+
+    struct BlockEntry {
+        std::uint32_t kind;
+        std::uint32_t elementSize;
+        std::uint64_t offset;
+        std::uint64_t count;
+    };
+
+    enum BlockKind : std::uint32_t {
+        STRINGS = 1,
+        NODE_PARENT,
+        NODE_NAME_OFFSET,
+        NODE_NAME_LENGTH,
+        FILE_NODE,
+        FILE_SIZE,
+        FILE_DIGEST,
+        FILE_FLAGS,
+        DIGEST_INDEX,
+    };
+
+    struct OutputBlock {
+        BlockKind kind;
+        std::uint32_t elementSize;
+        const void* data;
+        std::uint64_t count;
+    };
+
+    template<typename T>
+    OutputBlock column(BlockKind kind, const std::vector<T>& values) {
+        return OutputBlock{kind, sizeof(T), values.data(), values.size()};
+    }
+
+    std::uint64_t alignUp(std::uint64_t offset) {
+        return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    std::string_view directoryOf(std::string_view path, std::string_view& name) {
+        const auto slash = path.find_last_of('/');
+        if (slash == std::string_view::npos) {
+            name = path;
+            return {};
+        }
+        name = path.substr(slash + 1);
+        return slash == 0 ? path.substr(0, 1) : path.substr(0, slash);
+    }
+}
+
+ManifestWriter::ManifestWriter(const std::vector<std::string>& roots) {
+    for (std::string root : distinctRoots(roots)) {
+        while (root.size() > 1 && root.back() == '/') root.pop_back();
+        if (!directories.contains(root)) directories.emplace(root, nodes.addRoot(root));
+    }
+}
+
+PathId ManifestWriter::internDirectory(std::string_view directory) {
+    if (auto it = directories.find(std::string(directory)); it != directories.end()) return it->second;
+
+    PathId id;
+    std::string_view name;
+    const std::string_view parent = directoryOf(directory, name);
+    if (parent.empty() || directory == "/") {
+        id = nodes.addRoot(directory);
+    } else {
+        id = nodes.add(internDirectory(parent), name);
+    }
+    directories.emplace(std::string(directory), id);
+    return id;
+}
+
+void ManifestWriter::add(const DuplicateGroup& group) {
+    // Empty files carry no hash string but their content is known; any other
+    // file without one was alone in its size class and never hashed.
+    const bool hashed = !group.hash.empty() || group.size == 0;
+    Digest digest = 0;
+    if (!group.hash.empty()) {
+        digest = digestFromHex(group.hash).value_or(0);
+    } else if (hashed) {
+        digest = Fnv1a::OFFSET;   // the digest of no bytes
+    }
+
+    for (const auto& file : group.files) {
+        std::string_view name;
+        const std::string_view directory = directoryOf(file.path, name);
+        fileNodes.push_back(nodes.add(internDirectory(directory), name));
+        sizes.push_back(group.size);
+        digests.push_back(digest);
+        flags.push_back(hashed ? Manifest::HASHED : 0);
+    }
+}
+
+void ManifestWriter::write(const std::string& path) const {
+    std::string strings;
+    std::vector<std::uint32_t> parents;
+    std::vector<std::uint64_t> nameOffsets;
+    std::vector<std::uint32_t> nameLengths;
+    parents.reserve(nodes.size());
+    nameOffsets.reserve(nodes.size());
+    nameLengths.reserve(nodes.size());
+    for (PathId id = 0; id < nodes.size(); ++id) {
+        const std::string_view name = nodes.name(id);
+        parents.push_back(nodes.parent(id));
+        nameOffsets.push_back(strings.size());
+        nameLengths.push_back(static_cast<std::uint32_t>(name.size()));
+        strings.append(name);
+    }
+
+    std::vector<RowId> index(fileNodes.size());
+    std::iota(index.begin(), index.end(), RowId{0});
+    radixSortRows(index, digests);
+    radixSortRows(index, sizes);
+
+    const std::vector<OutputBlock> blocks{
+        OutputBlock{STRINGS, 1, strings.data(), strings.size()},
+        column(NODE_PARENT, parents),
+        column(NODE_NAME_OFFSET, nameOffsets),
+        column(NODE_NAME_LENGTH, nameLengths),
+        column(FILE_NODE, fileNodes),
+        column(FILE_SIZE, sizes),
+        column(FILE_DIGEST, digests),
+        column(FILE_FLAGS, flags),
+        column(DIGEST_INDEX, index),
+    };
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.blockCount = static_cast<std::uint32_t>(blocks.size());
+    header.fileCount = fileNodes.size();
+    header.nodeCount = nodes.size();
+    header.createdAt = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+
+    std::vector<BlockEntry> entries;
+    std::uint64_t offset = alignUp(sizeof(Header) + blocks.size() * sizeof(BlockEntry));
+    for (const auto& block : blocks) {
+        entries.push_back(BlockEntry{block.kind, block.elementSize, offset, block.count});
+        offset = alignUp(offset + block.count * block.elementSize);
+    }
+
+    const std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out) throw ManifestError("Cannot create " + temporary + ": " + std::strerror(errno));
+        static const char padding[ALIGNMENT] = {};
+        auto pad = [&]() {
+            const auto position = static_cast<std::uint64_t>(out.tellp());
+            out.write(padding, static_cast<std::streamsize>(alignUp(position) - position));
+        };
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(entries.data()),
+                  static_cast<std::streamsize>(entries.size() * sizeof(BlockEntry)));
+        for (const auto& block : blocks) {
+            pad();
+            out.write(static_cast<const char*>(block.data), static_cast<std::streamsize>(block.count * block.elementSize));
+        }
+        out.flush();
+        if (!out) throw ManifestError("Cannot write " + temporary + ": " + std::strerror(errno));
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(temporary, path, ec);
+    if (ec) {
+        std::filesystem::remove(temporary, ec);
+        throw ManifestError("Cannot replace " + path + ": " + ec.message());
+    }
+}
+
+Manifest::Manifest(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) throw ManifestError("Cannot open manifest " + path + ": " + std::strerror(errno));
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(Header))) {
+        ::close(fd);
+        throw ManifestError("Not a manifest: " + path);
+    }
+    length = static_cast<std::size_t>(info.st_size);
+    void* mapped = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) throw ManifestError("Cannot map manifest " + path + ": " + std::strerror(errno));
+    base = static_cast<const char*>(mapped);
+
+    // The destructor does not run if the constructor throws.
+    auto fail = [&](const std::string& reason) {
+        ::munmap(const_cast<char*>(base), length);
+        throw ManifestError("Invalid manifest " + path + ": " + reason);
+    };
+
+    Header header;
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) fail("bad magic");
+    if (header.version != VERSION) fail("unsupported version " + std::to_string(header.version));
+    if (header.blockCount > (length - sizeof(Header)) / sizeof(BlockEntry)) fail("truncated block directory");
+    files = header.fileCount;
+    nodeCount = header.nodeCount;
+    created = header.createdAt;
+
+    for (std::uint32_t i = 0; i < header.blockCount; ++i) {
+        BlockEntry entry;
+        std::memcpy(&entry, base + sizeof(Header) + i * sizeof(BlockEntry), sizeof(entry));
+        if (entry.elementSize == 0 || entry.offset % ALIGNMENT != 0 || entry.offset > length ||
+            entry.count > (length - entry.offset) / entry.elementSize) {
+            fail("block " + std::to_string(entry.kind) + " out of bounds");
+        }
+        const char* data = base + entry.offset;
+        auto expect = [&](std::uint32_t elementSize, std::uint64_t count) {
+            if (entry.elementSize != elementSize || entry.count != count) {
+                fail("block " + std::to_string(entry.kind) + " has the wrong shape");
+            }
+        };
+        switch (entry.kind) {
+            case STRINGS:
+                expect(1, entry.count);
+                strings = data;
+                stringBytes = entry.count;
+                break;
+            case NODE_PARENT:
+                expect(4, nodeCount);
+                nodeParentColumn = reinterpret_cast<const std::uint32_t*>(data);
+                break;
+            case NODE_NAME_OFFSET:
+                expect(8, nodeCount);
+                nodeNameOffsetColumn = reinterpret_cast<const std::uint64_t*>(data);
+                break;
+            case NODE_NAME_LENGTH:
+                expect(4, nodeCount);
+                nodeNameLengthColumn = reinterpret_cast<const std::uint32_t*>(data);
+                break;
+            case FILE_NODE:
+                expect(4, files);
+                fileNodeColumn = reinterpret_cast<const std::uint32_t*>(data);
+                break;
+            case FILE_SIZE:
+                expect(8, files);
+                sizeColumn = reinterpret_cast<const std::uint64_t*>(data);
+                break;
+            case FILE_DIGEST:
+                expect(8, files);
+                digestColumn = reinterpret_cast<const std::uint64_t*>(data);
+                break;
+            case FILE_FLAGS:
+                expect(1, files);
+                flagColumn = reinterpret_cast<const std::uint8_t*>(data);
+                break;
+            case DIGEST_INDEX:
+                expect(4, files);
+                indexColumn = reinterpret_cast<const std::uint32_t*>(data);
+                break;
+            default:
+                break;   // a block from a later writer
+        }
+    }
+    if (!strings || !nodeParentColumn || !nodeNameOffsetColumn || !nodeNameLengthColumn || !fileNodeColumn ||
+        !sizeColumn || !digestColumn || !flagColumn || !indexColumn) {
+        fail("missing block");
+    }
+}
+
+Manifest::~Manifest() {
+    ::munmap(const_cast<char*>(base), length);
+}
+
+std::string_view Manifest::nodeName(std::uint32_t node) const {
+    if (node >= nodeCount) throw ManifestError("node out of range");
+    const std::uint64_t offset = nodeNameOffsetColumn[node];
+    const std::uint32_t size = nodeNameLengthColumn[node];
+    if (offset > stringBytes || size > stringBytes - offset) throw ManifestError("name out of range");
+    return {strings + offset, size};
+}
+
+std::string Manifest::path(RowId row) const {
+    return buildPath(row, true);
+}
+
+std::string Manifest::relativePath(RowId row) const {
+    return buildPath(row, false);
+}
+
+std::string Manifest::buildPath(RowId row, bool withRoot) const {
+    std::vector<std::uint32_t> chain{fileNodeColumn[row]};
+    if (chain.back() >= nodeCount) throw ManifestError("node out of range");
+    while (nodeParentColumn[chain.back()] != PathTable::NO_PARENT) {
+        if (chain.size() == MAX_DEPTH) throw ManifestError("path too deep");
+        chain.push_back(nodeParentColumn[chain.back()]);
+        if (chain.back() >= nodeCount) throw ManifestError("node out of range");
+    }
+
+    if (!withRoot) chain.pop_back();
+    if (chain.empty()) return std::string();
+
+    std::string result(nodeName(chain.back()));
+    for (auto it = chain.rbegin() + 1; it != chain.rend(); ++it) {
+        if (!result.empty() && result != "/") result.push_back('/');
+        result.append(nodeName(*it));
+    }
+    return result;
+}
+
+FileInfo Manifest::fileInfo(RowId row) const {
+    const bool withHash = hashed(row) && fileSize(row) != 0;
+    return FileInfo{path(row), std::string(name(row)), fileSize(row),
+                    withHash ? digestToHex(digest(row)) : std::string()};
+}
+
+Generator<DuplicateGroup> Manifest::groups() const {
+    for (std::size_t i = 0; i < files;) {
+        DuplicateGroup group{};
+        bool corrupt = false;
+        try {
+            const RowId first = indexColumn[i];
+            if (first >= files) throw ManifestError("index out of range");
+            group.size = fileSize(first);
+            group.files.push_back(fileInfo(first));
+            group.hash = group.files.front().hash;
+            for (++i; i < files && hashed(first); ++i) {
+                const RowId row = indexColumn[i];
+                if (row >= files) throw ManifestError("index out of range");
+                if (!hashed(row) || fileSize(row) != group.size || digest(row) != digest(first)) break;
+                group.files.push_back(fileInfo(row));
+            }
+        } catch (const ManifestError& e) {
+            std::cerr << "Corrupt manifest: " << e.what() << std::endl;
+            corrupt = true;
+        }
+        if (corrupt) break;
+        co_yield std::move(group);
+    }
+}
+
+} // namespace FileComparator
@@ -0,0 +1,106 @@
+#include "ManifestCompare.hpp"
+#include <algorithm>
+#include <optional>
+#include <utility>
+
+namespace FileComparator {
+
+namespace {
+    using ContentKey = std::pair<std::uint64_t, Digest>;
+
+    // A position in one manifest's index, kept on hashed rows only.
+    struct Cursor {
+        const Manifest* manifest;
+        std::size_t position = 0;
+        std::size_t unhashed = 0;
+
+        void skipUnhashed() {
+            while (position < manifest->fileCount() && !manifest->hashed(row())) {
+                ++unhashed;
+                ++position;
+            }
+        }
+        bool done() const { return position >= manifest->fileCount(); }
+        RowId row() const {
+            const RowId row = manifest->indexed(position);
+            if (row >= manifest->fileCount()) throw ManifestError("index out of range");
+            return row;
+        }
+        ContentKey key() const { return {manifest->fileSize(row()), manifest->digest(row())}; }
+    };
+
+    // True if some relative path appears in every manifest's list.
+    bool hasCommonPath(std::vector<std::vector<std::string>>& relative) {
+        for (auto& paths : relative) {
+            std::sort(paths.begin(), paths.end());
+        }
+        for (const auto& path : relative.front()) {
+            bool everywhere = true;
+            for (std::size_t m = 1; m < relative.size() && everywhere; ++m) {
+                everywhere = std::binary_search(relative[m].begin(), relative[m].end(), path);
+            }
+            if (everywhere) return true;
+        }
+        return false;
+    }
+}
+
+const char* toString(CrossStatus status) {
+    switch (status) {
+        case CrossStatus::Missing: return "missing";
+        case CrossStatus::Moved: return "moved";
+        case CrossStatus::Shared: return "shared";
+    }
+    return "unknown";
+}
+
+Generator<CrossGroup> compareManifests(std::vector<const Manifest*> manifests) {
+    std::vector<Cursor> cursors;
+    for (const Manifest* manifest : manifests) {
+        cursors.push_back(Cursor{manifest});
+    }
+
+    while (true) {
+        CrossGroup group{};
+        bool corrupt = false;
+        try {
+            std::optional<ContentKey> smallest;
+            for (auto& cursor : cursors) {
+                cursor.skipUnhashed();
+                if (!cursor.done() && (!smallest || cursor.key() < *smallest)) smallest = cursor.key();
+            }
+            if (!smallest) break;
+
+            group.size = smallest->first;
+            group.hash = group.size != 0 ? digestToHex(smallest->second) : std::string();
+            std::vector<std::vector<std::string>> relative(cursors.size());
+            std::size_t present = 0;
+            for (std::size_t m = 0; m < cursors.size(); ++m) {
+                Cursor& cursor = cursors[m];
+                for (; !cursor.done() && cursor.key() == *smallest; ++cursor.position, cursor.skipUnhashed()) {
+                    group.files.push_back(CrossFile{m, cursor.manifest->path(cursor.row())});
+                    relative[m].push_back(cursor.manifest->relativePath(cursor.row()));
+                }
+                present += !relative[m].empty();
+            }
+            if (present < cursors.size()) {
+                group.status = CrossStatus::Missing;
+            } else {
+                group.status = hasCommonPath(relative) ? CrossStatus::Shared : CrossStatus::Moved;
+            }
+        } catch (const ManifestError& e) {
+            std::cerr << "Corrupt manifest: " << e.what() << std::endl;
+            corrupt = true;
+        }
+        if (corrupt) break;
+        co_yield std::move(group);
+    }
+
+    for (std::size_t m = 0; m < cursors.size(); ++m) {
+        if (cursors[m].unhashed == 0) continue;
+        std::cerr << "Manifest " << m << ": " << cursors[m].unhashed
+                  << " files were never hashed and were not compared (save with --hash-all)" << std::endl;
+    }
+}
+
+} // namespace FileComparator
@@ -0,0 +1,215 @@
+#include "Metrics.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <unistd.h>
+
+namespace FileComparator::Metrics {
+
+namespace {
+    constexpr std::size_t STAGES = static_cast<std::size_t>(Stage::Count);
+    constexpr std::size_t COUNTERS = static_cast<std::size_t>(Counter::Count);
+    constexpr std::size_t MAX_EVENTS_PER_THREAD = 1 << 20;
+
+    constexpr const char* STAGE_NAMES[STAGES] = {"traverse", "read", "hash", "queue-wait", "task", "group"};
+    constexpr const char* COUNTER_NAMES[COUNTERS] = {"directories", "files",     "bytes read",
+                                                     "files hashed", "pool tasks", "queue depth sum"};
+
+    struct Event {
+        const char* name;
+        Stage stage;
+        std::uint64_t start;
+        std::uint64_t end;
+    };
+
+    // Written only by its own thread; the atomics let a report read it while
+    // that thread is still alive.
+    struct ThreadData {
+        std::size_t id = 0;
+        std::array<std::atomic<std::uint64_t>, STAGES> stageNanoseconds{};
+        std::array<std::atomic<std::uint64_t>, STAGES> stageCalls{};
+        std::array<std::atomic<std::uint64_t>, COUNTERS> counters{};
+        std::atomic<std::uint64_t> maxQueueDepth{0};
+        std::mutex eventsMutex;
+        std::vector<Event> events;
+        std::uint64_t droppedEvents = 0;
+    };
+
+    // Thread data outlives its thread, so a report after the pool has
+    // shut down still sees everything.
+    struct Registry {
+        std::mutex mutex;
+        std::vector<std::shared_ptr<ThreadData>> threads;
+        std::atomic<std::uint64_t> origin{0};
+    };
+
+    Registry& registry() {
+        static Registry instance;
+        return instance;
+    }
+
+    ThreadData& local() {
+        thread_local std::shared_ptr<ThreadData> data = [] {
+            auto created = std::make_shared<ThreadData>();
+            Registry& all = registry();
+            std::lock_guard lock(all.mutex);
+            created->id = all.threads.size();
+            all.threads.push_back(created);
+            return created;
+        }();
+        return *data;
+    }
+
+    void bump(std::atomic<std::uint64_t>& value, std::uint64_t amount) {
+        value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+}
+
+void enable(bool trace) {
+    registry().origin.store(now(), std::memory_order_relaxed);
+    Detail::tracing.store(trace, std::memory_order_relaxed);
+    Detail::collecting.store(true, std::memory_order_relaxed);
+}
+
+void disable() {
+    Detail::collecting.store(false, std::memory_order_relaxed);
+    Detail::tracing.store(false, std::memory_order_relaxed);
+}
+
+void reset() {
+    std::lock_guard registryLock(registry().mutex);
+    for (const auto& thread : registry().threads) {
+        for (std::size_t s = 0; s < STAGES; ++s) {
+            thread->stageNanoseconds[s].store(0, std::memory_order_relaxed);
+            thread->stageCalls[s].store(0, std::memory_order_relaxed);
+        }
+        for (auto& counter : thread->counters) counter.store(0, std::memory_order_relaxed);
+        thread->maxQueueDepth.store(0, std::memory_order_relaxed);
+        std::lock_guard lock(thread->eventsMutex);
+        thread->events.clear();
+        thread->droppedEvents = 0;
+    }
+    registry().origin.store(now(), std::memory_order_relaxed);
+}
+
+std::uint64_t now() {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+void add(Stage stage, std::uint64_t nanoseconds) {
+    if (!enabled()) return;
+    ThreadData& data = local();
+    bump(data.stageNanoseconds[static_cast<std::size_t>(stage)], nanoseconds);
+    bump(data.stageCalls[static_cast<std::size_t>(stage)], 1);
+}
+
+void count(Counter counter, std::uint64_t amount) {
+    if (!enabled()) return;
+    bump(local().counters[static_cast<std::size_t>(counter)], amount);
+}
+
+void observeQueueDepth(std::size_t depth) {
+    if (!enabled()) return;
+    ThreadData& data = local();
+    bump(data.counters[static_cast<std::size_t>(Counter::Tasks)], 1);
+    bump(data.counters[static_cast<std::size_t>(Counter::QueueDepthSum)], depth);
+    if (depth > data.maxQueueDepth.load(std::memory_order_relaxed)) {
+        data.maxQueueDepth.store(depth, std::memory_order_relaxed);
+    }
+}
+
+void trace(const char* name, Stage stage, std::uint64_t start, std::uint64_t end) {
+    if (!Detail::tracing.load(std::memory_order_relaxed)) return;
+    ThreadData& data = local();
+    std::lock_guard lock(data.eventsMutex);
+    if (data.events.size() < MAX_EVENTS_PER_THREAD) {
+        data.events.push_back(Event{name, stage, start, end});
+    } else {
+        ++data.droppedEvents;
+    }
+}
+
+void writeSummary(std::ostream& out) {
+    std::vector<std::shared_ptr<ThreadData>> threads;
+    {
+        std::lock_guard lock(registry().mutex);
+        threads = registry().threads;
+    }
+    std::array<std::uint64_t, STAGES> nanoseconds{};
+    std::array<std::uint64_t, STAGES> calls{};
+    std::array<std::uint64_t, COUNTERS> counters{};
+    std::uint64_t maxQueueDepth = 0;
+    std::uint64_t dropped = 0;
+    for (const auto& thread : threads) {
+        for (std::size_t s = 0; s < STAGES; ++s) {
+            nanoseconds[s] += thread->stageNanoseconds[s].load(std::memory_order_relaxed);
+            calls[s] += thread->stageCalls[s].load(std::memory_order_relaxed);
+        }
+        for (std::size_t c = 0; c < COUNTERS; ++c) {
+            counters[c] += thread->counters[c].load(std::memory_order_relaxed);
+        }
+        maxQueueDepth = std::max(maxQueueDepth, thread->maxQueueDepth.load(std::memory_order_relaxed));
+        std::lock_guard lock(thread->eventsMutex);
+        dropped += thread->droppedEvents;
+    }
+
+    const double wall = static_cast<double>(now() - registry().origin.load(std::memory_order_relaxed)) / 1e6;
+    out << "Pipeline stats: " << std::fixed << std::setprecision(1) << wall << " ms wall, " << threads.size()
+        << " threads\n";
+    out << std::left << std::setw(12) << "stage" << std::right << std::setw(14) << "thread ms" << std::setw(12)
+        << "calls" << std::setw(12) << "mean us" << "\n";
+    for (std::size_t s = 0; s < STAGES; ++s) {
+        out << std::left << std::setw(12) << STAGE_NAMES[s] << std::right << std::setw(14)
+            << static_cast<double>(nanoseconds[s]) / 1e6 << std::setw(12) << calls[s] << std::setw(12)
+            << (calls[s] ? static_cast<double>(nanoseconds[s]) / 1e3 / static_cast<double>(calls[s]) : 0.0) << "\n";
+    }
+    for (std::size_t c = 0; c < COUNTERS; ++c) {
+        if (static_cast<Counter>(c) == Counter::QueueDepthSum) continue;
+        out << std::left << std::setw(16) << COUNTER_NAMES[c] << std::right << std::setw(14) << counters[c] << "\n";
+    }
+    const auto tasks = counters[static_cast<std::size_t>(Counter::Tasks)];
+    out << std::left << std::setw(16) << "queue depth" << std::right << std::setw(14) << maxQueueDepth << " max, "
+        << (tasks ? static_cast<double>(counters[static_cast<std::size_t>(Counter::QueueDepthSum)]) /
+                        static_cast<double>(tasks)
+                  : 0.0)
+        << " mean\n";
+    if (dropped) out << dropped << " trace events dropped past the per-thread limit\n";
+    out << std::defaultfloat;
+}
+
+void writeTrace(std::ostream& out) {
+    std::vector<std::shared_ptr<ThreadData>> threads;
+    {
+        std::lock_guard lock(registry().mutex);
+        threads = registry().threads;
+    }
+    const std::uint64_t origin = registry().origin.load(std::memory_order_relaxed);
+    const auto pid = ::getpid();
+    auto micros = [](std::uint64_t nanoseconds) { return static_cast<double>(nanoseconds) / 1e3; };
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    out << std::fixed << std::setprecision(3);
+    for (const auto& thread : threads) {
+        out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+            << ",\"tid\":" << thread->id << ",\"args\":{\"name\":\"thread " << thread->id << "\"}}";
+        first = false;
+        std::lock_guard lock(thread->eventsMutex);
+        for (const Event& event : thread->events) {
+            const std::uint64_t start = event.start > origin ? event.start - origin : 0;
+            out << ",\n{\"name\":\"" << event.name << "\",\"cat\":\""
+                << STAGE_NAMES[static_cast<std::size_t>(event.stage)] << "\",\"ph\":\"X\",\"ts\":" << micros(start)
+                << ",\"dur\":" << micros(event.end - event.start) << ",\"pid\":" << pid << ",\"tid\":" << thread->id
+                << "}";
+        }
+    }
+    out << "\n]}\n" << std::defaultfloat;
+}
+
+} // namespace FileComparator::Metrics
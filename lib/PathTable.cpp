@@ -0,0 +1,64 @@
+#include "PathTable.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace FileComparator {
+
+PathId PathTable::add(PathId parent, std::string_view name) {
+    entries.push_back(Entry{store(name), static_cast<std::uint32_t>(name.size()), parent});
+    return static_cast<PathId>(entries.size() - 1);
+}
+
+const char* PathTable::store(std::string_view name) {
+    if (blocks.empty() || blockUsed + name.size() > blockCapacity) {
+        // Names longer than a block get a block of their own.
+        blockCapacity = std::max(BLOCK_SIZE, name.size());
+        blocks.push_back(std::make_unique<char[]>(blockCapacity));
+        blockUsed = 0;
+        arenaBytes += blockCapacity;
+    }
+    char* destination = blocks.back().get() + blockUsed;
+    std::memcpy(destination, name.data(), name.size());
+    blockUsed += name.size();
+    return destination;
+}
+
+std::string PathTable::fullPath(PathId id) const {
+    std::string path;
+    appendPath(id, path);
+    return path;
+}
+
+void PathTable::appendPath(PathId id, std::string& out) const {
+    // Collect the chain leaf-to-root, then write it root-first in one pass.
+    PathId chain[256];
+    size_t depth = 0;
+    size_t length = 0;
+    std::vector<PathId> deepChain;
+    for (PathId current = id; current != NO_PARENT; current = entries[current].parent) {
+        if (depth < std::size(chain)) {
+            chain[depth] = current;
+        } else {
+            if (deepChain.empty()) deepChain.assign(chain, chain + depth);
+            deepChain.push_back(current);
+        }
+        ++depth;
+        length += entries[current].length + 1;
+    }
+    const PathId* ids = deepChain.empty() ? chain : deepChain.data();
+
+    out.reserve(out.size() + length);
+    for (size_t i = depth; i-- > 0;) {
+        const Entry& entry = entries[ids[i]];
+        out.append(entry.name, entry.length);
+        if (i != 0 && (entry.length == 0 || entry.name[entry.length - 1] != '/')) {
+            out.push_back('/');
+        }
+    }
+}
+
+std::size_t PathTable::memoryUsage() const {
+    return entries.capacity() * sizeof(Entry) + arenaBytes;
+}
+
+} // namespace FileComparator
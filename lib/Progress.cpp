@@ -0,0 +1,164 @@
+#include "Progress.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <unistd.h>
+
+namespace FileComparator::Progress {
+
+namespace {
+    // Weight of the newest sample in the smoothed rates.
+    constexpr double SMOOTHING = 0.3;
+
+    std::uint64_t load(Counter counter) {
+        return Detail::counters[static_cast<std::size_t>(counter)].load(std::memory_order_relaxed);
+    }
+
+    std::string formatCount(double count) {
+        char text[32];
+        if (count >= 1e6) {
+            std::snprintf(text, sizeof(text), "%.1fM", count / 1e6);
+        } else if (count >= 1e4) {
+            std::snprintf(text, sizeof(text), "%.1fk", count / 1e3);
+        } else {
+            std::snprintf(text, sizeof(text), "%.0f", count);
+        }
+        return text;
+    }
+
+    std::string formatDuration(double seconds) {
+        const auto total = static_cast<std::uint64_t>(seconds + 0.5);
+        char text[32];
+        if (total >= 3600) {
+            std::snprintf(text, sizeof(text), "%lluh%02llum", static_cast<unsigned long long>(total / 3600),
+                          static_cast<unsigned long long>(total / 60 % 60));
+        } else if (total >= 60) {
+            std::snprintf(text, sizeof(text), "%llum%02llus", static_cast<unsigned long long>(total / 60),
+                          static_cast<unsigned long long>(total % 60));
+        } else {
+            std::snprintf(text, sizeof(text), "%llus", static_cast<unsigned long long>(total));
+        }
+        return text;
+    }
+}
+
+std::string formatBytes(double bytes) {
+    static constexpr const char* UNITS[] = {"B", "KB", "MB", "GB", "TB", "PB"};
+    std::size_t unit = 0;
+    while (bytes >= 1000 && unit + 1 < std::size(UNITS)) {
+        bytes /= 1000;
+        ++unit;
+    }
+    char text[32];
+    std::snprintf(text, sizeof(text), unit ? "%.1f %s" : "%.0f %s", bytes, UNITS[unit]);
+    return text;
+}
+
+Reporter::Reporter(Options options)
+    : options(std::move(options)), started(std::chrono::steady_clock::now()), lastChange(started),
+      lastSample(started), terminal(this->options.statusFile.empty() && ::isatty(STDERR_FILENO)) {
+    for (auto& counter : Detail::counters) counter.store(0, std::memory_order_relaxed);
+    Detail::walking.store(false, std::memory_order_relaxed);
+    Detail::active.store(true, std::memory_order_relaxed);
+    thread = std::thread([this] { run(); });
+}
+
+Reporter::~Reporter() {
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    thread.join();
+    emit(true);
+    Detail::active.store(false, std::memory_order_relaxed);
+}
+
+void Reporter::run() {
+    std::unique_lock lock(mutex);
+    while (!wake.wait_for(lock, options.interval, [this] { return stopping; })) {
+        lock.unlock();
+        emit(false);
+        lock.lock();
+    }
+}
+
+void Reporter::emit(bool final) {
+    const auto now = std::chrono::steady_clock::now();
+    const double elapsed = std::chrono::duration<double>(now - started).count();
+    const double sinceLast = std::chrono::duration<double>(now - lastSample).count();
+    const std::uint64_t entries = load(Counter::Entries);
+    const std::uint64_t bytesQueued = load(Counter::BytesQueued);
+    const std::uint64_t bytesHashed = load(Counter::BytesHashed);
+    const std::uint64_t filesHashed = load(Counter::FilesHashed);
+    const std::uint64_t groups = load(Counter::Groups);
+    const bool walking = Detail::walking.load(std::memory_order_relaxed);
+
+    if (sinceLast > 0) {
+        const double entryNow = static_cast<double>(entries - lastEntries) / sinceLast;
+        const double byteNow = static_cast<double>(bytesHashed - lastBytes) / sinceLast;
+        const bool first = lastSample == started;
+        entryRate = first ? entryNow : SMOOTHING * entryNow + (1 - SMOOTHING) * entryRate;
+        byteRate = first ? byteNow : SMOOTHING * byteNow + (1 - SMOOTHING) * byteRate;
+    }
+    if (entries != lastEntries || bytesHashed != lastBytes || filesHashed != lastFiles) lastChange = now;
+    lastEntries = entries;
+    lastBytes = bytesHashed;
+    lastFiles = filesHashed;
+    lastSample = now;
+
+    // A long silence is what a hung mount looks like; a large tree keeps
+    // moving, however slowly.
+    const double stalled = std::chrono::duration<double>(now - lastChange).count();
+    const double stallThreshold =
+        std::max(5.0, 3 * std::chrono::duration<double>(options.interval).count());
+    const std::uint64_t remaining = bytesQueued > bytesHashed ? bytesQueued - bytesHashed : 0;
+    const char* phase = final ? "done" : walking ? "walking" : remaining > 0 ? "hashing" : "grouping";
+    const double eta = !walking && remaining > 0 && byteRate > 0 ? static_cast<double>(remaining) / byteRate : -1;
+
+    if (!options.statusFile.empty()) {
+        std::ostringstream json;
+        json << "{\"elapsed_seconds\":" << elapsed << ",\"phase\":\"" << phase << "\",\"entries\":" << entries
+             << ",\"entries_per_second\":" << entryRate << ",\"files_queued\":" << load(Counter::FilesQueued)
+             << ",\"files_hashed\":" << filesHashed << ",\"bytes_queued\":" << bytesQueued
+             << ",\"bytes_hashed\":" << bytesHashed << ",\"bytes_per_second\":" << byteRate
+             << ",\"groups\":" << groups << ",\"eta_seconds\":" << eta << ",\"stalled_seconds\":"
+             << (stalled >= stallThreshold ? stalled : 0.0) << "}\n";
+        const std::string temporary = options.statusFile + ".tmp";
+        {
+            std::ofstream out(temporary, std::ios::trunc);
+            out << json.str();
+            if (!out) return;
+        }
+        std::error_code ec;
+        std::filesystem::rename(temporary, options.statusFile, ec);
+        return;
+    }
+
+    std::string line = "[" + formatDuration(elapsed) + "] " + phase + ": " + formatCount(entries) + " entries";
+    if (walking) {
+        line += " (" + formatCount(entryRate) + "/s)";
+    } else {
+        line += ", hashed " + formatBytes(static_cast<double>(bytesHashed)) + " of " +
+                formatBytes(static_cast<double>(bytesQueued));
+        if (bytesQueued > 0) {
+            line += " (" + std::to_string(bytesHashed * 100 / bytesQueued) + "%)";
+        }
+        if (!final) line += ", " + formatBytes(byteRate) + "/s";
+        line += ", " + formatCount(static_cast<double>(groups)) + " groups";
+        if (eta >= 0) line += ", ETA " + formatDuration(eta);
+    }
+    if (!final && stalled >= stallThreshold) line += " - no progress for " + formatDuration(stalled);
+
+    if (terminal) {
+        std::cerr << '\r' << line << "\x1b[K" << (final ? "\n" : "") << std::flush;
+    } else {
+        std::cerr << line << '\n' << std::flush;
+    }
+}
+
+} // namespace FileComparator::Progress
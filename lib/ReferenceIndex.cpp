@@ -0,0 +1,455 @@
+#include "ReferenceIndex.hpp"
+#include "DirectoryWalk.hpp"
+#include "GroupingEngine.hpp"
+#include "Progress.hpp"
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <limits>
+#include <numeric>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace FileComparator {
+
+static_assert(std::endian::native == std::endian::little, "reference indexes assume a little-endian host");
+
+namespace {
+    constexpr char MAGIC[8] = {'F', 'S', '2', 'R', 'E', 'F', 'I', 'X'};
+    constexpr std::uint32_t VERSION = 1;
+    // Blocks start on a cache line, so each filter block is exactly one.
+    constexpr std::size_t ALIGNMENT = 64;
+    constexpr std::size_t HASH_BATCH_FILES = 64;
+
+    // A filter block is one cache line of eight words; a key sets one bit in
+    // each. At 12 bits per entry about one absent key in 200 gets through.
+    constexpr std::size_t BLOCK_WORDS = 8;
+    constexpr std::size_t BITS_PER_ENTRY = 12;
+    constexpr std::uint32_t SALTS[BLOCK_WORDS] = {0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+                                                  0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+
+    struct Header {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t blockCount;
+        std::uint64_t entryCount;
+        std::uint64_t filterBlocks;
+        std::uint64_t createdAt;   // seconds since the epoch
+    };
+
+    struct BlockEntry {
+        std::uint32_t kind;
+        std::uint32_t elementSize;
+        std::uint64_t offset;
+        std::uint64_t count;
+    };
+
+    enum BlockKind : std::uint32_t {
+        FILTER = 1,
+        ENTRY_SIZE,
+        ENTRY_HEAD,
+        ENTRY_DIGEST,
+        PATH_OFFSET,
+        STRINGS,
+    };
+
+    struct OutputBlock {
+        BlockKind kind;
+        std::uint32_t elementSize;
+        const void* data;
+        std::uint64_t count;
+    };
+
+    template<typename T>
+    OutputBlock column(BlockKind kind, const std::vector<T>& values) {
+        return OutputBlock{kind, sizeof(T), values.data(), values.size()};
+    }
+
+    std::uint64_t alignUp(std::uint64_t offset) {
+        return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    std::uint64_t mix(std::uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    std::uint64_t filterKey(std::uint64_t size, Digest head) {
+        return mix(head ^ mix(size + 0x9e3779b97f4a7c15ULL));
+    }
+
+    // The high half of the key picks the block, the low half the bits.
+    std::size_t filterBlock(std::uint64_t key, std::uint64_t blocks) {
+        return static_cast<std::size_t>((static_cast<unsigned __int128>(key) * blocks) >> 64);
+    }
+
+    std::uint64_t filterBit(std::uint64_t key, std::size_t word) {
+        return std::uint64_t{1} << ((static_cast<std::uint32_t>(key) * SALTS[word]) >> 26);
+    }
+
+    // Hands rows to work on the shared pool in batches, reporting them to
+    // Progress, and waits for every batch before rethrowing a failure.
+    template<typename Work>
+    void runBatches(const std::vector<RowId>& rows, const FileTable& files, Work work) {
+        std::vector<std::future<void>> batches;
+        for (std::size_t begin = 0; begin < rows.size(); begin += HASH_BATCH_FILES) {
+            const std::size_t end = std::min(rows.size(), begin + HASH_BATCH_FILES);
+            std::uint64_t bytes = 0;
+            for (std::size_t i = begin; i < end; ++i) bytes += files.fileSize(rows[i]);
+            Progress::add(Progress::Counter::FilesQueued, end - begin);
+            Progress::add(Progress::Counter::BytesQueued, bytes);
+            batches.push_back(sharedThreadPool().enqueue([&rows, &work, begin, end]() {
+                for (std::size_t i = begin; i < end; ++i) work(rows[i]);
+                Progress::add(Progress::Counter::FilesHashed, end - begin);
+            }));
+        }
+        for (auto& task : batches) task.wait();
+        for (auto& task : batches) task.get();
+    }
+
+    void collectRoots(const std::vector<std::string>& roots, PathTable& paths, FileTable& files) {
+        Progress::setWalking(true);
+        for (const auto& root : distinctRoots(roots)) collectRegularFiles(root, {}, paths, files);
+        Progress::setWalking(false);
+    }
+}
+
+void ReferenceIndexWriter::add(std::uint64_t size, Digest head, Digest digest, std::string_view path) {
+    sizes.push_back(size);
+    heads.push_back(head);
+    digests.push_back(digest);
+    strings.append(path);
+    pathOffsets.push_back(strings.size());
+}
+
+void ReferenceIndexWriter::write(const std::string& path) const {
+    std::vector<RowId> order(sizes.size());
+    std::iota(order.begin(), order.end(), RowId{0});
+    radixSortRows(order, digests);
+    radixSortRows(order, heads);
+    radixSortRows(order, sizes);
+
+    std::vector<std::uint64_t> entrySizes, entryHeads, entryDigests, entryPaths{0};
+    std::string entryStrings;
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        const RowId row = order[i];
+        // The sort is stable, so the first of a run is the first added.
+        if (!entrySizes.empty() && entrySizes.back() == sizes[row] && entryHeads.back() == heads[row] &&
+            entryDigests.back() == digests[row]) {
+            continue;
+        }
+        entrySizes.push_back(sizes[row]);
+        entryHeads.push_back(heads[row]);
+        entryDigests.push_back(digests[row]);
+        entryStrings.append(strings, pathOffsets[row], pathOffsets[row + 1] - pathOffsets[row]);
+        entryPaths.push_back(entryStrings.size());
+    }
+
+    const std::uint64_t blocks = std::max<std::uint64_t>(1, (entrySizes.size() * BITS_PER_ENTRY + 511) / 512);
+    std::vector<std::uint64_t> filter(blocks * BLOCK_WORDS);
+    for (std::size_t i = 0; i < entrySizes.size(); ++i) {
+        const std::uint64_t key = filterKey(entrySizes[i], entryHeads[i]);
+        std::uint64_t* block = filter.data() + filterBlock(key, blocks) * BLOCK_WORDS;
+        for (std::size_t word = 0; word < BLOCK_WORDS; ++word) block[word] |= filterBit(key, word);
+    }
+
+    const std::vector<OutputBlock> outputBlocks{
+        column(FILTER, filter),
+        column(ENTRY_SIZE, entrySizes),
+        column(ENTRY_HEAD, entryHeads),
+        column(ENTRY_DIGEST, entryDigests),
+        column(PATH_OFFSET, entryPaths),
+        OutputBlock{STRINGS, 1, entryStrings.data(), entryStrings.size()},
+    };
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.blockCount = static_cast<std::uint32_t>(outputBlocks.size());
+    header.entryCount = entrySizes.size();
+    header.filterBlocks = blocks;
+    header.createdAt = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+
+    std::vector<BlockEntry> entries;
+    std::uint64_t offset = alignUp(sizeof(Header) + outputBlocks.size() * sizeof(BlockEntry));
+    for (const auto& block : outputBlocks) {
+        entries.push_back(BlockEntry{block.kind, block.elementSize, offset, block.count});
+        offset = alignUp(offset + block.count * block.elementSize);
+    }
+
+    const std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out) throw ReferenceIndexError("Cannot create " + temporary + ": " + std::strerror(errno));
+        static const char padding[ALIGNMENT] = {};
+        auto pad = [&]() {
+            const auto position = static_cast<std::uint64_t>(out.tellp());
+            out.write(padding, static_cast<std::streamsize>(alignUp(position) - position));
+        };
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(entries.data()),
+                  static_cast<std::streamsize>(entries.size() * sizeof(BlockEntry)));
+        for (const auto& block : outputBlocks) {
+            pad();
+            out.write(static_cast<const char*>(block.data), static_cast<std::streamsize>(block.count * block.elementSize));
+        }
+        out.flush();
+        if (!out) throw ReferenceIndexError("Cannot write " + temporary + ": " + std::strerror(errno));
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(temporary, path, ec);
+    if (ec) {
+        std::filesystem::remove(temporary, ec);
+        throw ReferenceIndexError("Cannot replace " + path + ": " + ec.message());
+    }
+}
+
+ReferenceIndex::ReferenceIndex(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) throw ReferenceIndexError("Cannot open reference index " + path + ": " + std::strerror(errno));
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(Header))) {
+        ::close(fd);
+        throw ReferenceIndexError("Not a reference index: " + path);
+    }
+    length = static_cast<std::size_t>(info.st_size);
+    void* mapped = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        throw ReferenceIndexError("Cannot map reference index " + path + ": " + std::strerror(errno));
+    }
+    base = static_cast<const char*>(mapped);
+
+    // The destructor does not run if the constructor throws.
+    auto fail = [&](const std::string& reason) {
+        ::munmap(const_cast<char*>(base), length);
+        throw ReferenceIndexError("Invalid reference index " + path + ": " + reason);
+    };
+
+    Header header;
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) fail("bad magic");
+    if (header.version != VERSION) fail("unsupported version " + std::to_string(header.version));
+    if (header.blockCount > (length - sizeof(Header)) / sizeof(BlockEntry)) fail("truncated block directory");
+    if (header.filterBlocks == 0) fail("empty filter");
+    entries = header.entryCount;
+    filterBlocks = header.filterBlocks;
+    created = header.createdAt;
+
+    for (std::uint32_t i = 0; i < header.blockCount; ++i) {
+        BlockEntry entry;
+        std::memcpy(&entry, base + sizeof(Header) + i * sizeof(BlockEntry), sizeof(entry));
+        if (entry.elementSize == 0 || entry.offset % ALIGNMENT != 0 || entry.offset > length ||
+            entry.count > (length - entry.offset) / entry.elementSize) {
+            fail("block " + std::to_string(entry.kind) + " out of bounds");
+        }
+        const char* data = base + entry.offset;
+        auto expect = [&](std::uint32_t elementSize, std::uint64_t count) {
+            if (entry.elementSize != elementSize || entry.count != count) {
+                fail("block " + std::to_string(entry.kind) + " has the wrong shape");
+            }
+        };
+        switch (entry.kind) {
+            case FILTER:
+                if (filterBlocks > std::numeric_limits<std::uint64_t>::max() / BLOCK_WORDS) fail("filter too large");
+                expect(8, filterBlocks * BLOCK_WORDS);
+                filterColumn = reinterpret_cast<const std::uint64_t*>(data);
+                break;
+            case ENTRY_SIZE:
+                expect(8, entries);
+                sizeColumn = reinterpret_cast<const std::uint64_t*>(data);
+                break;
+            case ENTRY_HEAD:
+                expect(8, entries);
+                headColumn = reinterpret_cast<const std::uint64_t*>(data);
+                break;
+            case ENTRY_DIGEST:
+                expect(8, entries);
+                digestColumn = reinterpret_cast<const std::uint64_t*>(data);
+                break;
+            case PATH_OFFSET:
+                expect(8, entries + 1);
+                pathOffsetColumn = reinterpret_cast<const std::uint64_t*>(data);
+                break;
+            case STRINGS:
+                expect(1, entry.count);
+                strings = data;
+                stringBytes = entry.count;
+                break;
+            default:
+                break;   // a block from a later writer
+        }
+    }
+    if (!filterColumn || !sizeColumn || !headColumn || !digestColumn || !pathOffsetColumn || !strings) {
+        fail("missing block");
+    }
+}
+
+ReferenceIndex::~ReferenceIndex() {
+    ::munmap(const_cast<char*>(base), length);
+}
+
+bool ReferenceIndex::mayContain(std::uint64_t size, Digest head) const {
+    const std::uint64_t key = filterKey(size, head);
+    const std::uint64_t* block = filterColumn + filterBlock(key, filterBlocks) * BLOCK_WORDS;
+    for (std::size_t word = 0; word < BLOCK_WORDS; ++word) {
+        const std::uint64_t bit = filterBit(key, word);
+        if ((block[word] & bit) != bit) return false;
+    }
+    return true;
+}
+
+std::pair<std::uint64_t, std::uint64_t> ReferenceIndex::headRange(std::uint64_t size, Digest head) const {
+    auto before = [&](std::uint64_t i) {
+        return sizeColumn[i] < size || (sizeColumn[i] == size && headColumn[i] < head);
+    };
+    auto notAfter = [&](std::uint64_t i) {
+        return sizeColumn[i] < size || (sizeColumn[i] == size && headColumn[i] <= head);
+    };
+    auto partition = [&](auto&& predicate) {
+        std::uint64_t low = 0, high = entries;
+        while (low < high) {
+            const std::uint64_t middle = low + (high - low) / 2;
+            if (predicate(middle)) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        return low;
+    };
+    return {partition(before), partition(notAfter)};
+}
+
+std::string ReferenceIndex::entryPath(std::uint64_t entry) const {
+    const std::uint64_t begin = pathOffsetColumn[entry];
+    const std::uint64_t end = pathOffsetColumn[entry + 1];
+    if (begin > end || end > stringBytes) throw ReferenceIndexError("path out of range");
+    return std::string(strings + begin, end - begin);
+}
+
+std::string ReferenceIndex::find(std::uint64_t size, Digest head, Digest digest) const {
+    auto [first, last] = headRange(size, head);
+    // Within a head range entries are ordered by digest.
+    const std::uint64_t* match = std::lower_bound(digestColumn + first, digestColumn + last, digest);
+    if (match == digestColumn + last || *match != digest) return std::string();
+    return entryPath(static_cast<std::uint64_t>(match - digestColumn));
+}
+
+ReferenceResult ReferenceIndex::lookup(const std::string& path, const FileMetadata& metadata) const {
+    ReferenceResult result;
+    const auto head = digestFileHead(path);
+    if (!head) {
+        result.outcome = ReferenceOutcome::Unreadable;
+        return result;
+    }
+    if (!mayContain(metadata.size, *head)) {
+        result.outcome = ReferenceOutcome::Filtered;
+        return result;
+    }
+    auto [first, last] = headRange(metadata.size, *head);
+    if (first == last) return result;
+
+    // The head digest of a file no larger than the head is its digest.
+    Digest digest = *head;
+    if (metadata.size > HEAD_DIGEST_BYTES) {
+        result.fullyHashed = true;
+        const auto full = digestFile(path, metadata);
+        if (!full) {
+            result.outcome = ReferenceOutcome::Unreadable;
+            return result;
+        }
+        digest = *full;
+    }
+    result.reference = find(metadata.size, *head, digest);
+    if (!result.reference.empty()) result.outcome = ReferenceOutcome::Present;
+    return result;
+}
+
+std::size_t buildReferenceIndex(const std::vector<std::string>& roots, const std::string& output) {
+    PathTable paths;
+    FileTable files;
+    collectRoots(roots, paths, files);
+
+    // One row per inode: other names for it hold the same content.
+    std::vector<RowId> rows(files.size());
+    std::iota(rows.begin(), rows.end(), RowId{0});
+    std::sort(rows.begin(), rows.end(), [&](RowId a, RowId b) {
+        if (files.device(a) != files.device(b)) return files.device(a) < files.device(b);
+        return files.inode(a) != files.inode(b) ? files.inode(a) < files.inode(b) : a < b;
+    });
+    rows.erase(std::unique(rows.begin(), rows.end(), [&](RowId a, RowId b) {
+        return files.device(a) == files.device(b) && files.inode(a) == files.inode(b);
+    }), rows.end());
+    std::sort(rows.begin(), rows.end());
+
+    std::vector<Digest> heads(files.size());
+    runBatches(rows, files, [&](RowId row) {
+        const std::string path = paths.fullPath(files.path(row));
+        const auto head = digestFileHead(path);
+        if (!head) {
+            files.setDigestFailed(row);
+            return;
+        }
+        heads[row] = *head;
+        if (files.fileSize(row) <= HEAD_DIGEST_BYTES) {
+            files.setDigest(row, *head);
+        } else if (const auto digest = digestFile(path, files.metadata(row))) {
+            files.setDigest(row, *digest);
+        } else {
+            files.setDigestFailed(row);
+        }
+    });
+
+    ReferenceIndexWriter writer;
+    for (RowId row : rows) {
+        if (files.digestState(row) != DigestState::Hashed) continue;
+        writer.add(files.fileSize(row), heads[row], files.digest(row), paths.fullPath(files.path(row)));
+    }
+    writer.write(output);
+    return ReferenceIndex(output).size();
+}
+
+ReferenceCheckSummary checkReference(
+    const ReferenceIndex& index, const std::vector<std::string>& roots,
+    const std::function<void(const std::string& path, const ReferenceResult& result)>& onFile) {
+    PathTable paths;
+    FileTable files;
+    collectRoots(roots, paths, files);
+
+    std::vector<RowId> rows(files.size());
+    std::iota(rows.begin(), rows.end(), RowId{0});
+    std::vector<ReferenceResult> results(files.size());
+    runBatches(rows, files, [&](RowId row) {
+        results[row] = index.lookup(paths.fullPath(files.path(row)), files.metadata(row));
+    });
+
+    ReferenceCheckSummary summary;
+    for (RowId row : rows) {
+        const ReferenceResult& result = results[row];
+        ++summary.files;
+        if (result.fullyHashed) ++summary.fullyHashed;
+        switch (result.outcome) {
+            case ReferenceOutcome::Filtered: ++summary.filtered; break;
+            case ReferenceOutcome::Absent: ++summary.absent; break;
+            case ReferenceOutcome::Present: ++summary.present; break;
+            case ReferenceOutcome::Unreadable: ++summary.unreadable; break;
+        }
+        if (onFile) onFile(paths.fullPath(files.path(row)), result);
+    }
+    return summary;
+}
+
+} // namespace FileComparator
@@ -0,0 +1,53 @@
+#include "Scan.hpp"
+#include "Errors.hpp"
+#include "ExternalGrouping.hpp"
+#include "Sharding.hpp"
+#include <stdexcept>
+
+namespace FileComparator {
+
+Generator<DuplicateGroup> scanGroups(std::vector<std::string> roots, ScanOptions options) {
+    if (options.memoryBudget && options.grouping.scanArchives) {
+        throw std::invalid_argument("archives cannot be scanned out of core");
+    }
+    if (options.memoryBudget && options.shards > 0) {
+        throw std::invalid_argument("a sharded scan cannot also run out of core");
+    }
+    if (options.shards > 0) {
+        ShardOptions sharding;
+        sharding.workers = options.shards;
+        sharding.pinWorkers = options.pinShards;
+        sharding.grouping = options.grouping;
+        return groupByContentSharded(std::move(roots), sharding);
+    }
+    if (options.memoryBudget) {
+        ExternalOptions external;
+        external.memoryBudget = *options.memoryBudget;
+        external.tempDirectory = options.tempDirectory;
+        external.grouping = options.grouping;
+        return groupByContentExternal(std::move(roots), external);
+    }
+    return groupByContent(std::move(roots), options.grouping);
+}
+
+ScanSummary scanGroups(const std::vector<std::string>& roots, const GroupCallback& onGroup,
+                       const ScanOptions& options) {
+    ScanSummary summary;
+    const std::uint64_t errorsBefore = Errors::total();
+    for (auto& group : scanGroups(roots, options)) {
+        ++summary.groups;
+        summary.files += group.files.size();
+        if (group.files.size() > 1) {
+            ++summary.duplicateGroups;
+            summary.reclaimableBytes += group.size * (group.files.size() - 1);
+        }
+        if (!onGroup(std::move(group))) {
+            summary.stopped = true;
+            break;
+        }
+    }
+    summary.errors = Errors::total() - errorsBefore;
+    return summary;
+}
+
+} // namespace FileComparator
@@ -0,0 +1,202 @@
+#include "ShardProtocol.hpp"
+#include "Hashing.hpp"
+#include <algorithm>
+#include <iterator>
+
+namespace FileComparator {
+
+namespace {
+    constexpr std::size_t HEADER_SIZE = 5;
+    constexpr std::size_t GROUP_FIXED_SIZE = 8 + 1 + 4;
+    constexpr std::uint8_t GROUP_HASHED = 1;
+    constexpr std::uint8_t GROUP_CONTINUED = 2;
+
+    template<typename T>
+    void putLittle(std::string& out, T value) {
+        for (std::size_t i = 0; i < sizeof(T); ++i) {
+            out.push_back(static_cast<char>(static_cast<std::uint64_t>(value) >> (8 * i)));
+        }
+    }
+
+    // Bounds-checked little-endian reader over one frame's payload.
+    class PayloadReader {
+    public:
+        PayloadReader(const char* data, std::size_t size) : data(data), size(size) {}
+
+        template<typename T>
+        T get() {
+            require(sizeof(T));
+            std::uint64_t value = 0;
+            for (std::size_t i = 0; i < sizeof(T); ++i) {
+                value |= static_cast<std::uint64_t>(static_cast<unsigned char>(data[offset + i])) << (8 * i);
+            }
+            offset += sizeof(T);
+            return static_cast<T>(value);
+        }
+
+        std::string getString(std::size_t length) {
+            require(length);
+            std::string value(data + offset, length);
+            offset += length;
+            return value;
+        }
+
+        bool done() const { return offset == size; }
+
+    private:
+        void require(std::size_t bytes) const {
+            if (size - offset < bytes) throw ProtocolError("truncated frame payload");
+        }
+
+        const char* data;
+        std::size_t size;
+        std::size_t offset = 0;
+    };
+
+    void beginFrame(std::string& out, FrameType type, std::size_t payload) {
+        out.push_back(static_cast<char>(type));
+        putLittle<std::uint32_t>(out, static_cast<std::uint32_t>(payload));
+    }
+
+    // Returns the group and whether it continues in the next frame.
+    std::pair<DuplicateGroup, bool> decodeGroup(const char* data, std::size_t size) {
+        PayloadReader reader(data, size);
+        DuplicateGroup group{};
+        group.size = reader.get<std::uint64_t>();
+        const auto flags = reader.get<std::uint8_t>();
+        if (flags > (GROUP_HASHED | GROUP_CONTINUED)) throw ProtocolError("bad group flags");
+        if (flags & GROUP_HASHED) group.hash = digestToHex(reader.get<std::uint64_t>());
+        const auto count = reader.get<std::uint32_t>();
+        for (std::uint32_t i = 0; i < count; ++i) {
+            std::string path = reader.getString(reader.get<std::uint32_t>());
+            const auto slash = path.find_last_of('/');
+            std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+            group.files.push_back(FileInfo{std::move(path), std::move(name), group.size, group.hash});
+        }
+        if (!reader.done()) throw ProtocolError("trailing bytes in group frame");
+        return {std::move(group), (flags & GROUP_CONTINUED) != 0};
+    }
+
+    Errors::Summary decodeError(const char* data, std::size_t size) {
+        PayloadReader reader(data, size);
+        Errors::Summary error{};
+        const auto operation = reader.get<std::uint8_t>();
+        if (operation >= static_cast<std::uint8_t>(Errors::Operation::Count)) throw ProtocolError("bad operation");
+        error.operation = static_cast<Errors::Operation>(operation);
+        error.error = static_cast<int>(reader.get<std::uint32_t>());
+        error.count = reader.get<std::uint64_t>();
+        const auto samples = reader.get<std::uint32_t>();
+        for (std::uint32_t i = 0; i < samples; ++i) {
+            error.samples.push_back(reader.getString(reader.get<std::uint32_t>()));
+        }
+        if (!reader.done()) throw ProtocolError("trailing bytes in error frame");
+        return error;
+    }
+}
+
+void encodeGroup(const DuplicateGroup& group, std::string& out, std::size_t maxPayload) {
+    maxPayload = std::min(maxPayload, MAX_FRAME_PAYLOAD);
+    const auto digest = group.hash.empty() ? std::nullopt : digestFromHex(group.hash);
+    const std::size_t fixed = GROUP_FIXED_SIZE + (digest ? 8 : 0);
+    std::size_t begin = 0;
+    do {
+        std::size_t payload = fixed;
+        std::size_t end = begin;
+        while (end < group.files.size() && payload + 4 + group.files[end].path.size() <= maxPayload) {
+            payload += 4 + group.files[end].path.size();
+            ++end;
+        }
+        if (end == begin && end < group.files.size()) {
+            throw ProtocolError("path too long for a frame: " + group.files[end].path.substr(0, 256));
+        }
+
+        const bool continued = end < group.files.size();
+        beginFrame(out, FrameType::Group, payload);
+        putLittle<std::uint64_t>(out, group.size);
+        putLittle<std::uint8_t>(out, (digest ? GROUP_HASHED : 0) | (continued ? GROUP_CONTINUED : 0));
+        if (digest) putLittle<std::uint64_t>(out, *digest);
+        putLittle<std::uint32_t>(out, static_cast<std::uint32_t>(end - begin));
+        for (std::size_t i = begin; i < end; ++i) {
+            putLittle<std::uint32_t>(out, static_cast<std::uint32_t>(group.files[i].path.size()));
+            out.append(group.files[i].path);
+        }
+        begin = end;
+    } while (begin < group.files.size());
+}
+
+void encodeEnd(std::string& out) {
+    beginFrame(out, FrameType::End, 0);
+}
+
+void encodeError(const Errors::Summary& error, std::string& out) {
+    std::size_t payload = 1 + 4 + 8 + 4;
+    for (const auto& sample : error.samples) {
+        payload += 4 + sample.size();
+    }
+
+    beginFrame(out, FrameType::Error, payload);
+    putLittle<std::uint8_t>(out, static_cast<std::uint8_t>(error.operation));
+    putLittle<std::uint32_t>(out, static_cast<std::uint32_t>(error.error));
+    putLittle<std::uint64_t>(out, error.count);
+    putLittle<std::uint32_t>(out, static_cast<std::uint32_t>(error.samples.size()));
+    for (const auto& sample : error.samples) {
+        putLittle<std::uint32_t>(out, static_cast<std::uint32_t>(sample.size()));
+        out.append(sample);
+    }
+}
+
+void FrameDecoder::feed(const char* data, std::size_t size) {
+    if (position == buffer.size()) {
+        buffer.clear();
+        position = 0;
+    } else if (position > buffer.size() / 2) {
+        buffer.erase(0, position);
+        position = 0;
+    }
+    buffer.append(data, size);
+}
+
+std::optional<Frame> FrameDecoder::next() {
+    while (buffer.size() - position >= HEADER_SIZE) {
+        PayloadReader header(buffer.data() + position, HEADER_SIZE);
+        const auto type = static_cast<FrameType>(header.get<std::uint8_t>());
+        const auto length = header.get<std::uint32_t>();
+        if (length > MAX_FRAME_PAYLOAD) throw ProtocolError("frame too large");
+        if (buffer.size() - position - HEADER_SIZE < length) return std::nullopt;
+        if (pending && type != FrameType::Group) throw ProtocolError("group left unfinished");
+
+        const char* payload = buffer.data() + position + HEADER_SIZE;
+        Frame frame{type, {}, {}};
+        switch (type) {
+            case FrameType::Group: {
+                auto [group, continued] = decodeGroup(payload, length);
+                if (pending) {
+                    if (group.size != pending->size || group.hash != pending->hash) {
+                        throw ProtocolError("continuation of a different group");
+                    }
+                    std::move(group.files.begin(), group.files.end(), std::back_inserter(pending->files));
+                } else {
+                    pending = std::move(group);
+                }
+                position += HEADER_SIZE + length;
+                if (continued) continue;
+                frame.group = std::move(*pending);
+                pending.reset();
+                return frame;
+            }
+            case FrameType::End:
+                if (length != 0) throw ProtocolError("end frame with payload");
+                break;
+            case FrameType::Error:
+                frame.error = decodeError(payload, length);
+                break;
+            default:
+                throw ProtocolError("unknown frame type " + std::to_string(static_cast<int>(type)));
+        }
+        position += HEADER_SIZE + length;
+        return frame;
+    }
+    return std::nullopt;
+}
+
+} // namespace FileComparator
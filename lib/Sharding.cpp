@@ -0,0 +1,308 @@
+#include "Sharding.hpp"
+#include "DirectoryWalk.hpp"
+#include "Errors.hpp"
+#include "GroupingEngine.hpp"
+#include "Hashing.hpp"
+#include "ShardProtocol.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace FileComparator {
+
+namespace {
+    constexpr std::size_t WRITE_BUFFER = 64 * 1024;
+    constexpr std::size_t READ_CHUNK = 64 * 1024;
+
+    bool writeAll(int fd, const std::string& data) {
+        std::size_t written = 0;
+        while (written < data.size()) {
+            const ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) return false;
+            written += static_cast<std::size_t>(n);
+        }
+        return true;
+    }
+
+    void pinToSlice(std::size_t shard, std::size_t shardCount) {
+        cpu_set_t allowed;
+        if (::sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return;
+        std::vector<int> cpus;
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &allowed)) cpus.push_back(cpu);
+        }
+        if (cpus.empty()) return;
+
+        cpu_set_t slice;
+        CPU_ZERO(&slice);
+        const std::size_t begin = cpus.size() * shard / shardCount;
+        const std::size_t end = cpus.size() * (shard + 1) / shardCount;
+        for (std::size_t i = begin; i < end; ++i) {
+            CPU_SET(cpus[i], &slice);
+        }
+        // More shards than CPUs: share them round-robin.
+        if (begin == end) CPU_SET(cpus[shard % cpus.size()], &slice);
+        ::sched_setaffinity(0, sizeof(slice), &slice);
+    }
+
+    constexpr const char* WORKER_FLAG = "--fs2-shard-worker";
+    constexpr int WORKER_FIXED_ARGUMENTS = 9;   // program name, flag, shard, options
+    std::atomic<bool> workerEntryInstalled{false};
+
+    // A worker's command line: the flag, its shard, the options, then the
+    // roots. The groups go to its stdout.
+    std::vector<std::string> workerArguments(const std::vector<std::string>& roots, std::size_t shard,
+                                             const ShardOptions& options) {
+        std::vector<std::string> args{
+            "fs2-shard",
+            WORKER_FLAG,
+            std::to_string(shard),
+            std::to_string(options.workers),
+            options.pinWorkers ? "1" : "0",
+            options.grouping.hashUnique ? "1" : "0",
+            options.grouping.scanArchives ? "1" : "0",
+            std::to_string(options.grouping.minSize),
+            options.grouping.duplicatesOnly ? "1" : "0",
+        };
+        args.insert(args.end(), roots.begin(), roots.end());
+        return args;
+    }
+
+    int runWorker(const std::vector<std::string>& roots, std::size_t shard, const ShardOptions& options) {
+        const int fd = STDOUT_FILENO;
+        int status = 0;
+        try {
+            if (options.pinWorkers) pinToSlice(shard, options.workers);
+            ThreadPool hashPool(std::max<std::size_t>(1, std::thread::hardware_concurrency() / options.workers));
+            auto keepSize = [&](std::uint64_t size) { return shardOfSize(size, options.workers) == shard; };
+            auto ownsArchive = [&](const std::string& path) { return shardOfArchive(path, options.workers) == shard; };
+
+            std::string out;
+            for (const auto& group : groupRegularFiles(roots, options.grouping, keepSize, &hashPool, ownsArchive)) {
+                encodeGroup(group, out);
+                if (out.size() < WRITE_BUFFER) continue;
+                if (!writeAll(fd, out)) {
+                    status = 1;
+                    break;
+                }
+                out.clear();
+            }
+            if (status == 0) {
+                // Every worker walks the whole tree, so only the first sends
+                // what the walk met; each sends the errors of its own reads.
+                for (const auto& error : Errors::summary()) {
+                    if (shard != 0 && error.operation != Errors::Operation::Open &&
+                        error.operation != Errors::Operation::Read && error.operation != Errors::Operation::Archive) {
+                        continue;
+                    }
+                    encodeError(error, out);
+                }
+                encodeEnd(out);
+                if (!writeAll(fd, out)) status = 1;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Shard " << shard << " failed: " << e.what() << std::endl;
+            status = 1;
+        } catch (...) {
+            status = 1;
+        }
+        return status;
+    }
+
+    std::string describeExit(int status) {
+        if (WIFSIGNALED(status)) return "killed by signal " + std::to_string(WTERMSIG(status));
+        if (WIFEXITED(status)) return "exit status " + std::to_string(WEXITSTATUS(status));
+        return "status " + std::to_string(status);
+    }
+
+    struct Worker {
+        pid_t pid = -1;
+        int fd = -1;
+        FrameDecoder decoder;
+        bool finished = false;  // End frame received
+    };
+
+    // Starts one worker per shard and owns them: whether the stream is
+    // drained or abandoned, workers still running at destruction are killed
+    // and reaped.
+    class WorkerSet {
+    public:
+        WorkerSet(const std::vector<std::string>& roots, const ShardOptions& options) : workers(options.workers) {
+            for (std::size_t shard = 0; shard < workers.size(); ++shard) {
+                int fds[2];
+                if (::pipe2(fds, O_CLOEXEC) != 0) {
+                    std::cerr << "Cannot start shard " << shard << ": " << std::strerror(errno) << std::endl;
+                    continue;
+                }
+                // Everything the child needs is built before the fork: between
+                // fork and exec it may only make async-signal-safe calls. The
+                // pipes are close-on-exec, so the worker keeps only its own
+                // write end, as stdout.
+                const auto args = workerArguments(roots, shard, options);
+                std::vector<char*> argv;
+                for (const auto& arg : args) argv.push_back(const_cast<char*>(arg.c_str()));
+                argv.push_back(nullptr);
+                const pid_t pid = ::fork();
+                if (pid == 0) {
+                    ::dup2(fds[1], STDOUT_FILENO);
+                    ::execv("/proc/self/exe", argv.data());
+                    ::_exit(127);
+                }
+                ::close(fds[1]);
+                if (pid < 0) {
+                    std::cerr << "Cannot start shard " << shard << ": " << std::strerror(errno) << std::endl;
+                    ::close(fds[0]);
+                    continue;
+                }
+                workers[shard].pid = pid;
+                workers[shard].fd = fds[0];
+            }
+        }
+
+        ~WorkerSet() {
+            for (auto& worker : workers) {
+                if (worker.fd >= 0) ::close(worker.fd);
+                if (worker.pid > 0) {
+                    ::kill(worker.pid, SIGKILL);
+                    while (::waitpid(worker.pid, nullptr, 0) < 0 && errno == EINTR) {}
+                }
+            }
+        }
+
+        WorkerSet(const WorkerSet&) = delete;
+        WorkerSet& operator=(const WorkerSet&) = delete;
+
+        // Closes a worker's stream and reaps it, reporting the shard as lost
+        // unless the worker sent its End frame and exited cleanly.
+        void finish(std::size_t shard) {
+            Worker& worker = workers[shard];
+            ::close(worker.fd);
+            worker.fd = -1;
+            int status = 0;
+            while (::waitpid(worker.pid, &status, 0) < 0 && errno == EINTR) {}
+            worker.pid = -1;
+            const bool clean = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+            if (!worker.finished || !clean) {
+                std::cerr << "Shard " << shard << " failed (" << describeExit(status)
+                          << "); its files are missing from the results" << std::endl;
+            }
+        }
+
+        std::vector<Worker> workers;
+    };
+}
+
+std::size_t shardOfSize(std::uint64_t size, std::size_t shardCount) {
+    // Fibonacci hashing spreads neighbouring sizes across shards.
+    return static_cast<std::size_t>(((size * 0x9E3779B97F4A7C15ULL) >> 32) % shardCount);
+}
+
+std::size_t shardOfArchive(const std::string& path, std::size_t shardCount) {
+    return static_cast<std::size_t>(calculateDigest(path.data(), path.size()) % shardCount);
+}
+
+namespace {
+    Generator<DuplicateGroup> shardedGroups(std::vector<std::string> directories, ShardOptions options) {
+        options.workers = std::max<std::size_t>(1, options.workers);
+        WorkerSet set(distinctRoots(directories), options);
+
+        std::vector<pollfd> polled;
+        std::vector<std::size_t> shards;
+        std::vector<char> chunk(READ_CHUNK);
+        std::vector<DuplicateGroup> ready;
+        while (true) {
+            polled.clear();
+            shards.clear();
+            for (std::size_t shard = 0; shard < set.workers.size(); ++shard) {
+                if (set.workers[shard].fd < 0) continue;
+                polled.push_back(pollfd{set.workers[shard].fd, POLLIN, 0});
+                shards.push_back(shard);
+            }
+            if (polled.empty()) break;
+            if (::poll(polled.data(), polled.size(), -1) < 0) {
+                if (errno == EINTR) continue;
+                std::cerr << "Cannot wait for shard workers: " << std::strerror(errno) << std::endl;
+                break;
+            }
+
+            for (std::size_t k = 0; k < polled.size(); ++k) {
+                if (!(polled[k].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+                Worker& worker = set.workers[shards[k]];
+                const ssize_t n = ::read(worker.fd, chunk.data(), chunk.size());
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) {
+                    set.finish(shards[k]);
+                    continue;
+                }
+                worker.decoder.feed(chunk.data(), static_cast<std::size_t>(n));
+                try {
+                    while (auto frame = worker.decoder.next()) {
+                        if (worker.finished) throw ProtocolError("data after end frame");
+                        if (frame->type == FrameType::End) {
+                            worker.finished = true;
+                        } else if (frame->type == FrameType::Error) {
+                            Errors::merge(frame->error);
+                        } else {
+                            ready.push_back(std::move(frame->group));
+                        }
+                    }
+                } catch (const ProtocolError& e) {
+                    std::cerr << "Shard " << shards[k] << " sent a malformed stream: " << e.what() << std::endl;
+                    ::kill(worker.pid, SIGKILL);
+                    worker.finished = false;
+                    set.finish(shards[k]);
+                }
+            }
+
+            for (auto& group : ready) {
+                co_yield std::move(group);
+            }
+            ready.clear();
+        }
+    }
+}
+
+Generator<DuplicateGroup> groupByContentSharded(std::vector<std::string> directories, ShardOptions options) {
+    // Checked before the generator exists; an exception inside it terminates.
+    if (!workerEntryInstalled.load()) {
+        throw std::logic_error("sharded scans need FileComparator::runShardWorker called from main");
+    }
+    return shardedGroups(std::move(directories), std::move(options));
+}
+
+std::optional<int> runShardWorker(int argc, char* argv[]) {
+    workerEntryInstalled = true;
+    if (argc < WORKER_FIXED_ARGUMENTS || std::strcmp(argv[1], WORKER_FLAG) != 0) return std::nullopt;
+
+    std::size_t shard = 0;
+    ShardOptions options;
+    try {
+        shard = std::stoull(argv[2]);
+        options.workers = std::stoull(argv[3]);
+        options.pinWorkers = std::strcmp(argv[4], "1") == 0;
+        options.grouping.hashUnique = std::strcmp(argv[5], "1") == 0;
+        options.grouping.scanArchives = std::strcmp(argv[6], "1") == 0;
+        options.grouping.minSize = std::stoull(argv[7]);
+        options.grouping.duplicatesOnly = std::strcmp(argv[8], "1") == 0;
+    } catch (const std::exception&) {
+        std::cerr << "Malformed shard worker arguments" << std::endl;
+        return 2;
+    }
+    if (options.workers == 0 || shard >= options.workers) {
+        std::cerr << "Malformed shard worker arguments" << std::endl;
+        return 2;
+    }
+    const std::vector<std::string> roots(argv + WORKER_FIXED_ARGUMENTS, argv + argc);
+    return runWorker(roots, shard, options);
+}
+
+} // namespace FileComparator
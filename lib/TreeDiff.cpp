@@ -0,0 +1,158 @@
+#include "TreeDiff.hpp"
+#include "DirectoryWalk.hpp"
+#include "Errors.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <deque>
+#include <filesystem>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace FileComparator {
+
+namespace {
+    // Enough outstanding pairs to keep the pool busy without buffering the tree.
+    constexpr size_t MAX_PENDING = 256;
+
+    struct TreeEntry {
+        std::string path;
+        FileMetadata metadata;   // the listing's one statx of the entry
+        std::string target;      // for a symlink
+    };
+
+    // Yields regular files and symlinks under root in compareRelativePaths
+    // order, each with the walk's one statx and a symlink's target.
+    Generator<TreeEntry> walkSorted(std::string root) {
+        const std::size_t prefix = (fs::path(root) / "").native().size();
+        DirectoryWalker walker(root, WalkOptions{.sorted = true, .followSymlinks = false});
+        while (WalkEntry* entry = walker.next()) {
+            if (entry->descended()) continue;
+            const FileType type = entry->type();
+            if (type != FileType::Regular && type != FileType::Symlink) continue;
+            const FileMetadata* metadata = entry->metadata();
+            if (!metadata) continue;
+
+            TreeEntry info{entry->path().native().substr(prefix), *metadata, {}};
+            if (metadata->type == FileType::Symlink) {
+                info.target.resize(metadata->size + 1);
+                const ssize_t length =
+                    ::readlinkat(entry->directory(), entry->name(), info.target.data(), info.target.size());
+                if (length < 0) {
+                    Errors::record(Errors::Operation::ReadLink, errno, entry->path().native());
+                    continue;
+                }
+                info.target.resize(static_cast<std::size_t>(length));
+            } else if (metadata->type != FileType::Regular) {
+                continue;
+            }
+            co_yield std::move(info);
+        }
+    }
+
+    struct PendingEntry {
+        DiffEntry entry;
+        std::future<std::string> leftHash;
+        std::future<std::string> rightHash;
+        std::uint64_t size = 0;
+    };
+
+    DiffStatus resolve(PendingEntry& pending) {
+        if (!pending.leftHash.valid()) return pending.entry.status;
+        auto leftHash = pending.leftHash.get();
+        auto rightHash = pending.rightHash.get();
+        // An unreadable side has been recorded by the hashing and counts as different.
+        if (pending.size != 0 && (leftHash.empty() || rightHash.empty())) return DiffStatus::Different;
+        return leftHash == rightHash ? DiffStatus::Same : DiffStatus::Different;
+    }
+}
+
+const char* toString(DiffStatus status) {
+    switch (status) {
+        case DiffStatus::OnlyLeft: return "only-left";
+        case DiffStatus::OnlyRight: return "only-right";
+        case DiffStatus::Same: return "same";
+        case DiffStatus::Different: return "different";
+    }
+    return "unknown";
+}
+
+int compareRelativePaths(std::string_view a, std::string_view b) {
+    const size_t length = std::min(a.size(), b.size());
+    for (size_t i = 0; i < length; ++i) {
+        if (a[i] == b[i]) continue;
+        // A separator ends a component, so it sorts before any name byte.
+        if (a[i] == '/') return -1;
+        if (b[i] == '/') return 1;
+        return static_cast<unsigned char>(a[i]) < static_cast<unsigned char>(b[i]) ? -1 : 1;
+    }
+    if (a.size() == b.size()) return 0;
+    return a.size() < b.size() ? -1 : 1;
+}
+
+Generator<DiffEntry> diffTrees(std::string left, std::string right, DiffOptions options) {
+    auto leftWalk = walkSorted(left);
+    auto rightWalk = walkSorted(right);
+    auto l = leftWalk.begin();
+    auto r = rightWalk.begin();
+    std::deque<PendingEntry> pending;
+
+    while (true) {
+        const bool leftDone = l == leftWalk.end();
+        const bool rightDone = r == rightWalk.end();
+        if (leftDone && rightDone) break;
+
+        const int order = leftDone ? 1 : rightDone ? -1 : compareRelativePaths((*l).path, (*r).path);
+        PendingEntry next;
+        if (order < 0) {
+            next.entry = DiffEntry{DiffStatus::OnlyLeft, std::move((*l).path)};
+            ++l;
+        } else if (order > 0) {
+            next.entry = DiffEntry{DiffStatus::OnlyRight, std::move((*r).path)};
+            ++r;
+        } else {
+            const TreeEntry& a = *l;
+            const TreeEntry& b = *r;
+            next.entry.path = a.path;
+            const bool aSymlink = a.metadata.type == FileType::Symlink;
+            const bool bSymlink = b.metadata.type == FileType::Symlink;
+            if (aSymlink || bSymlink) {
+                next.entry.status = aSymlink && bSymlink && a.target == b.target
+                    ? DiffStatus::Same : DiffStatus::Different;
+            } else if (a.metadata.size != b.metadata.size) {
+                next.entry.status = DiffStatus::Different;
+            } else if (!options.checksum && a.metadata.mtime == b.metadata.mtime) {
+                next.entry.status = DiffStatus::Same;
+            } else {
+                // Hashed with the listing's metadata, so neither side is
+                // stat-ed again.
+                next.size = a.metadata.size;
+                next.leftHash = computeHashAsync(FileInfo{(fs::path(left) / a.path).string(), std::string(),
+                                                          a.metadata.size, std::string(), a.metadata});
+                next.rightHash = computeHashAsync(FileInfo{(fs::path(right) / b.path).string(), std::string(),
+                                                           b.metadata.size, std::string(), b.metadata});
+            }
+            ++l;
+            ++r;
+        }
+        pending.push_back(std::move(next));
+
+        // Entries leave in walk order; a hashed pair holds back those behind it
+        // until it resolves or the window fills.
+        while (!pending.empty() && (pending.size() > MAX_PENDING || !pending.front().leftHash.valid())) {
+            pending.front().entry.status = resolve(pending.front());
+            DiffEntry entry = std::move(pending.front().entry);
+            pending.pop_front();
+            co_yield std::move(entry);
+        }
+    }
+
+    while (!pending.empty()) {
+        pending.front().entry.status = resolve(pending.front());
+        DiffEntry entry = std::move(pending.front().entry);
+        pending.pop_front();
+        co_yield std::move(entry);
+    }
+}
+
+} // namespace FileComparator
@@ -1,3 +1,19 @@
+#include "FileComparator.hpp"
+#include "Archive.hpp"
+#include "Dedupe.hpp"
+#include "Errors.hpp"
+#include "Estimate.hpp"
+#include "ExternalGrouping.hpp"
+#include "GroupWriter.hpp"
+#include "LookupService.hpp"
+#include "Manifest.hpp"
+#include "ManifestCompare.hpp"
+#include "ReferenceIndex.hpp"
+#include "Scan.hpp"
+#include "Metrics.hpp"
+#include "Progress.hpp"
+#include "Sharding.hpp"
+#include "TreeDiff.hpp"
 #include <boost/program_options.hpp>
 #include <boost/filesystem.hpp>
 #include <iostream>
@@ -5,67 +21,391 @@
 #include <unordered_map>
 #include <vector>
 #include <string>
+#include <optional>
+#include <array>
+#include <memory>
+#include <csignal>
 
 namespace po = boost::program_options;
 namespace fs = boost::filesystem;
 
-void compare_directories(const std::vector<std::string>& dirs, bool verbose, const std::string& log_file) {
-    std::unordered_map<std::string, std::vector<fs::path>> file_hash_map;
-    
-    std::ofstream log_stream;
-    if (!log_file.empty()) {
-        log_stream.open(log_file);
-        if (!log_stream.is_open()) {
-            std::cerr << "Failed to open log file: " << log_file << std::endl;
-            return;
+enum class Mode { All, Different, Same, Unique, Diff };
+
+std::optional<Mode> parse_mode(const std::string& name) {
+    if (name == "all") return Mode::All;
+    if (name == "different") return Mode::Different;
+    if (name == "same" || name == "equal") return Mode::Same;
+    if (name == "unique") return Mode::Unique;
+    if (name == "diff") return Mode::Diff;
+    return std::nullopt;
+}
+
+void write_group(FileComparator::GroupWriter& writer, const FileComparator::DuplicateGroup& group) {
+    if (group.files.size() == 1) {
+        writer.writeUnique(group.files.front());
+    } else {
+        writer.writeDuplicate(group);
+    }
+}
+
+// Pairs files of two trees by relative path; unchanged files are only listed
+// in text output when verbose.
+void diff_directories(FileComparator::GroupWriter& writer, const std::string& left, const std::string& right,
+                      FileComparator::OutputFormat format, bool verbose, bool checksum) {
+    FileComparator::DiffOptions options;
+    options.checksum = checksum;
+    for (const auto& entry : FileComparator::diffTrees(left, right, options)) {
+        if (entry.status == FileComparator::DiffStatus::Same && format == FileComparator::OutputFormat::Text && !verbose) {
+            continue;
+        }
+        writer.writeDiff(entry);
+    }
+}
+
+struct CompareOptions {
+    Mode mode = Mode::All;
+    FileComparator::OutputFormat format = FileComparator::OutputFormat::Text;
+    bool verbose = false;
+    bool checksum = false;
+    bool hash_all = false;
+    bool archives = false;
+    std::optional<FileComparator::DedupeMethod> dedupe;
+    std::optional<std::size_t> memory_budget;
+    std::optional<FileComparator::ShardOptions> shards;
+    std::string save_manifest;
+    std::string from_manifest;
+    std::string log_file;
+};
+
+// Standard output, or the log file when one is given; null if it cannot be opened.
+std::ostream* open_output(const std::string& log_file, std::ofstream& log_stream) {
+    if (log_file.empty()) return &std::cout;
+    log_stream.open(log_file);
+    if (!log_stream.is_open()) {
+        std::cerr << "Failed to open log file: " << log_file << std::endl;
+        return nullptr;
+    }
+    return &log_stream;
+}
+
+// Reports how content is spread over two or more saved manifests.
+void compare_manifests(const std::vector<std::string>& paths, const CompareOptions& options) {
+    std::vector<std::unique_ptr<FileComparator::Manifest>> manifests;
+    std::vector<const FileComparator::Manifest*> views;
+    try {
+        for (const auto& path : paths) {
+            manifests.push_back(std::make_unique<FileComparator::Manifest>(path));
+            views.push_back(manifests.back().get());
         }
+    } catch (const FileComparator::ManifestError& e) {
+        std::cerr << e.what() << std::endl;
+        return;
     }
-    auto& output = log_file.empty() ? std::cout : log_stream;
 
+    std::ofstream log_stream;
+    auto* output = open_output(options.log_file, log_stream);
+    if (!output) return;
+    FileComparator::GroupWriter writer(*output, options.format);
+
+    std::array<size_t, 3> counts{};
+    for (const auto& group : FileComparator::compareManifests(views)) {
+        ++counts[static_cast<size_t>(group.status)];
+        writer.writeCross(group, paths);
+    }
+    if (options.verbose) {
+        writer.writeNote("Compared " + std::to_string(paths.size()) + " manifests: " + std::to_string(counts[0]) +
+                         " missing, " + std::to_string(counts[1]) + " moved, " + std::to_string(counts[2]) + " shared.");
+    }
+    writer.flush();
+}
+
+void compare_directories(const std::vector<std::string>& dirs, const CompareOptions& options) {
+    const Mode mode = options.mode;
+    const auto format = options.format;
+    const bool verbose = options.verbose;
+    const auto& dedupe = options.dedupe;
+
+    std::ofstream log_stream;
+    auto* output = open_output(options.log_file, log_stream);
+    if (!output) return;
+    FileComparator::GroupWriter writer(*output, format);
+
+    std::vector<std::string> roots;
     for (const auto& dir : dirs) {
         if (!fs::exists(dir) || !fs::is_directory(dir)) {
-            output << "Invalid directory: " << dir << std::endl;
+            if (format == FileComparator::OutputFormat::Text) {
+                writer.writeNote("Invalid directory: " + dir);
+            } else {
+                std::cerr << "Invalid directory: " << dir << std::endl;
+            }
             continue;
         }
+        roots.push_back(dir);
+    }
 
-        for (fs::recursive_directory_iterator it(dir), end; it != end; ++it) {
-            if (fs::is_regular_file(it->path())) {
-                std::string filename = it->path().filename().string();
-                file_hash_map[filename].push_back(it->path());
-            }
+    if (mode == Mode::Diff) {
+        if (roots.size() == 2) {
+            diff_directories(writer, roots[0], roots[1], format, verbose, options.checksum);
+        } else {
+            std::cerr << "Error: diff mode requires exactly two directories." << std::endl;
         }
+        roots.clear();
     }
 
-    for (const auto& [filename, paths] : file_hash_map) {
-        if (paths.size() > 1) {
-            output << "Duplicate file: " << filename << " found in locations:" << std::endl;
-            for (const auto& path : paths) {
-                output << "  " << path << std::endl;
-            }
+    // Same-named files whose content differs; needs every group before it can report.
+    std::unordered_map<std::string, std::vector<std::pair<FileComparator::FileInfo, size_t>>> by_name;
+    size_t group_index = 0;
+    std::vector<std::future<FileComparator::DedupeResult>> dedupe_results;
+
+    std::optional<FileComparator::Manifest> manifest;
+    if (!options.from_manifest.empty()) {
+        try {
+            manifest.emplace(options.from_manifest);
+        } catch (const FileComparator::ManifestError& e) {
+            std::cerr << e.what() << std::endl;
+            return;
+        }
+    }
+    FileComparator::ManifestWriter manifest_writer(roots);
+
+    FileComparator::ScanOptions scan;
+    scan.grouping.hashUnique = options.hash_all;
+    scan.grouping.scanArchives = options.archives;
+    scan.memoryBudget = options.memory_budget;
+    if (options.shards) {
+        scan.shards = options.shards->workers;
+        scan.pinShards = options.shards->pinWorkers;
+    }
+    auto groups = manifest ? manifest->groups() : FileComparator::scanGroups(roots, scan);
+    for (auto& group : groups) {
+        FileComparator::Progress::add(FileComparator::Progress::Counter::Groups);
+        if (!options.save_manifest.empty()) manifest_writer.add(group);
+        const bool duplicated = group.files.size() > 1;
+        switch (mode) {
+            case Mode::All:
+                write_group(writer, group);
+                break;
+            case Mode::Same:
+                if (duplicated) write_group(writer, group);
+                break;
+            case Mode::Unique:
+                if (!duplicated) write_group(writer, group);
+                break;
+            case Mode::Different:
+                for (auto& file : group.files) {
+                    by_name[file.name].emplace_back(std::move(file), group_index);
+                }
+                break;
+            case Mode::Diff:
+                break;
+        }
+        if (dedupe && duplicated && mode != Mode::Different) {
+            // Members inside archives cannot be replaced by links.
+            std::erase_if(group.files, [](const FileComparator::FileInfo& file) {
+                return FileComparator::isArchiveMemberPath(file.path);
+            });
+            FileComparator::DedupeOptions dedupe_options;
+            dedupe_options.method = *dedupe;
+            dedupe_results.push_back(FileComparator::dedupeGroupAsync(std::move(group), dedupe_options));
+        }
+        ++group_index;
+    }
+
+    if (!options.save_manifest.empty()) {
+        try {
+            manifest_writer.write(options.save_manifest);
+        } catch (const FileComparator::ManifestError& e) {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+
+    if (dedupe) {
+        FileComparator::DedupeResult total;
+        for (auto& result : dedupe_results) {
+            total += result.get();
+        }
+        std::cerr << "Deduplicated " << total.filesLinked << " files, reclaimed " << total.bytesReclaimed
+                  << " bytes (" << total.skipped << " skipped, " << total.failed << " failed)" << std::endl;
+    }
+
+    for (const auto& [filename, entries] : by_name) {
+        bool differs = false;
+        for (const auto& entry : entries) {
+            differs |= entry.second != entries.front().second;
         }
+        if (!differs) continue;
+        std::vector<FileComparator::FileInfo> files;
+        for (const auto& entry : entries) {
+            files.push_back(entry.first);
+        }
+        writer.writeDifferent(filename, files);
     }
 
     if (verbose) {
-        output << "Comparison complete." << std::endl;
+        writer.writeNote("Comparison complete.");
     }
+    writer.flush();
 
     if (log_stream.is_open()) {
         log_stream.close();
     }
 }
 
+// Prints the --stats summary and writes the --trace file, if requested.
+void report_metrics(bool stats, const std::string& trace_file) {
+    if (stats) FileComparator::Metrics::writeSummary(std::cerr);
+    if (trace_file.empty()) return;
+    std::ofstream trace(trace_file);
+    if (!trace) {
+        std::cerr << "Failed to open trace file: " << trace_file << std::endl;
+        return;
+    }
+    FileComparator::Metrics::writeTrace(trace);
+}
+
+// Stores every distinct content under directories in a reference index.
+void build_reference(const std::vector<std::string>& directories, const std::string& path) {
+    try {
+        const std::size_t entries = FileComparator::buildReferenceIndex(directories, path);
+        std::cerr << "Stored " << entries << " distinct contents in " << path << "." << std::endl;
+    } catch (const FileComparator::ReferenceIndexError& e) {
+        std::cerr << e.what() << std::endl;
+    }
+}
+
+// Lists each file under directories as stored, with a reference path that
+// holds its content, or as new.
+void check_reference(const std::vector<std::string>& directories, const std::string& path,
+                     const CompareOptions& options) {
+    std::unique_ptr<FileComparator::ReferenceIndex> index;
+    try {
+        index = std::make_unique<FileComparator::ReferenceIndex>(path);
+    } catch (const FileComparator::ReferenceIndexError& e) {
+        std::cerr << e.what() << std::endl;
+        return;
+    }
+
+    std::ofstream log_stream;
+    auto* output = open_output(options.log_file, log_stream);
+    if (!output) return;
+    auto summary = FileComparator::checkReference(*index, directories, [&](const std::string& file,
+                                                                          const FileComparator::ReferenceResult& result) {
+        if (result.outcome == FileComparator::ReferenceOutcome::Present) {
+            *output << "stored\t" << file << '\t' << result.reference << '\n';
+        } else if (result.outcome != FileComparator::ReferenceOutcome::Unreadable) {
+            *output << "new\t" << file << '\n';
+        }
+    });
+    output->flush();
+    std::cerr << summary.present << " of " << summary.files << " files are already stored. "
+              << summary.filtered << " were ruled out by the filter alone and " << summary.fullyHashed
+              << " were read in full." << std::endl;
+}
+
+FileComparator::LookupServer* active_server = nullptr;
+
+extern "C" void stop_serving(int) {
+    if (active_server) active_server->stop();
+}
+
+// Answers lookups from the data file on the socket until SIGINT or SIGTERM.
+int serve(const std::string& data, const std::string& socket) {
+    try {
+        FileComparator::LookupServer server(data, socket);
+        active_server = &server;
+        std::signal(SIGINT, stop_serving);
+        std::signal(SIGTERM, stop_serving);
+        std::cerr << "Serving " << data << " on " << socket << "." << std::endl;
+        server.run();
+        active_server = nullptr;
+    } catch (const FileComparator::LookupError& e) {
+        active_server = nullptr;
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Checks --progress-interval and turns on the collection --stats and --trace
+// ask for; false, having said why, if the interval is not positive.
+bool setup_reporting(bool stats, const std::string& trace_file, double progress_interval,
+                     FileComparator::Progress::Options& progress_options) {
+    if (progress_interval <= 0) {
+        std::cerr << "Error: --progress-interval must be positive." << std::endl;
+        return false;
+    }
+    if (stats || !trace_file.empty()) FileComparator::Metrics::enable(!trace_file.empty());
+    progress_options.interval = std::chrono::milliseconds(static_cast<long long>(progress_interval * 1000));
+    return true;
+}
+
+// Prints the errors met while scanning, once, and writes them as records
+// to --error-log if requested.
+void report_errors(const std::string& error_log) {
+    FileComparator::Errors::writeReport(std::cerr);
+    if (error_log.empty()) return;
+    std::ofstream log(error_log);
+    if (!log) {
+        std::cerr << "Failed to open error log: " << error_log << std::endl;
+        return;
+    }
+    FileComparator::Errors::writeRecords(log);
+}
+
 int main(int argc, char* argv[]) {
+    if (auto status = FileComparator::runShardWorker(argc, argv)) return *status;
+
     std::vector<std::string> directories;
-    std::string log_file;
-    bool verbose = false;
+    std::vector<std::string> manifests_to_compare;
+    CompareOptions options;
+    std::string mode_name = "all";
+    std::string format_name = "text";
+    std::string dedupe_name;
+    std::string memory_budget_text;
+    std::size_t shard_count = 0;
+    bool pin_shards = false;
+    bool stats = false;
+    std::string trace_file;
+    std::string error_log;
+    bool estimate = false;
+    std::string reference_to_build;
+    std::string reference;
+    std::string serve_socket;
+    FileComparator::EstimateOptions estimate_options;
+    bool progress = false;
+    FileComparator::Progress::Options progress_options;
+    double progress_interval = 1.0;
 
     try {
         po::options_description desc("Allowed options");
         desc.add_options()
             ("help,h", "Show help message")
             ("directories,d", po::value<std::vector<std::string>>(&directories)->multitoken(), "Directories to compare")
-            ("log-file,l", po::value<std::string>(&log_file), "Log file for output")
-            ("verbose,v", po::bool_switch(&verbose), "Enable verbose output");
+            ("mode,m", po::value<std::string>(&mode_name), "Comparison mode: all, different, same (equal), unique, diff")
+            ("format,f", po::value<std::string>(&format_name), "Output format: text, ndjson, csv")
+            ("checksum,c", po::bool_switch(&options.checksum), "In diff mode, hash same-sized files even when mtimes match")
+            ("dedupe", po::value<std::string>(&dedupe_name), "Replace duplicates with links: reflink (falls back to hardlink), hardlink (replaced files take the owner and permissions of the kept one)")
+            ("memory-budget", po::value<std::string>(&memory_budget_text), "Group out of core, spilling sorted runs to $TMPDIR past this many bytes (e.g. 512M)")
+            ("shards", po::value<std::size_t>(&shard_count), "Split the scan across this many worker processes by file size")
+            ("pin-shards", po::bool_switch(&pin_shards), "Pin each shard worker to its own slice of CPUs")
+            ("save-manifest", po::value<std::string>(&options.save_manifest), "Also save the scan as a binary manifest")
+            ("from-manifest", po::value<std::string>(&options.from_manifest), "Report from a saved manifest instead of scanning")
+            ("compare-manifests", po::value<std::vector<std::string>>(&manifests_to_compare)->multitoken(), "Compare two or more saved manifests by content: missing, moved, shared")
+            ("hash-all", po::bool_switch(&options.hash_all), "Hash files of unique size too, so saved manifests can be compared")
+            ("archives", po::bool_switch(&options.archives), "Also compare the files inside .tar, .tar.gz/.tgz and .zip archives")
+            ("stats", po::bool_switch(&stats), "Print per-stage timings and counters to stderr when done")
+            ("trace", po::value<std::string>(&trace_file), "Write a Chrome trace-event JSON of the run to this file")
+            ("progress", po::bool_switch(&progress), "Report throughput and ETA on stderr while scanning")
+            ("progress-file", po::value<std::string>(&progress_options.statusFile), "Write progress as JSON to this file instead of stderr")
+            ("progress-interval", po::value<double>(&progress_interval), "Seconds between progress reports (default 1)")
+            ("error-log", po::value<std::string>(&error_log), "Write the errors met while scanning as NDJSON records to this file")
+            ("estimate", po::bool_switch(&estimate), "Only estimate the duplicate bytes, hashing a stratified sample of size classes")
+            ("estimate-fraction", po::value<double>(&estimate_options.sampleFraction), "Share of the candidate bytes --estimate hashes (default 0.01)")
+            ("build-reference", po::value<std::string>(&reference_to_build), "Store every content under the directories in this reference index")
+            ("reference", po::value<std::string>(&reference), "List which files under the directories this reference index already holds")
+            ("serve", po::value<std::string>(&serve_socket), "Answer digest lookups from --from-manifest or --reference on this Unix socket")
+            ("log-file,l", po::value<std::string>(&options.log_file), "Log file for output")
+            ("verbose,v", po::bool_switch(&options.verbose), "Enable verbose output");
 
         po::variables_map vm;
         po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -76,12 +416,130 @@ int main(int argc, char* argv[]) {
             return 0;
         }
 
-        if (directories.empty()) {
+        if (!manifests_to_compare.empty()) {
+            auto format = FileComparator::parseOutputFormat(format_name);
+            if (!format) {
+                std::cerr << "Error: Unknown format: " << format_name << std::endl;
+                return 1;
+            }
+            if (manifests_to_compare.size() < 2) {
+                std::cerr << "Error: --compare-manifests needs at least two manifests." << std::endl;
+                return 1;
+            }
+            options.format = *format;
+            std::ios::sync_with_stdio(false);
+            if (stats || !trace_file.empty()) FileComparator::Metrics::enable(!trace_file.empty());
+            compare_manifests(manifests_to_compare, options);
+            report_metrics(stats, trace_file);
+            return 0;
+        }
+
+        if (!serve_socket.empty()) {
+            if (options.from_manifest.empty() == reference.empty()) {
+                std::cerr << "Error: --serve needs one of --from-manifest and --reference." << std::endl;
+                return 1;
+            }
+            return serve(options.from_manifest.empty() ? reference : options.from_manifest, serve_socket);
+        }
+
+        if (directories.empty() && options.from_manifest.empty()) {
             std::cerr << "Error: At least one directory must be specified." << std::endl;
             return 1;
         }
 
-        compare_directories(directories, verbose, log_file);
+        if (!setup_reporting(stats, trace_file, progress_interval, progress_options)) return 1;
+        // Runs work with the progress reporter going, if asked for, then
+        // reports the errors and metrics it collected.
+        auto run_reported = [&](auto&& work) {
+            {
+                std::optional<FileComparator::Progress::Reporter> reporter;
+                if (progress || !progress_options.statusFile.empty()) reporter.emplace(progress_options);
+                work();
+            }
+            report_errors(error_log);
+            report_metrics(stats, trace_file);
+        };
+
+        if (estimate || !reference_to_build.empty() || !reference.empty()) {
+            if (estimate + !reference_to_build.empty() + !reference.empty() > 1) {
+                std::cerr << "Error: --estimate, --build-reference and --reference are exclusive." << std::endl;
+                return 1;
+            }
+            if (directories.empty() || !options.from_manifest.empty()) {
+                std::cerr << "Error: --estimate, --build-reference and --reference need directories to scan."
+                          << std::endl;
+                return 1;
+            }
+            if (estimate && !(estimate_options.sampleFraction > 0 && estimate_options.sampleFraction <= 1)) {
+                std::cerr << "Error: --estimate-fraction must be in (0, 1]." << std::endl;
+                return 1;
+            }
+            run_reported([&] {
+                if (estimate) {
+                    FileComparator::writeEstimate(std::cout,
+                                                  FileComparator::estimateDuplicates(directories, estimate_options));
+                } else if (!reference_to_build.empty()) {
+                    build_reference(directories, reference_to_build);
+                } else {
+                    check_reference(directories, reference, options);
+                }
+            });
+            return 0;
+        }
+
+        auto mode = parse_mode(mode_name);
+        if (!mode) {
+            std::cerr << "Error: Unknown mode: " << mode_name << std::endl;
+            return 1;
+        }
+        if (*mode == Mode::Diff && !options.from_manifest.empty()) {
+            std::cerr << "Error: diff mode needs two directories, not a manifest." << std::endl;
+            return 1;
+        }
+
+        auto format = FileComparator::parseOutputFormat(format_name);
+        if (!format) {
+            std::cerr << "Error: Unknown format: " << format_name << std::endl;
+            return 1;
+        }
+
+        options.mode = *mode;
+        options.format = *format;
+
+        if (!dedupe_name.empty()) {
+            options.dedupe = FileComparator::parseDedupeMethod(dedupe_name);
+            if (!options.dedupe) {
+                std::cerr << "Error: Unknown dedupe method: " << dedupe_name << std::endl;
+                return 1;
+            }
+        }
+
+        if (!memory_budget_text.empty()) {
+            options.memory_budget = FileComparator::parseByteSize(memory_budget_text);
+            if (!options.memory_budget) {
+                std::cerr << "Error: Invalid memory budget: " << memory_budget_text << std::endl;
+                return 1;
+            }
+        }
+
+        if (options.archives && options.memory_budget) {
+            std::cerr << "Error: --archives cannot be combined with --memory-budget." << std::endl;
+            return 1;
+        }
+
+        if (shard_count > 0) {
+            if (options.memory_budget) {
+                std::cerr << "Error: --shards cannot be combined with --memory-budget." << std::endl;
+                return 1;
+            }
+            FileComparator::ShardOptions sharding;
+            sharding.workers = shard_count;
+            sharding.pinWorkers = pin_shards;
+            options.shards = sharding;
+        }
+
+        std::ios::sync_with_stdio(false);
+        run_reported([&] { compare_directories(directories, options); });
 
     } catch (const po::error& ex) {
         std::cerr << "Error parsing options: " << ex.what() << std::endl;
@@ -90,4 +548,3 @@ int main(int argc, char* argv[]) {
 
     return 0;
 }
-
@@ -0,0 +1,10 @@
+#include <gtest/gtest.h>
+#include "Sharding.hpp"
+
+// Sharded scans start their workers from this binary, so it has to answer
+// to the worker command line before gtest parses it.
+int main(int argc, char** argv) {
+    if (auto status = FileComparator::runShardWorker(argc, argv)) return *status;
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
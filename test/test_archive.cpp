@@ -0,0 +1,209 @@
+#include "Archive.hpp"
+#include "Errors.hpp"
+#include "FileComparator.hpp"
+#include <gtest/gtest.h>
+#include <zlib.h>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+
+namespace fs = std::filesystem;
+
+namespace {
+    std::string tarEntry(const std::string& name, const std::string& content, char type = '0') {
+        std::string header(512, '\0');
+        std::memcpy(header.data(), name.data(), name.size());
+        std::snprintf(header.data() + 100, 8, "%07o", 0644);
+        std::snprintf(header.data() + 124, 12, "%011o", static_cast<unsigned>(content.size()));
+        header[156] = type;
+        std::memcpy(header.data() + 257, "ustar", 6);
+        std::memcpy(header.data() + 263, "00", 2);
+        std::memset(header.data() + 148, ' ', 8);
+        unsigned sum = 0;
+        for (unsigned char c : header) sum += c;
+        std::snprintf(header.data() + 148, 8, "%06o", sum);
+        return header + content + std::string((512 - content.size() % 512) % 512, '\0');
+    }
+
+    std::string tarArchive() {
+        return tarEntry("./docs/", "", '5') + tarEntry("./docs/a.txt", "alpha content") +
+               tarEntry("./docs/b.txt", "bravo") + tarEntry("./empty", "") + std::string(1024, '\0');
+    }
+
+    void put(std::string& out, std::uint64_t value, int bytes) {
+        for (int i = 0; i < bytes; ++i) out.push_back(static_cast<char>(value >> (8 * i)));
+    }
+
+    std::string rawDeflate(const std::string& content) {
+        z_stream stream{};
+        deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+        std::string out(deflateBound(&stream, content.size()), '\0');
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(content.data()));
+        stream.avail_in = static_cast<uInt>(content.size());
+        stream.next_out = reinterpret_cast<Bytef*>(out.data());
+        stream.avail_out = static_cast<uInt>(out.size());
+        deflate(&stream, Z_FINISH);
+        out.resize(stream.total_out);
+        deflateEnd(&stream);
+        return out;
+    }
+
+    // A zip of {name, content, deflate?} entries.
+    std::string zipArchive(const std::vector<std::tuple<std::string, std::string, bool>>& entries) {
+        std::string body, central;
+        for (const auto& [name, content, deflated] : entries) {
+            const std::string data = deflated ? rawDeflate(content) : content;
+            const auto crc = crc32(0, reinterpret_cast<const Bytef*>(content.data()), content.size());
+            const auto offset = body.size();
+            put(body, 0x04034b50, 4);
+            put(body, 20, 2);
+            put(body, 0, 2);
+            put(body, deflated ? 8 : 0, 2);
+            put(body, 0, 4);
+            put(body, crc, 4);
+            put(body, data.size(), 4);
+            put(body, content.size(), 4);
+            put(body, name.size(), 2);
+            put(body, 0, 2);
+            body += name + data;
+
+            put(central, 0x02014b50, 4);
+            put(central, 20, 2);
+            put(central, 20, 2);
+            put(central, 0, 2);
+            put(central, deflated ? 8 : 0, 2);
+            put(central, 0, 4);
+            put(central, crc, 4);
+            put(central, data.size(), 4);
+            put(central, content.size(), 4);
+            put(central, name.size(), 2);
+            put(central, 0, 2);
+            put(central, 0, 2);
+            put(central, 0, 2);
+            put(central, 0, 2);
+            put(central, 0, 4);
+            put(central, offset, 4);
+            central += name;
+        }
+        std::string end;
+        put(end, 0x06054b50, 4);
+        put(end, 0, 4);
+        put(end, entries.size(), 2);
+        put(end, entries.size(), 2);
+        put(end, central.size(), 4);
+        put(end, body.size(), 4);
+        put(end, 0, 2);
+        return body + central + end;
+    }
+
+    std::map<std::string, FileComparator::ArchiveMember> byPath(std::vector<FileComparator::ArchiveMember> members) {
+        std::map<std::string, FileComparator::ArchiveMember> result;
+        for (auto& member : members) result[member.path] = member;
+        return result;
+    }
+
+    FileComparator::Digest digestOf(const std::string& content) {
+        return FileComparator::calculateDigest(content.data(), content.size());
+    }
+}
+
+TEST(FileComparatorArchiveTests, TestArchiveFormatOf) {
+    using FileComparator::ArchiveFormat;
+    ASSERT_EQ(FileComparator::archiveFormatOf("a.tar"), ArchiveFormat::Tar);
+    ASSERT_EQ(FileComparator::archiveFormatOf("a.TAR.GZ"), ArchiveFormat::TarGz);
+    ASSERT_EQ(FileComparator::archiveFormatOf("a.tgz"), ArchiveFormat::TarGz);
+    ASSERT_EQ(FileComparator::archiveFormatOf("a.zip"), ArchiveFormat::Zip);
+    ASSERT_FALSE(FileComparator::archiveFormatOf("a.gz"));
+    ASSERT_TRUE(FileComparator::isArchiveMemberPath("dir/a.zip!/x/y"));
+    ASSERT_FALSE(FileComparator::isArchiveMemberPath("dir/wow!/y"));
+}
+
+TEST(FileComparatorArchiveTests, TestTarMembers) {
+    std::ofstream("archive_test.tar", std::ios::binary) << tarArchive();
+    auto members = byPath(FileComparator::hashArchiveMembers("archive_test.tar", FileComparator::ArchiveFormat::Tar));
+    fs::remove("archive_test.tar");
+
+    ASSERT_EQ(members.size(), 3);
+    ASSERT_EQ(members["docs/a.txt"].size, 13);
+    ASSERT_EQ(members["docs/a.txt"].digest, digestOf("alpha content"));
+    ASSERT_EQ(members["docs/b.txt"].digest, digestOf("bravo"));
+    ASSERT_EQ(members["empty"].size, 0);
+}
+
+TEST(FileComparatorArchiveTests, TestTarGzMembers) {
+    // Two gzip members, as produced by concatenating compressed files.
+    const std::string tar = tarArchive();
+    gzFile out = gzopen("archive_test.tar.gz", "wb");
+    gzwrite(out, tar.data(), 1000);
+    gzclose(out);
+    out = gzopen("archive_test.tar.gz", "ab");
+    gzwrite(out, tar.data() + 1000, static_cast<unsigned>(tar.size() - 1000));
+    gzclose(out);
+
+    auto members = byPath(
+        FileComparator::hashArchiveMembers("archive_test.tar.gz", FileComparator::ArchiveFormat::TarGz));
+    fs::remove("archive_test.tar.gz");
+
+    ASSERT_EQ(members.size(), 3);
+    ASSERT_EQ(members["docs/a.txt"].digest, digestOf("alpha content"));
+    ASSERT_EQ(members["docs/b.txt"].digest, digestOf("bravo"));
+}
+
+TEST(FileComparatorArchiveTests, TestZipMembers) {
+    const std::string large(300 * 1024, 'z');
+    std::ofstream("archive_test.zip", std::ios::binary)
+        << zipArchive({{"dir/", "", false}, {"dir/stored.txt", "stored bytes", false}, {"large.bin", large, true}});
+    auto members = byPath(FileComparator::hashArchiveMembers("archive_test.zip", FileComparator::ArchiveFormat::Zip));
+    fs::remove("archive_test.zip");
+
+    ASSERT_EQ(members.size(), 2);
+    ASSERT_EQ(members["dir/stored.txt"].digest, digestOf("stored bytes"));
+    ASSERT_EQ(members["large.bin"].size, large.size());
+    ASSERT_EQ(members["large.bin"].digest, digestOf(large));
+}
+
+TEST(FileComparatorArchiveTests, TestTruncatedArchiveKeepsEarlierMembers) {
+    const std::string tar = tarArchive();
+    std::ofstream("archive_cut.tar", std::ios::binary) << tar.substr(0, 512 * 3 + 100);
+    FileComparator::Errors::clear();
+    auto members = byPath(FileComparator::hashArchiveMembers("archive_cut.tar", FileComparator::ArchiveFormat::Tar));
+    fs::remove("archive_cut.tar");
+
+    ASSERT_EQ(members.size(), 1);
+    ASSERT_TRUE(members.count("docs/a.txt"));
+    const auto errors = FileComparator::Errors::summary();
+    FileComparator::Errors::clear();
+    ASSERT_EQ(errors.size(), 1);
+    ASSERT_EQ(errors[0].operation, FileComparator::Errors::Operation::Archive);
+    ASSERT_EQ(errors[0].error, EBADMSG);
+    ASSERT_EQ(errors[0].samples, std::vector<std::string>{"archive_cut.tar"});
+}
+
+TEST(FileComparatorArchiveTests, TestArchiveMembersGroupWithFiles) {
+    fs::create_directories("archive_scan");
+    std::ofstream("archive_scan/a-copy.txt") << "alpha content";
+    std::ofstream("archive_scan/bundle.zip", std::ios::binary)
+        << zipArchive({{"inner/a.txt", "alpha content", true}, {"other.txt", "something else", false}});
+
+    FileComparator::GroupingOptions options;
+    options.scanArchives = true;
+    std::map<std::string, std::vector<std::string>> groups;
+    for (const auto& group : FileComparator::groupByContent({"archive_scan"}, options)) {
+        for (const auto& file : group.files) {
+            groups[group.files.front().path].push_back(file.path);
+        }
+    }
+    const auto plain = [] {
+        std::size_t count = 0;
+        for (const auto& group : FileComparator::groupByContent({"archive_scan"})) count += group.files.size();
+        return count;
+    }();
+    fs::remove_all("archive_scan");
+
+    ASSERT_EQ(plain, 2);
+    ASSERT_EQ(groups.size(), 3);
+    const std::vector<std::string> expected{"archive_scan/a-copy.txt", "archive_scan/bundle.zip!/inner/a.txt"};
+    ASSERT_EQ(groups["archive_scan/a-copy.txt"], expected);
+    ASSERT_TRUE(groups.count("archive_scan/bundle.zip!/other.txt"));
+}
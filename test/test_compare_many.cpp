@@ -0,0 +1,93 @@
+#include "FileComparator.hpp"
+#include "Hashing.hpp"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+    FileComparator::FileInfo infoFor(const std::string& path) {
+        return FileComparator::FileInfo{path, fs::path(path).filename().string(), 0, ""};
+    }
+}
+
+TEST(FileComparatorCompareManyTests, TestMemoKeysOnSizeAndMtime) {
+    const std::string dir = "compare_memo";
+    fs::create_directories(dir);
+    std::ofstream(dir + "/a") << "same content";
+    std::ofstream(dir + "/b") << "same content";
+    FileComparator::clearDigestMemo();
+    ASSERT_TRUE(FileComparator::compareFiles(infoFor(dir + "/a"), infoFor(dir + "/b")));
+
+    // Rewritten in place with its size and mtime kept: the memo answers.
+    const auto mtime = fs::last_write_time(dir + "/b");
+    std::ofstream(dir + "/b") << "diff content";
+    fs::last_write_time(dir + "/b", mtime);
+    ASSERT_TRUE(FileComparator::compareFiles(infoFor(dir + "/a"), infoFor(dir + "/b")));
+
+    fs::last_write_time(dir + "/b", mtime + std::chrono::seconds(1));
+    ASSERT_FALSE(FileComparator::compareFiles(infoFor(dir + "/a"), infoFor(dir + "/b")));
+
+    fs::last_write_time(dir + "/b", mtime);
+    FileComparator::clearDigestMemo();
+    ASSERT_FALSE(FileComparator::compareFiles(infoFor(dir + "/a"), infoFor(dir + "/b")));
+
+    fs::remove_all(dir);
+}
+
+TEST(FileComparatorCompareManyTests, TestUnreadableFilesNeverMatch) {
+    FileComparator::clearDigestMemo();
+    ASSERT_FALSE(FileComparator::compareFiles(infoFor("compare_missing_a"), infoFor("compare_missing_b")));
+
+    // A hash already on the FileInfo is used; only the other file is read.
+    std::ofstream("compare_known") << "known content";
+    auto known = infoFor("compare_missing_a");
+    known.hash = FileComparator::digestToHex(*FileComparator::digestFile("compare_known"));
+    ASSERT_TRUE(FileComparator::compareFiles(known, infoFor("compare_known")));
+    ASSERT_FALSE(FileComparator::compareFiles(known, infoFor("compare_missing_b")));
+    fs::remove("compare_known");
+}
+
+TEST(FileComparatorCompareManyTests, TestPartitionsIntoClasses) {
+    const std::string dir = "compare_many";
+    fs::create_directories(dir);
+    const std::string big(20000, 'x');
+    std::string tail = big;
+    tail.back() = 'y';
+    std::string front = big;
+    front.front() = 'y';
+    std::ofstream(dir + "/big1") << big;
+    std::ofstream(dir + "/big2") << big;
+    fs::create_hard_link(dir + "/big1", dir + "/big1-link");
+    std::ofstream(dir + "/tail") << tail;
+    std::ofstream(dir + "/front") << front;
+    std::ofstream(dir + "/small1") << "small";
+    std::ofstream(dir + "/small2") << "small";
+    std::ofstream(dir + "/other") << "other";
+    std::ofstream(dir + "/empty1");
+    std::ofstream(dir + "/empty2");
+    std::ofstream(dir + "/alone") << "a size of its own";
+
+    std::vector<FileComparator::FileInfo> files;
+    for (const char* name : {"big1", "tail", "small1", "big2", "empty1", "missing", "front", "big1-link", "other",
+                             "small2", "alone", "empty2"}) {
+        files.push_back(infoFor(dir + "/" + name));
+    }
+    FileComparator::clearDigestMemo();
+    const auto classes = FileComparator::compareMany(files);
+    const std::vector<std::vector<std::size_t>> expected{
+        {0, 3, 7}, {1}, {2, 9}, {4, 11}, {5}, {6}, {8}, {10},
+    };
+    ASSERT_EQ(classes, expected);
+
+    // Agrees with pairwise comparison.
+    for (const auto& members : classes) {
+        for (std::size_t i = 1; i < members.size(); ++i) {
+            ASSERT_TRUE(FileComparator::compareFiles(files[members[0]], files[members[i]]));
+        }
+    }
+    ASSERT_TRUE(FileComparator::compareMany({}).empty());
+
+    fs::remove_all(dir);
+}
@@ -0,0 +1,88 @@
+#include "Dedupe.hpp"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+    FileComparator::DuplicateGroup makeGroup(const std::vector<std::string>& paths) {
+        FileComparator::DuplicateGroup group{fs::file_size(paths.front()), "", {}};
+        for (const auto& path : paths) {
+            group.files.push_back(FileComparator::FileInfo{path, fs::path(path).filename().string(),
+                                                           group.size, ""});
+        }
+        return group;
+    }
+}
+
+TEST(FileComparatorDedupeTests, TestHardlinkDedupe) {
+    const std::string testDir = "dedupe_hardlink";
+    fs::create_directories(testDir);
+    std::ofstream(testDir + "/a.txt") << "Duplicate payload";
+    std::ofstream(testDir + "/b.txt") << "Duplicate payload";
+    std::ofstream(testDir + "/c.txt") << "Duplicate payload";
+
+    FileComparator::DedupeOptions options;
+    options.method = FileComparator::DedupeMethod::Hardlink;
+    auto result = FileComparator::dedupeGroup(
+        makeGroup({testDir + "/a.txt", testDir + "/b.txt", testDir + "/c.txt"}), options);
+
+    ASSERT_EQ(result.filesLinked, 2);
+    ASSERT_EQ(result.bytesReclaimed, 2 * fs::file_size(testDir + "/a.txt"));
+    ASSERT_TRUE(fs::equivalent(testDir + "/a.txt", testDir + "/b.txt"));
+    ASSERT_TRUE(fs::equivalent(testDir + "/a.txt", testDir + "/c.txt"));
+    ASSERT_EQ(std::distance(fs::directory_iterator(testDir), fs::directory_iterator()), 3);
+
+    fs::remove_all(testDir);
+}
+
+TEST(FileComparatorDedupeTests, TestReflinkFallsBackOrClones) {
+    const std::string testDir = "dedupe_reflink";
+    fs::create_directories(testDir);
+    std::ofstream(testDir + "/a.bin") << "Cloneable payload";
+    std::ofstream(testDir + "/b.bin") << "Cloneable payload";
+
+    auto result = FileComparator::dedupeGroupAsync(
+        makeGroup({testDir + "/a.bin", testDir + "/b.bin"})).get();
+
+    ASSERT_EQ(result.filesLinked, 1);
+    ASSERT_EQ(result.failed, 0);
+    std::ifstream in(testDir + "/b.bin");
+    std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    ASSERT_EQ(content, "Cloneable payload");
+
+    fs::remove_all(testDir);
+}
+
+TEST(FileComparatorDedupeTests, TestChangedFileIsSkipped) {
+    const std::string testDir = "dedupe_changed";
+    fs::create_directories(testDir);
+    std::ofstream(testDir + "/a.txt") << "Original text";
+    std::ofstream(testDir + "/b.txt") << "Original text";
+    auto group = makeGroup({testDir + "/a.txt", testDir + "/b.txt"});
+    std::ofstream(testDir + "/b.txt") << "Modified text";
+
+    FileComparator::DedupeOptions options;
+    options.method = FileComparator::DedupeMethod::Hardlink;
+    auto result = FileComparator::dedupeGroup(group, options);
+
+    ASSERT_EQ(result.filesLinked, 0);
+    ASSERT_EQ(result.skipped, 1);
+    ASSERT_FALSE(fs::equivalent(testDir + "/a.txt", testDir + "/b.txt"));
+
+    fs::remove_all(testDir);
+}
+
+TEST(FileComparatorDedupeTests, TestAlreadyLinkedIsSkipped) {
+    const std::string testDir = "dedupe_linked";
+    fs::create_directories(testDir);
+    std::ofstream(testDir + "/a.txt") << "Shared";
+    fs::create_hard_link(testDir + "/a.txt", testDir + "/b.txt");
+
+    auto result = FileComparator::dedupeGroup(makeGroup({testDir + "/a.txt", testDir + "/b.txt"}));
+    ASSERT_EQ(result.filesLinked, 0);
+    ASSERT_EQ(result.skipped, 1);
+
+    fs::remove_all(testDir);
+}
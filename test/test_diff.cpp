@@ -0,0 +1,94 @@
+#include "TreeDiff.hpp"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <map>
+
+namespace fs = std::filesystem;
+using FileComparator::DiffStatus;
+
+namespace {
+    std::map<std::string, DiffStatus> runDiff(const std::string& left, const std::string& right,
+                                              FileComparator::DiffOptions options = {}) {
+        std::map<std::string, DiffStatus> result;
+        for (const auto& entry : FileComparator::diffTrees(left, right, options)) {
+            result[entry.path] = entry.status;
+        }
+        return result;
+    }
+}
+
+TEST(FileComparatorDiffTests, TestCompareRelativePathsIsComponentWise) {
+    ASSERT_LT(FileComparator::compareRelativePaths("a/b", "a.txt"), 0);
+    ASSERT_GT(FileComparator::compareRelativePaths("a.txt", "a/b"), 0);
+    ASSERT_LT(FileComparator::compareRelativePaths("a", "a/b"), 0);
+    ASSERT_EQ(FileComparator::compareRelativePaths("x/y", "x/y"), 0);
+}
+
+TEST(FileComparatorDiffTests, TestClassifiesEveryPath) {
+    const std::string left = "diff_left";
+    const std::string right = "diff_right";
+    fs::create_directories(left + "/sub");
+    fs::create_directories(right + "/sub");
+    std::ofstream(left + "/only_left.txt") << "L";
+    std::ofstream(right + "/only_right.txt") << "R";
+    std::ofstream(left + "/sub/same.txt") << "Same content";
+    std::ofstream(right + "/sub/same.txt") << "Same content";
+    std::ofstream(left + "/changed.txt") << "Before";
+    std::ofstream(right + "/changed.txt") << "After!";
+    fs::last_write_time(right + "/changed.txt",
+        fs::last_write_time(left + "/changed.txt") + std::chrono::seconds(5));
+    std::ofstream(left + "/resized.txt") << "Short";
+    std::ofstream(right + "/resized.txt") << "Much longer";
+
+    auto result = runDiff(left, right);
+    ASSERT_EQ(result.size(), 5);
+    ASSERT_EQ(result["only_left.txt"], DiffStatus::OnlyLeft);
+    ASSERT_EQ(result["only_right.txt"], DiffStatus::OnlyRight);
+    ASSERT_EQ(result["sub/same.txt"], DiffStatus::Same);
+    ASSERT_EQ(result["changed.txt"], DiffStatus::Different);
+    ASSERT_EQ(result["resized.txt"], DiffStatus::Different);
+
+    fs::remove_all(left);
+    fs::remove_all(right);
+}
+
+TEST(FileComparatorDiffTests, TestMtimeShortCircuitAndChecksum) {
+    const std::string left = "diff_mtime_left";
+    const std::string right = "diff_mtime_right";
+    fs::create_directories(left);
+    fs::create_directories(right);
+    std::ofstream(left + "/file.txt") << "AAAA";
+    std::ofstream(right + "/file.txt") << "BBBB";
+    auto mtime = fs::last_write_time(left + "/file.txt");
+    fs::last_write_time(right + "/file.txt", mtime);
+
+    ASSERT_EQ(runDiff(left, right)["file.txt"], DiffStatus::Same);
+
+    FileComparator::DiffOptions options;
+    options.checksum = true;
+    ASSERT_EQ(runDiff(left, right, options)["file.txt"], DiffStatus::Different);
+
+    fs::remove_all(left);
+    fs::remove_all(right);
+}
+
+TEST(FileComparatorDiffTests, TestOutputIsSorted) {
+    const std::string left = "diff_sorted_left";
+    const std::string right = "diff_sorted_right";
+    fs::create_directories(left + "/a");
+    fs::create_directories(right);
+    std::ofstream(left + "/a/inner.txt") << "x";
+    std::ofstream(left + "/a.txt") << "x";
+    std::ofstream(right + "/b.txt") << "x";
+    std::ofstream(right + "/a.txt") << "x";
+
+    std::vector<std::string> paths;
+    for (const auto& entry : FileComparator::diffTrees(left, right)) {
+        paths.push_back(entry.path);
+    }
+    ASSERT_EQ(paths, (std::vector<std::string>{"a/inner.txt", "a.txt", "b.txt"}));
+
+    fs::remove_all(left);
+    fs::remove_all(right);
+}
@@ -0,0 +1,84 @@
+#include "FileComparator.hpp"
+#include "Errors.hpp"
+#include "Hashing.hpp"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+TEST(FileComparatorErrorsTests, TestRecordAggregatesByOperationAndErrno) {
+    using FileComparator::Errors::Operation;
+    FileComparator::Errors::clear();
+    for (int i = 0; i < 10; ++i) {
+        FileComparator::Errors::record(Operation::Stat, EACCES, "denied/" + std::to_string(i));
+    }
+    FileComparator::Errors::record(Operation::Stat, ENOENT, "gone");
+    FileComparator::Errors::record(Operation::Open, EACCES, "locked");
+
+    const auto errors = FileComparator::Errors::summary();
+    ASSERT_EQ(errors.size(), 3);
+    ASSERT_EQ(errors[0].operation, Operation::Stat);
+    ASSERT_EQ(errors[0].error, EACCES);
+    ASSERT_EQ(errors[0].count, 10);
+    ASSERT_EQ(errors[0].samples.size(), FileComparator::Errors::MAX_SAMPLES);
+    ASSERT_EQ(errors[0].samples[0], "denied/0");
+    ASSERT_EQ(FileComparator::Errors::total(), 12);
+
+    std::ostringstream report;
+    FileComparator::Errors::writeReport(report);
+    ASSERT_EQ(report.str().rfind("12 errors while scanning", 0), 0) << report.str();
+    ASSERT_NE(report.str().find("10 x stat: Permission denied, e.g. denied/0, denied/1, denied/2\n"),
+              std::string::npos) << report.str();
+
+    std::ostringstream records;
+    FileComparator::Errors::writeRecords(records);
+    ASSERT_NE(records.str().find("{\"kind\":\"error\",\"operation\":\"open\",\"errno\":13,"
+                                 "\"message\":\"Permission denied\",\"count\":1,\"samples\":[\"locked\"]}\n"),
+              std::string::npos) << records.str();
+
+    FileComparator::Errors::clear();
+    ASSERT_EQ(FileComparator::Errors::total(), 0);
+    std::ostringstream empty;
+    FileComparator::Errors::writeReport(empty);
+    ASSERT_TRUE(empty.str().empty());
+}
+
+TEST(FileComparatorErrorsTests, TestUnreadableFilesAreRecordedNotThrown) {
+    FileComparator::Errors::clear();
+    ASSERT_FALSE(FileComparator::digestFile("errors_missing_file"));
+    fs::create_directory("errors_not_a_directory_parent");
+    std::ofstream("errors_not_a_directory_parent/file.txt") << "content";
+    // A root that is a file rather than a directory.
+    for (const auto& group : FileComparator::groupByContent({"errors_not_a_directory_parent/file.txt"})) {
+        (void)group;
+    }
+    fs::remove_all("errors_not_a_directory_parent");
+
+    const auto errors = FileComparator::Errors::summary();
+    ASSERT_EQ(errors.size(), 2);
+    bool open = false;
+    bool directory = false;
+    for (const auto& error : errors) {
+        open |= error.operation == FileComparator::Errors::Operation::Open && error.error == ENOENT &&
+                error.samples[0] == "errors_missing_file";
+        directory |= error.operation == FileComparator::Errors::Operation::OpenDirectory && error.error == ENOTDIR;
+    }
+    ASSERT_TRUE(open);
+    ASSERT_TRUE(directory);
+    FileComparator::Errors::clear();
+}
+
+TEST(FileComparatorErrorsTests, TestSymlinkLoopEndsWithoutErrors) {
+    const std::string testDir = "errors_symlink_loop";
+    fs::create_directories(testDir + "/sub");
+    std::ofstream(testDir + "/sub/file.txt") << "content";
+    fs::create_directory_symlink("..", testDir + "/sub/up");
+    FileComparator::Errors::clear();
+
+    auto files = FileComparator::scanDirectory(testDir);
+    fs::remove_all(testDir);
+    ASSERT_EQ(files.size(), 1);
+    ASSERT_EQ(FileComparator::Errors::total(), 0);
+}
@@ -0,0 +1,120 @@
+#include "Estimate.hpp"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+    // 40 sizes held by a pair of copies, 40 by a pair that differs, and a
+    // few files with a size of their own.
+    void makeEstimateTree(const std::string& root) {
+        fs::create_directories(root + "/a");
+        fs::create_directories(root + "/b");
+        for (int i = 1; i <= 40; ++i) {
+            const std::string name = "/same" + std::to_string(i);
+            std::ofstream(root + "/a" + name) << std::string(i * 100, 'x');
+            std::ofstream(root + "/b" + name) << std::string(i * 100, 'x');
+        }
+        for (int i = 1; i <= 40; ++i) {
+            const std::string name = "/differ" + std::to_string(i);
+            std::ofstream(root + "/a" + name) << std::string(i * 100 + 50, 'y');
+            std::ofstream(root + "/b" + name) << std::string(i * 100 + 50, 'z');
+        }
+        std::ofstream(root + "/a/alone") << std::string(99999, 'u');
+        std::ofstream(root + "/b/alone") << std::string(77777, 'u');
+    }
+
+    constexpr std::uint64_t SAME_BYTES = 100 * 40 * 41 / 2;
+    constexpr std::uint64_t DIFFER_BYTES = SAME_BYTES + 50 * 40;
+}
+
+TEST(FileComparatorEstimateTests, TestFullSampleIsExact) {
+    const std::string root = "estimate_full";
+    makeEstimateTree(root);
+
+    FileComparator::EstimateOptions options;
+    options.sampleFraction = 1;
+    auto estimate = FileComparator::estimateDuplicates({root}, options);
+    ASSERT_EQ(estimate.files, 162);
+    ASSERT_EQ(estimate.candidateClasses, 80);
+    ASSERT_EQ(estimate.candidateBytes, SAME_BYTES + DIFFER_BYTES);
+    ASSERT_EQ(estimate.sampledClasses, 80);
+    ASSERT_DOUBLE_EQ(estimate.duplicateBytes, SAME_BYTES);
+    ASSERT_DOUBLE_EQ(estimate.lower, SAME_BYTES);
+    ASSERT_DOUBLE_EQ(estimate.upper, SAME_BYTES);
+
+    std::ostringstream out;
+    FileComparator::writeEstimate(out, estimate);
+    ASSERT_NE(out.str().find("Estimated duplicate bytes"), std::string::npos);
+
+    fs::remove_all(root);
+}
+
+TEST(FileComparatorEstimateTests, TestSampleIntervalIsBounded) {
+    const std::string root = "estimate_sample";
+    makeEstimateTree(root);
+
+    FileComparator::EstimateOptions options;
+    options.sampleFraction = 0.1;
+    for (std::uint64_t seed = 1; seed <= 5; ++seed) {
+        options.seed = seed;
+        auto estimate = FileComparator::estimateDuplicates({root}, options);
+        ASSERT_LT(estimate.sampledClasses, 80);
+        ASSERT_LT(estimate.hashedBytes, 2 * (SAME_BYTES + DIFFER_BYTES));
+        ASSERT_LE(estimate.lower, estimate.duplicateBytes);
+        ASSERT_LE(estimate.duplicateBytes, estimate.upper);
+        ASSERT_GE(estimate.lower, 0);
+        ASSERT_LE(estimate.upper, static_cast<double>(estimate.candidateBytes));
+    }
+
+    fs::remove_all(root);
+}
+
+TEST(FileComparatorEstimateTests, TestBudgetIsNeverExceeded) {
+    const std::string root = "estimate_budget";
+    makeEstimateTree(root);
+    // A stratum of its own holding one class far larger than the budget.
+    std::ofstream(root + "/a/huge") << std::string(1 << 20, 'h');
+    std::ofstream(root + "/b/huge") << std::string(1 << 20, 'h');
+
+    FileComparator::EstimateOptions options;
+    options.sampleFraction = 0.2;
+    for (std::uint64_t seed = 1; seed <= 5; ++seed) {
+        options.seed = seed;
+        auto estimate = FileComparator::estimateDuplicates({root}, options);
+        ASSERT_LE(estimate.hashedBytes, estimate.budgetBytes);
+        ASSERT_EQ(estimate.unsampledStrata, 1);
+        ASSERT_EQ(estimate.unsampledBytes, 1 << 20);
+        ASSERT_GE(estimate.upper, estimate.lower + (1 << 20));
+        ASSERT_LE(estimate.lower, estimate.duplicateBytes);
+        ASSERT_LE(estimate.duplicateBytes, estimate.upper);
+
+        std::ostringstream out;
+        FileComparator::writeEstimate(out, estimate);
+        ASSERT_NE(out.str().find("had no size cheap enough to sample"), std::string::npos);
+    }
+
+    fs::remove_all(root);
+}
+
+TEST(FileComparatorEstimateTests, TestMinSizeAndEmptyTree) {
+    const std::string root = "estimate_empty";
+    fs::create_directories(root);
+
+    auto estimate = FileComparator::estimateDuplicates({root});
+    ASSERT_EQ(estimate.files, 0);
+    ASSERT_EQ(estimate.candidateBytes, 0);
+    ASSERT_DOUBLE_EQ(estimate.duplicateBytes, 0);
+
+    makeEstimateTree(root);
+    FileComparator::EstimateOptions options;
+    options.sampleFraction = 1;
+    options.minSize = 3000;
+    estimate = FileComparator::estimateDuplicates({root}, options);
+    ASSERT_EQ(estimate.files, 2 * (11 + 11) + 2);
+    ASSERT_DOUBLE_EQ(estimate.duplicateBytes, SAME_BYTES - 100 * 29 * 30 / 2);
+
+    fs::remove_all(root);
+}
@@ -0,0 +1,64 @@
+#include "ExternalGrouping.hpp"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <set>
+
+namespace fs = std::filesystem;
+
+namespace {
+    // Groups as (size, hash, sorted paths), independent of yield order.
+    std::set<std::tuple<size_t, std::string, std::vector<std::string>>>
+    normalise(FileComparator::Generator<FileComparator::DuplicateGroup> groups) {
+        std::set<std::tuple<size_t, std::string, std::vector<std::string>>> result;
+        for (const auto& group : groups) {
+            std::vector<std::string> paths;
+            for (const auto& file : group.files) {
+                paths.push_back(file.path);
+            }
+            std::sort(paths.begin(), paths.end());
+            result.emplace(group.size, group.hash, std::move(paths));
+        }
+        return result;
+    }
+}
+
+TEST(FileComparatorExternalGroupingTests, TestParseByteSize) {
+    ASSERT_EQ(FileComparator::parseByteSize("4096"), 4096);
+    ASSERT_EQ(FileComparator::parseByteSize("512K"), 512 * 1024);
+    ASSERT_EQ(FileComparator::parseByteSize("64m"), 64 * 1024 * 1024);
+    ASSERT_EQ(FileComparator::parseByteSize("2G"), std::size_t{2} << 30);
+    ASSERT_FALSE(FileComparator::parseByteSize(""));
+    ASSERT_FALSE(FileComparator::parseByteSize("M"));
+    ASSERT_FALSE(FileComparator::parseByteSize("12MB"));
+    ASSERT_FALSE(FileComparator::parseByteSize("-1"));
+}
+
+TEST(FileComparatorExternalGroupingTests, TestSpilledRunsMatchInMemoryGrouping) {
+    const std::string testDir = "external_spill";
+    fs::create_directories(testDir + "/a");
+    fs::create_directories(testDir + "/b");
+    // Enough files that a tiny budget forces many runs and several merge passes.
+    for (int i = 0; i < 600; ++i) {
+        const std::string dir = testDir + (i % 2 ? "/a/" : "/b/");
+        std::ofstream(dir + "file" + std::to_string(i) + ".txt") << "content " << (i % 150);
+    }
+    std::ofstream(testDir + "/empty1.txt");
+    std::ofstream(testDir + "/empty2.txt");
+    std::ofstream(testDir + "/alone.txt") << "a size nothing else has";
+    fs::create_hard_link(testDir + "/a/file1.txt", testDir + "/link.txt");
+
+    FileComparator::ExternalOptions options;
+    options.memoryBudget = 4096;
+    options.tempDirectory = ".";
+    auto external = normalise(FileComparator::groupByContentExternal({testDir}, options));
+    auto inMemory = normalise(FileComparator::groupByContent({testDir}));
+
+    ASSERT_EQ(external, inMemory);
+    ASSERT_EQ(external.size(), 152);
+    for (const auto& entry : fs::directory_iterator(".")) {
+        ASSERT_EQ(entry.path().filename().string().rfind("fs2-spill-", 0), std::string::npos);
+    }
+
+    fs::remove_all(testDir);
+}
@@ -0,0 +1,59 @@
+#include "FileComparator.hpp"
+#include "FileTable.hpp"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+namespace fs = std::filesystem;
+using FileComparator::FileTable;
+using FileComparator::RowId;
+
+TEST(FileComparatorFileTableTests, TestRadixSortMatchesStableSort) {
+    std::mt19937_64 rng(42);
+    std::vector<std::uint64_t> column(5000);
+    for (auto& value : column) {
+        // Few distinct high bytes, so some passes are skipped and ties are common.
+        value = rng() % 1000 + (rng() % 3 << 40);
+    }
+    std::vector<RowId> rows(column.size());
+    for (RowId i = 0; i < rows.size(); ++i) rows[i] = i;
+    auto expected = rows;
+    std::stable_sort(expected.begin(), expected.end(), [&](RowId a, RowId b) { return column[a] < column[b]; });
+
+    FileComparator::radixSortRows(rows, column);
+    ASSERT_EQ(rows, expected);
+}
+
+TEST(FileComparatorFileTableTests, TestRowsBySizeKeepDigests) {
+    FileTable table;
+    table.append(0, 20, 1, 1, 0);
+    table.append(1, 10, 1, 2, 0);
+    table.append(2, 20, 1, 3, 0);
+    table.append(3, 10, 1, 4, 0);
+    table.setDigest(0, 9);
+    table.setDigest(1, 5);
+    table.setDigest(2, 3);
+    table.setDigest(3, 5);
+
+    ASSERT_EQ(table.rowsBySize(), (std::vector<RowId>{1, 3, 0, 2}));
+    ASSERT_EQ(table.digestState(0), FileComparator::DigestState::Hashed);
+}
+
+TEST(FileComparatorFileTableTests, TestHardlinksGroupedWithoutRehash) {
+    const std::string testDir = "table_hardlinks";
+    fs::create_directories(testDir);
+    std::ofstream(testDir + "/a.txt") << "Linked content";
+    fs::create_hard_link(testDir + "/a.txt", testDir + "/b.txt");
+    std::ofstream(testDir + "/c.txt") << "Linked content";
+
+    std::vector<FileComparator::DuplicateGroup> groups;
+    for (auto& group : FileComparator::groupByContent({testDir})) {
+        groups.push_back(std::move(group));
+    }
+    ASSERT_EQ(groups.size(), 1);
+    ASSERT_EQ(groups[0].files.size(), 3);
+    ASSERT_EQ(groups[0].hash, FileComparator::computeHashAsync(testDir + "/c.txt").get());
+
+    fs::remove_all(testDir);
+}
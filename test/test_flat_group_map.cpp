@@ -0,0 +1,67 @@
+#include "FlatGroupMap.hpp"
+#include <gtest/gtest.h>
+#include <map>
+
+using FileComparator::FlatGroupMap;
+using FileComparator::GroupKey;
+using FileComparator::RowId;
+
+namespace {
+    std::map<std::pair<std::uint64_t, std::uint64_t>, std::vector<RowId>> toMap(const FlatGroupMap& groups) {
+        std::map<std::pair<std::uint64_t, std::uint64_t>, std::vector<RowId>> result;
+        groups.forEachGroup([&](const GroupKey& key, const std::vector<RowId>& rows) {
+            result[{key.size, key.digest}] = rows;
+        });
+        return result;
+    }
+}
+
+TEST(FileComparatorFlatGroupMapTests, TestGroupsPreserveInsertionOrder) {
+    FlatGroupMap groups;
+    groups.insert(GroupKey{10, 1}, 5);
+    groups.insert(GroupKey{10, 2}, 6);
+    groups.insert(GroupKey{10, 1}, 2);
+    groups.insert(GroupKey{20, 1}, 7);
+    groups.insert(GroupKey{10, 1}, 9);
+
+    ASSERT_EQ(groups.groupCount(), 3);
+    ASSERT_EQ(groups.memberCount(), 5);
+    auto result = toMap(groups);
+    ASSERT_EQ(result[std::pair(10ULL, 1ULL)], (std::vector<RowId>{5, 2, 9}));
+    ASSERT_EQ(result[std::pair(10ULL, 2ULL)], (std::vector<RowId>{6}));
+    ASSERT_EQ(result[std::pair(20ULL, 1ULL)], (std::vector<RowId>{7}));
+}
+
+TEST(FileComparatorFlatGroupMapTests, TestGrowthKeepsChains) {
+    FlatGroupMap groups;
+    for (RowId i = 0; i < 10000; ++i) {
+        groups.insert(GroupKey{i % 1000 % 7, i % 1000}, i);
+    }
+    ASSERT_EQ(groups.memberCount(), 10000);
+    ASSERT_EQ(groups.groupCount(), 1000);
+    groups.forEachGroup([](const GroupKey& key, const std::vector<RowId>& rows) {
+        ASSERT_EQ(rows.size(), 10);
+        for (size_t i = 1; i < rows.size(); ++i) {
+            ASSERT_LT(rows[i - 1], rows[i]);
+            ASSERT_EQ(rows[i] % 1000, key.digest);
+        }
+    });
+}
+
+TEST(FileComparatorFlatGroupMapTests, TestParallelBuildMatchesSerial) {
+    const size_t count = 200000;
+    auto item = [](size_t i) {
+        return std::pair{GroupKey{i % 13, (i * 2654435761ULL) % 5003}, static_cast<RowId>(i)};
+    };
+
+    FlatGroupMap serial;
+    for (size_t i = 0; i < count; ++i) {
+        auto [key, row] = item(i);
+        serial.insert(key, row);
+    }
+    auto parallel = FlatGroupMap::buildParallel(count, item, 8);
+
+    ASSERT_EQ(parallel.groupCount(), serial.groupCount());
+    ASSERT_EQ(parallel.memberCount(), count);
+    ASSERT_EQ(toMap(parallel), toMap(serial));
+}
@@ -0,0 +1,92 @@
+#include "FileComparator.hpp"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+    std::vector<FileComparator::DuplicateGroup> collectGroups(const std::vector<std::string>& dirs) {
+        std::vector<FileComparator::DuplicateGroup> groups;
+        for (auto& group : FileComparator::groupByContent(dirs)) {
+            groups.push_back(std::move(group));
+        }
+        return groups;
+    }
+}
+
+TEST(FileComparatorGroupingTests, TestRenamedDuplicatesAreGrouped) {
+    const std::string testDir = "group_renamed";
+    fs::create_directories(testDir + "/a");
+    fs::create_directories(testDir + "/b");
+    std::ofstream(testDir + "/a/report.txt") << "Quarterly numbers";
+    std::ofstream(testDir + "/b/copy_of_report.txt") << "Quarterly numbers";
+
+    auto groups = collectGroups({testDir});
+    ASSERT_EQ(groups.size(), 1);
+    ASSERT_EQ(groups[0].files.size(), 2);
+    ASSERT_FALSE(groups[0].hash.empty());
+
+    fs::remove_all(testDir);
+}
+
+TEST(FileComparatorGroupingTests, TestSameNameDifferentContentNotGrouped) {
+    const std::string testDir = "group_same_name";
+    fs::create_directories(testDir + "/a");
+    fs::create_directories(testDir + "/b");
+    std::ofstream(testDir + "/a/notes.txt") << "Version A";
+    std::ofstream(testDir + "/b/notes.txt") << "Version B";
+
+    auto groups = collectGroups({testDir});
+    ASSERT_EQ(groups.size(), 2);
+    for (const auto& group : groups) {
+        ASSERT_EQ(group.files.size(), 1);
+    }
+
+    fs::remove_all(testDir);
+}
+
+TEST(FileComparatorGroupingTests, TestGroupsAcrossDirectories) {
+    const std::string dir1 = "group_dir1";
+    const std::string dir2 = "group_dir2";
+    fs::create_directories(dir1);
+    fs::create_directories(dir2);
+    std::ofstream(dir1 + "/one.txt") << "Shared";
+    std::ofstream(dir2 + "/two.txt") << "Shared";
+    std::ofstream(dir2 + "/three.txt") << "Longer unique content";
+
+    auto groups = collectGroups({dir1, dir2});
+    ASSERT_EQ(groups.size(), 2);
+    // Groups stream out ordered by size.
+    ASSERT_EQ(groups[0].files.size(), 2);
+    ASSERT_EQ(groups[1].files.size(), 1);
+    ASSERT_EQ(groups[1].files[0].name, "three.txt");
+
+    fs::remove_all(dir1);
+    fs::remove_all(dir2);
+}
+
+TEST(FileComparatorGroupingTests, TestOverlappingRootsNotSelfDuplicates) {
+    const std::string testDir = "group_overlap";
+    fs::create_directories(testDir + "/sub");
+    std::ofstream(testDir + "/sub/file.txt") << "Only once";
+
+    auto groups = collectGroups({testDir, testDir + "/sub"});
+    ASSERT_EQ(groups.size(), 1);
+    ASSERT_EQ(groups[0].files.size(), 1);
+
+    fs::remove_all(testDir);
+}
+
+TEST(FileComparatorGroupingTests, TestSymlinksNotGrouped) {
+    const std::string testDir = "group_symlinks";
+    fs::create_directories(testDir);
+    std::ofstream(testDir + "/target.txt") << "Target content";
+    fs::create_symlink("target.txt", testDir + "/link.txt");
+
+    auto groups = collectGroups({testDir});
+    ASSERT_EQ(groups.size(), 1);
+    ASSERT_EQ(groups[0].files[0].name, "target.txt");
+
+    fs::remove_all(testDir);
+}
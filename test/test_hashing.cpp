@@ -0,0 +1,106 @@
+#include "Hashing.hpp"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+TEST(FileComparatorHashingTests, TestUpdateZerosMatchesZeroBytes) {
+    for (std::uint64_t count : {0, 1, 2, 7, 4096, 100003}) {
+        FileComparator::Fnv1a folded;
+        folded.update("x", 1);
+        folded.updateZeros(count);
+        const std::string zeros(count, '\0');
+        FileComparator::Fnv1a streamed;
+        streamed.update("x", 1);
+        streamed.update(zeros.data(), zeros.size());
+        ASSERT_EQ(folded.value(), streamed.value()) << count;
+    }
+}
+
+TEST(FileComparatorHashingTests, TestSparseFileDigestMatchesLogicalContent) {
+    // Data extents at 1 MiB and 3 MiB in an 8 MiB file, ending in a hole.
+    const std::string path = "hashing_sparse.img";
+    const std::string data(8192, 'd');
+    const off_t size = 8 << 20;
+    int fd = ::open(path.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(::ftruncate(fd, size), 0);
+    ASSERT_EQ(::pwrite(fd, data.data(), data.size(), 1 << 20), static_cast<ssize_t>(data.size()));
+    ASSERT_EQ(::pwrite(fd, data.data(), 100, 3 << 20), 100);
+    ::close(fd);
+
+    std::string logical(static_cast<std::size_t>(size), '\0');
+    logical.replace(1 << 20, data.size(), data);
+    logical.replace(3 << 20, 100, data.substr(0, 100));
+    const auto digest = FileComparator::digestFile(path);
+    fs::remove(path);
+
+    ASSERT_TRUE(digest);
+    ASSERT_EQ(*digest, FileComparator::calculateDigest(logical.data(), logical.size()));
+}
+
+TEST(FileComparatorHashingTests, TestAllHoleFile) {
+    const std::string path = "hashing_hole.img";
+    int fd = ::open(path.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(::ftruncate(fd, 1 << 20), 0);
+    ::close(fd);
+
+    const std::string logical(1 << 20, '\0');
+    const auto digest = FileComparator::digestFile(path);
+    fs::remove(path);
+
+    ASSERT_TRUE(digest);
+    ASSERT_EQ(*digest, FileComparator::calculateDigest(logical.data(), logical.size()));
+}
+
+TEST(FileComparatorHashingTests, TestTinyFileDigestMatchesDigestFile) {
+    for (std::size_t size : {std::size_t{1}, std::size_t{100}, FileComparator::TINY_FILE_BYTES}) {
+        const std::string path = "hashing_tiny.txt";
+        const std::string content(size, 't');
+        int fd = ::open(path.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+        ASSERT_GE(fd, 0);
+        ASSERT_EQ(::write(fd, content.data(), content.size()), static_cast<ssize_t>(content.size()));
+        ::close(fd);
+
+        ASSERT_EQ(FileComparator::digestTinyFile(AT_FDCWD, path.c_str(), size), FileComparator::digestFile(path))
+            << size;
+        fs::remove(path);
+    }
+}
+
+TEST(FileComparatorHashingTests, TestTinyFileRejectsSizeMismatch) {
+    const std::string path = "hashing_not_tiny.txt";
+    const std::string content(FileComparator::TINY_FILE_BYTES + 1, 'n');
+    int fd = ::open(path.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(::write(fd, content.data(), content.size()), static_cast<ssize_t>(content.size()));
+    ::close(fd);
+
+    ASSERT_FALSE(FileComparator::digestTinyFile(AT_FDCWD, path.c_str(), content.size()));
+    ASSERT_FALSE(FileComparator::digestTinyFile(AT_FDCWD, path.c_str(), FileComparator::TINY_FILE_BYTES));
+    ASSERT_FALSE(FileComparator::digestTinyFile(AT_FDCWD, "hashing_missing.txt", 1));
+    ::truncate(path.c_str(), 10);
+    ASSERT_FALSE(FileComparator::digestTinyFile(AT_FDCWD, path.c_str(), 100));
+    ASSERT_TRUE(FileComparator::digestTinyFile(AT_FDCWD, path.c_str(), 10));
+    fs::remove(path);
+}
+
+TEST(FileComparatorHashingTests, TestHeadDigestCoversFirstBytes) {
+    const std::string path = "hashing_head.txt";
+    std::string content(FileComparator::HEAD_DIGEST_BYTES * 3, 'h');
+    content.back() = 't';
+    int fd = ::open(path.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(::write(fd, content.data(), content.size()), static_cast<ssize_t>(content.size()));
+    ::close(fd);
+
+    ASSERT_EQ(FileComparator::digestFileHead(path),
+              FileComparator::calculateDigest(content.data(), FileComparator::HEAD_DIGEST_BYTES));
+    ASSERT_NE(FileComparator::digestFileHead(path), FileComparator::digestFile(path));
+    fs::resize_file(path, 10);
+    ASSERT_EQ(FileComparator::digestFileHead(path), FileComparator::digestFile(path));
+    fs::remove(path);
+}
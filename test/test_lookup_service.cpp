@@ -0,0 +1,124 @@
+#include "LookupService.hpp"
+#include "Manifest.hpp"
+#include "ReferenceIndex.hpp"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace {
+    FileComparator::DuplicateGroup makeGroup(std::uint64_t size, FileComparator::Digest digest,
+                                             const std::vector<std::string>& paths) {
+        FileComparator::DuplicateGroup group{};
+        group.size = size;
+        group.hash = FileComparator::digestToHex(digest);
+        for (const auto& path : paths) {
+            group.files.push_back(FileComparator::FileInfo{path, fs::path(path).filename().string(), size, group.hash});
+        }
+        return group;
+    }
+
+    // Runs a server on its own thread for the life of the scope.
+    class ServerThread {
+    public:
+        ServerThread(const std::string& data, const std::string& socket)
+            : server(data, socket, FileComparator::LookupServerOptions{std::chrono::milliseconds(20)}),
+              thread([this]() { server.run(); }) {}
+        ~ServerThread() {
+            server.stop();
+            thread.join();
+        }
+
+        FileComparator::LookupServer server;
+
+    private:
+        std::thread thread;
+    };
+}
+
+TEST(FileComparatorLookupServiceTests, TestAnswersBatchedQueries) {
+    const std::string manifest = "lookup_answers.fs2m";
+    const std::string socket = "lookup_answers.sock";
+    FileComparator::ManifestWriter writer({"/data"});
+    writer.add(makeGroup(100, 0x1111, {"/data/a", "/data/b"}));
+    writer.add(makeGroup(200, 0x2222, {"/data/c"}));
+    writer.write(manifest);
+
+    {
+        ServerThread serving(manifest, socket);
+        FileComparator::LookupClient client(socket);
+        ASSERT_EQ(client.contains({0x1111, 0x3333, 0x2222}), (std::vector<bool>{true, false, true}));
+        ASSERT_TRUE(client.contains({}).empty());
+
+        auto paths = client.paths({0x1111, 0x3333, 0x2222});
+        ASSERT_EQ(paths.size(), 3);
+        std::sort(paths[0].begin(), paths[0].end());
+        ASSERT_EQ(paths[0], (std::vector<std::string>{"/data/a", "/data/b"}));
+        ASSERT_TRUE(paths[1].empty());
+        ASSERT_EQ(paths[2], (std::vector<std::string>{"/data/c"}));
+
+        std::vector<FileComparator::Digest> many(1000, 0x4444);
+        many[999] = 0x2222;
+        const auto known = client.contains(many);
+        ASSERT_EQ(std::count(known.begin(), known.end(), true), 1);
+        ASSERT_TRUE(known[999]);
+
+        // A second connection is served alongside the first.
+        FileComparator::LookupClient other(socket);
+        ASSERT_EQ(other.contains({0x2222}), std::vector<bool>{true});
+        ASSERT_EQ(client.contains({0x1111}), std::vector<bool>{true});
+    }
+    ASSERT_FALSE(fs::exists(socket));
+    ASSERT_THROW(FileComparator::LookupClient{socket}, FileComparator::LookupError);
+
+    fs::remove(manifest);
+}
+
+TEST(FileComparatorLookupServiceTests, TestReloadsReplacedData) {
+    const std::string data = "lookup_reload.idx";
+    const std::string socket = "lookup_reload.sock";
+    FileComparator::ReferenceIndexWriter first;
+    first.add(10, 1, 0xaaaa, "/reference/old");
+    first.write(data);
+
+    ServerThread serving(data, socket);
+    FileComparator::LookupClient client(socket);
+    ASSERT_EQ(client.contains({0xaaaa, 0xbbbb}), (std::vector<bool>{true, false}));
+
+    FileComparator::ReferenceIndexWriter second;
+    second.add(10, 1, 0xbbbb, "/reference/new");
+    second.write(data);
+    for (int i = 0; i < 200 && serving.server.loads() < 2; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_EQ(serving.server.loads(), 2);
+    ASSERT_EQ(client.contains({0xaaaa, 0xbbbb}), (std::vector<bool>{false, true}));
+    ASSERT_EQ(client.paths({0xbbbb})[0], std::vector<std::string>{"/reference/new"});
+
+    // A broken replacement leaves the last good version in service.
+    std::ofstream(data + ".tmp") << "garbage";
+    fs::rename(data + ".tmp", data);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ(client.contains({0xbbbb}), std::vector<bool>{true});
+
+    fs::remove(data);
+}
+
+TEST(FileComparatorLookupServiceTests, TestRefusesBadSetup) {
+    const std::string socket = "lookup_bad.sock";
+    ASSERT_THROW(FileComparator::LookupServer("lookup_missing.fs2m", socket), FileComparator::LookupError);
+    std::ofstream("lookup_bad.data") << "neither format";
+    ASSERT_THROW(FileComparator::LookupServer("lookup_bad.data", socket), FileComparator::LookupError);
+    ASSERT_FALSE(fs::exists(socket));
+
+    FileComparator::ReferenceIndexWriter writer;
+    writer.write("lookup_bad.idx");
+    FileComparator::LookupServer server("lookup_bad.idx", socket);
+    ASSERT_THROW(FileComparator::LookupServer("lookup_bad.idx", socket), FileComparator::LookupError);
+
+    fs::remove("lookup_bad.data");
+    fs::remove("lookup_bad.idx");
+}
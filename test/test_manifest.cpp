@@ -0,0 +1,93 @@
+#include "Manifest.hpp"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+    std::vector<FileComparator::DuplicateGroup> collect(FileComparator::Generator<FileComparator::DuplicateGroup> groups) {
+        std::vector<FileComparator::DuplicateGroup> result;
+        for (auto& group : groups) {
+            result.push_back(std::move(group));
+        }
+        std::sort(result.begin(), result.end(), [](const auto& a, const auto& b) {
+            return a.files.front().path < b.files.front().path;
+        });
+        return result;
+    }
+}
+
+TEST(FileComparatorManifestTests, TestRoundTripMatchesScan) {
+    const std::string testDir = "manifest_scan";
+    fs::create_directories(testDir + "/a/deep");
+    fs::create_directories(testDir + "/b");
+    std::ofstream(testDir + "/a/one.txt") << "Shared content";
+    std::ofstream(testDir + "/b/two.txt") << "Shared content";
+    std::ofstream(testDir + "/a/deep/three.txt") << "Other content!";
+    std::ofstream(testDir + "/a/alone.txt") << "Nothing else is this long";
+    std::ofstream(testDir + "/empty1");
+    std::ofstream(testDir + "/b/empty2");
+
+    FileComparator::ManifestWriter writer;
+    for (const auto& group : FileComparator::groupByContent({testDir})) {
+        writer.add(group);
+    }
+    ASSERT_EQ(writer.fileCount(), 6);
+    writer.write(testDir + ".fsm");
+
+    auto scanned = collect(FileComparator::groupByContent({testDir}));
+    fs::remove_all(testDir);   // queries must not need the tree
+
+    FileComparator::Manifest manifest(testDir + ".fsm");
+    ASSERT_EQ(manifest.fileCount(), 6);
+    auto loaded = collect(manifest.groups());
+    ASSERT_EQ(loaded.size(), scanned.size());
+    for (size_t i = 0; i < loaded.size(); ++i) {
+        ASSERT_EQ(loaded[i].size, scanned[i].size);
+        ASSERT_EQ(loaded[i].hash, scanned[i].hash);
+        ASSERT_EQ(loaded[i].files.size(), scanned[i].files.size());
+        for (size_t j = 0; j < loaded[i].files.size(); ++j) {
+            ASSERT_EQ(loaded[i].files[j].path, scanned[i].files[j].path);
+            ASSERT_EQ(loaded[i].files[j].name, scanned[i].files[j].name);
+            ASSERT_EQ(loaded[i].files[j].hash, scanned[i].files[j].hash);
+        }
+    }
+
+    fs::remove(testDir + ".fsm");
+}
+
+TEST(FileComparatorManifestTests, TestAbsolutePathsAndIndexOrder) {
+    FileComparator::ManifestWriter writer;
+    writer.add({9, "0000000000000002", {{"/x/b", "b", 9, ""}, {"/c", "c", 9, ""}}});
+    writer.add({3, "", {{"rel", "rel", 3, ""}}});
+    writer.add({9, "0000000000000001", {{"/x/y/a", "a", 9, ""}}});
+    writer.write("manifest_paths.fsm");
+
+    FileComparator::Manifest manifest("manifest_paths.fsm");
+    ASSERT_EQ(manifest.path(0), "/x/b");
+    ASSERT_EQ(manifest.path(1), "/c");
+    ASSERT_EQ(manifest.path(2), "rel");
+    ASSERT_EQ(manifest.path(3), "/x/y/a");
+    ASSERT_FALSE(manifest.hashed(2));
+    ASSERT_EQ(manifest.indexed(0), 2);
+    ASSERT_EQ(manifest.indexed(1), 3);
+    ASSERT_EQ(manifest.indexed(2), 0);
+    ASSERT_EQ(manifest.indexed(3), 1);
+
+    fs::remove("manifest_paths.fsm");
+}
+
+TEST(FileComparatorManifestTests, TestCorruptFilesRejected) {
+    std::ofstream("manifest_bad.fsm") << "definitely not a manifest, just some text";
+    ASSERT_THROW(FileComparator::Manifest("manifest_bad.fsm"), FileComparator::ManifestError);
+    ASSERT_THROW(FileComparator::Manifest("manifest_missing.fsm"), FileComparator::ManifestError);
+
+    FileComparator::ManifestWriter writer;
+    writer.add({5, "", {{"file", "file", 5, ""}}});
+    writer.write("manifest_bad.fsm");
+    fs::resize_file("manifest_bad.fsm", fs::file_size("manifest_bad.fsm") - 8);
+    ASSERT_THROW(FileComparator::Manifest("manifest_bad.fsm"), FileComparator::ManifestError);
+
+    fs::remove("manifest_bad.fsm");
+}
@@ -0,0 +1,77 @@
+#include "ManifestCompare.hpp"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <map>
+
+namespace fs = std::filesystem;
+
+namespace {
+    void saveManifest(const std::string& root, const std::string& path) {
+        FileComparator::GroupingOptions options;
+        options.hashUnique = true;
+        FileComparator::ManifestWriter writer({root});
+        for (const auto& group : FileComparator::groupByContent({root}, options)) {
+            writer.add(group);
+        }
+        writer.write(path);
+    }
+}
+
+TEST(FileComparatorManifestCompareTests, TestMissingMovedAndShared) {
+    fs::create_directories("cross_a/docs");
+    fs::create_directories("cross_b/docs");
+    fs::create_directories("cross_b/archive");
+    std::ofstream("cross_a/docs/kept.txt") << "kept in place";
+    std::ofstream("cross_b/docs/kept.txt") << "kept in place";
+    std::ofstream("cross_a/docs/plan.txt") << "moved elsewhere";
+    std::ofstream("cross_b/archive/plan-2024.txt") << "moved elsewhere";
+    std::ofstream("cross_a/only-a.txt") << "only on host a";
+    std::ofstream("cross_b/only-b.txt") << "only on host b!";
+    saveManifest("cross_a", "cross_a.fsm");
+    saveManifest("cross_b", "cross_b.fsm");
+    fs::remove_all("cross_a");
+    fs::remove_all("cross_b");
+
+    FileComparator::Manifest a("cross_a.fsm");
+    FileComparator::Manifest b("cross_b.fsm");
+    std::map<std::string, FileComparator::CrossGroup> byFirstPath;
+    for (auto& group : FileComparator::compareManifests({&a, &b})) {
+        byFirstPath[group.files.front().path] = std::move(group);
+    }
+
+    ASSERT_EQ(byFirstPath.size(), 4);
+    ASSERT_EQ(byFirstPath["cross_a/docs/kept.txt"].status, FileComparator::CrossStatus::Shared);
+    ASSERT_EQ(byFirstPath["cross_a/docs/kept.txt"].files.size(), 2);
+    ASSERT_EQ(byFirstPath["cross_a/docs/plan.txt"].status, FileComparator::CrossStatus::Moved);
+    ASSERT_EQ(byFirstPath["cross_a/docs/plan.txt"].files[1].path, "cross_b/archive/plan-2024.txt");
+    ASSERT_EQ(byFirstPath["cross_a/only-a.txt"].status, FileComparator::CrossStatus::Missing);
+    ASSERT_EQ(byFirstPath["cross_b/only-b.txt"].status, FileComparator::CrossStatus::Missing);
+    ASSERT_EQ(byFirstPath["cross_b/only-b.txt"].files.front().manifest, 1);
+
+    fs::remove("cross_a.fsm");
+    fs::remove("cross_b.fsm");
+}
+
+TEST(FileComparatorManifestCompareTests, TestUnhashedFilesSkipped) {
+    FileComparator::ManifestWriter left;
+    left.add({7, "", {{"l/unique", "unique", 7, ""}}});
+    left.add({4, "00000000000000aa", {{"l/x", "x", 4, ""}, {"l/y", "y", 4, ""}}});
+    left.write("cross_left.fsm");
+    FileComparator::ManifestWriter right;
+    right.add({4, "00000000000000aa", {{"r/x", "x", 4, ""}}});
+    right.write("cross_right.fsm");
+
+    FileComparator::Manifest a("cross_left.fsm");
+    FileComparator::Manifest b("cross_right.fsm");
+    std::vector<FileComparator::CrossGroup> groups;
+    for (auto& group : FileComparator::compareManifests({&a, &b})) {
+        groups.push_back(std::move(group));
+    }
+    ASSERT_EQ(groups.size(), 1);
+    ASSERT_EQ(groups[0].status, FileComparator::CrossStatus::Shared);
+    ASSERT_EQ(groups[0].files.size(), 3);
+
+    fs::remove("cross_left.fsm");
+    fs::remove("cross_right.fsm");
+}
@@ -0,0 +1,66 @@
+#include "FileComparator.hpp"
+#include "FileMetadata.hpp"
+#include "Hashing.hpp"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+namespace fs = std::filesystem;
+
+TEST(FileComparatorMetadataTests, TestScanCarriesOneStatPerEntry) {
+    const std::string testDir = "metadata_scan";
+    fs::create_directories(testDir);
+    std::ofstream(testDir + "/file.txt") << std::string(10000, 'x');
+    fs::create_hard_link(testDir + "/file.txt", testDir + "/link.txt");
+    fs::create_symlink("file.txt", testDir + "/symlink.txt");
+
+    auto files = FileComparator::scanDirectory(testDir);
+    std::sort(files.begin(), files.end(), [](const auto& a, const auto& b) { return a.name < b.name; });
+    ASSERT_EQ(files.size(), 3);
+
+    struct stat info;
+    ASSERT_EQ(::stat((testDir + "/file.txt").c_str(), &info), 0);
+    const auto& file = files[0].metadata;
+    ASSERT_EQ(files[0].name, "file.txt");
+    ASSERT_EQ(file.type, FileComparator::FileType::Regular);
+    ASSERT_EQ(file.size, 10000);
+    ASSERT_EQ(file.inode, info.st_ino);
+    ASSERT_EQ(file.device, info.st_dev);
+    ASSERT_EQ(file.links, 2);
+    ASSERT_EQ(file.blocks, static_cast<std::uint64_t>(info.st_blocks));
+    ASSERT_EQ(file.mtime, static_cast<std::int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec);
+    ASSERT_EQ(files[1].metadata.inode, file.inode);
+    ASSERT_EQ(files[0].hash, files[1].hash);
+
+    ASSERT_EQ(files[2].name, "symlink.txt");
+    ASSERT_EQ(files[2].metadata.type, FileComparator::FileType::Symlink);
+    ASSERT_EQ(files[2].size, std::string("file.txt").size());
+    ASSERT_EQ(files[2].hash, FileComparator::digestToHex(FileComparator::calculateDigest("file.txt", 8)));
+
+    fs::remove_all(testDir);
+}
+
+TEST(FileComparatorMetadataTests, TestKnownMetadataHashesLikeAPath) {
+    const std::string testDir = "metadata_hash";
+    fs::create_directories(testDir);
+    std::ofstream(testDir + "/file.txt") << std::string(100000, 'y');
+
+    FileComparator::FileMetadata metadata;
+    ASSERT_EQ(FileComparator::readMetadata(AT_FDCWD, (testDir + "/file.txt").c_str(), metadata), 0);
+    ASSERT_TRUE(metadata.known());
+    ASSERT_FALSE(metadata.sparse());
+    ASSERT_EQ(FileComparator::digestFile(testDir + "/file.txt", metadata),
+              FileComparator::digestFile(testDir + "/file.txt"));
+
+    FileComparator::FileInfo byHand{testDir + "/file.txt", "file.txt", 100000, ""};
+    FileComparator::FileInfo scanned = byHand;
+    scanned.metadata = metadata;
+    ASSERT_EQ(FileComparator::computeHashAsync(byHand).get(), FileComparator::computeHashAsync(scanned).get());
+
+    FileComparator::FileMetadata missing;
+    ASSERT_EQ(FileComparator::readMetadata(AT_FDCWD, (testDir + "/missing").c_str(), missing), ENOENT);
+    fs::remove_all(testDir);
+}
@@ -0,0 +1,77 @@
+#include "FileComparator.hpp"
+#include "Metrics.hpp"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <regex>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+    // Collects for one test and leaves metrics off and empty for the tests
+    // after it, even when an assertion returns early.
+    struct MetricsSession {
+        explicit MetricsSession(bool trace) {
+            FileComparator::Metrics::reset();
+            FileComparator::Metrics::enable(trace);
+        }
+        ~MetricsSession() {
+            FileComparator::Metrics::disable();
+            FileComparator::Metrics::reset();
+        }
+    };
+}
+
+TEST(FileComparatorMetricsTests, TestSummaryAndTraceCoverPipeline) {
+    fs::create_directories("metrics_scan/sub");
+    std::ofstream("metrics_scan/a.txt") << "same content";
+    std::ofstream("metrics_scan/sub/b.txt") << "same content";
+    std::ofstream("metrics_scan/sub/c.txt") << std::string(100000, 'c');
+    std::ofstream("metrics_scan/sub/d.txt") << std::string(100000, 'd');
+
+    MetricsSession session(true);
+    std::size_t groups = 0;
+    for (const auto& group : FileComparator::groupByContent({"metrics_scan"})) {
+        groups += !group.files.empty();
+    }
+    fs::remove_all("metrics_scan");
+    ASSERT_EQ(groups, 3);
+
+    std::ostringstream summary;
+    FileComparator::Metrics::writeSummary(summary);
+    for (const char* stage : {"traverse", "read", "hash", "queue-wait", "task", "group"}) {
+        ASSERT_NE(summary.str().find(stage), std::string::npos) << stage;
+    }
+    ASSERT_TRUE(std::regex_search(summary.str(), std::regex("files hashed +4\n"))) << summary.str();
+    ASSERT_TRUE(std::regex_search(summary.str(), std::regex("bytes read +200024\n"))) << summary.str();
+
+    std::ostringstream trace;
+    FileComparator::Metrics::writeTrace(trace);
+    ASSERT_EQ(trace.str().rfind("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", 0), 0);
+    ASSERT_NE(trace.str().find("\"name\":\"walk\",\"cat\":\"traverse\",\"ph\":\"X\""), std::string::npos);
+    ASSERT_NE(trace.str().find("\"name\":\"digestFile\""), std::string::npos);
+    ASSERT_NE(trace.str().find("\"name\":\"task\""), std::string::npos);
+}
+
+TEST(FileComparatorMetricsTests, TestDisabledByDefault) {
+    ASSERT_FALSE(FileComparator::Metrics::enabled());
+    FileComparator::Metrics::Span span(FileComparator::Metrics::Stage::Hash, "idle");
+}
+
+TEST(FileComparatorMetricsTests, TestResetClearsCollectedData) {
+    {
+        MetricsSession session(true);
+        FileComparator::Metrics::count(FileComparator::Metrics::Counter::FilesHashed, 7);
+        FileComparator::Metrics::Span span(FileComparator::Metrics::Stage::Hash, "probe");
+    }
+    ASSERT_FALSE(FileComparator::Metrics::enabled());
+    FileComparator::Metrics::count(FileComparator::Metrics::Counter::FilesHashed, 5);
+
+    std::ostringstream summary;
+    FileComparator::Metrics::writeSummary(summary);
+    ASSERT_TRUE(std::regex_search(summary.str(), std::regex("files hashed +0\n"))) << summary.str();
+    std::ostringstream trace;
+    FileComparator::Metrics::writeTrace(trace);
+    ASSERT_EQ(trace.str().find("\"name\":\"probe\""), std::string::npos);
+}
@@ -0,0 +1,50 @@
+#include "PathTable.hpp"
+#include <gtest/gtest.h>
+
+using FileComparator::PathId;
+using FileComparator::PathTable;
+
+TEST(FileComparatorPathTableTests, TestRebuildsFullPaths) {
+    PathTable table;
+    PathId root = table.addRoot("data");
+    PathId dir = table.add(root, "photos");
+    PathId file = table.add(dir, "cat.jpg");
+
+    ASSERT_EQ(table.fullPath(file), "data/photos/cat.jpg");
+    ASSERT_EQ(table.name(file), "cat.jpg");
+    ASSERT_EQ(table.parent(file), dir);
+    ASSERT_EQ(table.parent(root), PathTable::NO_PARENT);
+}
+
+TEST(FileComparatorPathTableTests, TestRootWithTrailingSlash) {
+    PathTable table;
+    PathId root = table.addRoot("/mnt/data/");
+    ASSERT_EQ(table.fullPath(table.add(root, "file")), "/mnt/data/file");
+    ASSERT_EQ(table.fullPath(table.addRoot("/")), "/");
+}
+
+TEST(FileComparatorPathTableTests, TestSharedPrefixStoredOnce) {
+    PathTable table;
+    PathId dir = table.add(table.addRoot("a-rather-long-root-directory-name"), "nested-subdirectory");
+    for (int i = 0; i < 10000; ++i) {
+        table.add(dir, "f" + std::to_string(i));
+    }
+    ASSERT_EQ(table.size(), 10002);
+    ASSERT_EQ(table.fullPath(dir + 1), "a-rather-long-root-directory-name/nested-subdirectory/f0");
+    // 16-byte entries plus short names, far below 10000 full path strings.
+    ASSERT_LT(table.memoryUsage(), 10002 * 64);
+}
+
+TEST(FileComparatorPathTableTests, TestDeepAndLongNames) {
+    PathTable table;
+    PathId current = table.addRoot("r");
+    std::string expected = "r";
+    for (int i = 0; i < 300; ++i) {
+        current = table.add(current, "d");
+        expected += "/d";
+    }
+    std::string longName(100000, 'x');
+    current = table.add(current, longName);
+    expected += "/" + longName;
+    ASSERT_EQ(table.fullPath(current), expected);
+}
@@ -0,0 +1,44 @@
+#include "FileComparator.hpp"
+#include "Progress.hpp"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+TEST(FileComparatorProgressTests, TestStatusFileReportsFinalCounts) {
+    fs::create_directories("progress_scan/sub");
+    std::ofstream("progress_scan/a.txt") << std::string(10000, 'a');
+    std::ofstream("progress_scan/sub/b.txt") << std::string(10000, 'a');
+    std::ofstream("progress_scan/sub/c.txt") << std::string(10000, 'c');
+    std::ofstream("progress_scan/tiny1.txt") << "tiny";
+    std::ofstream("progress_scan/tiny2.txt") << "tiny";
+
+    {
+        FileComparator::Progress::Options options;
+        options.interval = std::chrono::milliseconds(10);
+        options.statusFile = "progress_status.json";
+        FileComparator::Progress::Reporter reporter(options);
+        ASSERT_TRUE(FileComparator::Progress::active());
+        for (const auto& group : FileComparator::groupByContent({"progress_scan"})) {
+            (void)group;
+            FileComparator::Progress::add(FileComparator::Progress::Counter::Groups);
+        }
+    }
+    ASSERT_FALSE(FileComparator::Progress::active());
+    fs::remove_all("progress_scan");
+
+    std::ifstream in("progress_status.json");
+    std::stringstream status;
+    status << in.rdbuf();
+    fs::remove("progress_status.json");
+    const std::string text = status.str();
+    ASSERT_NE(text.find("\"phase\":\"done\""), std::string::npos) << text;
+    ASSERT_NE(text.find("\"entries\":6,"), std::string::npos) << text;
+    ASSERT_NE(text.find("\"files_queued\":5,"), std::string::npos) << text;
+    ASSERT_NE(text.find("\"files_hashed\":5,"), std::string::npos) << text;
+    ASSERT_NE(text.find("\"bytes_queued\":30008,"), std::string::npos) << text;
+    ASSERT_NE(text.find("\"bytes_hashed\":30008,"), std::string::npos) << text;
+    ASSERT_NE(text.find("\"groups\":3,"), std::string::npos) << text;
+}
@@ -0,0 +1,103 @@
+#include "ReferenceIndex.hpp"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <map>
+
+namespace fs = std::filesystem;
+
+namespace {
+    void writeFile(const std::string& path, const std::string& content) {
+        std::ofstream(path, std::ios::binary) << content;
+    }
+}
+
+TEST(FileComparatorReferenceIndexTests, TestWriterKeepsFirstPathPerContent) {
+    const std::string path = "reference_writer.idx";
+    FileComparator::ReferenceIndexWriter writer;
+    for (std::uint64_t i = 0; i < 10000; ++i) {
+        writer.add(i % 100, i, i * 7, "file" + std::to_string(i));
+    }
+    writer.add(5, 5, 35, "again");
+    writer.write(path);
+
+    FileComparator::ReferenceIndex index(path);
+    ASSERT_EQ(index.size(), 10000);
+    ASSERT_EQ(index.find(5, 5, 35), "file5");
+    ASSERT_EQ(index.find(5, 5, 36), "");
+    ASSERT_EQ(index.find(6, 5, 35), "");
+    for (std::uint64_t i = 0; i < 10000; ++i) ASSERT_TRUE(index.mayContain(i % 100, i));
+
+    std::size_t passed = 0;
+    for (std::uint64_t i = 10000; i < 20000; ++i) {
+        if (index.mayContain(i % 100, i)) ++passed;
+    }
+    ASSERT_LT(passed, 300);
+
+    fs::remove(path);
+}
+
+TEST(FileComparatorReferenceIndexTests, TestBuildAndCheck) {
+    const std::string root = "reference_tree";
+    const std::string index_path = "reference_tree.idx";
+    fs::create_directories(root + "/store/deep");
+    fs::create_directories(root + "/drop");
+    const std::string big(20000, 'b');
+    std::string same_head = big;
+    same_head.back() = 'c';
+    writeFile(root + "/store/deep/big", big);
+    writeFile(root + "/store/copy-of-big", big);
+    writeFile(root + "/store/small", "small content");
+    writeFile(root + "/store/empty", "");
+    writeFile(root + "/drop/big", big);
+    writeFile(root + "/drop/small", "small content");
+    writeFile(root + "/drop/empty", "");
+    writeFile(root + "/drop/same-head", same_head);
+    writeFile(root + "/drop/other", "not in the store");
+
+    ASSERT_EQ(FileComparator::buildReferenceIndex({root + "/store"}, index_path), 3);
+    FileComparator::ReferenceIndex index(index_path);
+
+    std::map<std::string, FileComparator::ReferenceResult> results;
+    auto summary = FileComparator::checkReference(index, {root + "/drop"}, [&](const std::string& path,
+                                                                             const FileComparator::ReferenceResult& result) {
+        results[fs::path(path).filename().string()] = result;
+    });
+    ASSERT_EQ(summary.files, 5);
+    ASSERT_EQ(summary.present, 3);
+    ASSERT_EQ(summary.unreadable, 0);
+    ASSERT_EQ(summary.filtered + summary.absent, 2);
+
+    ASSERT_EQ(results["big"].outcome, FileComparator::ReferenceOutcome::Present);
+    ASSERT_TRUE(results["big"].fullyHashed);
+    ASSERT_TRUE(results["big"].reference == root + "/store/deep/big" ||
+                results["big"].reference == root + "/store/copy-of-big");
+    ASSERT_EQ(results["small"].outcome, FileComparator::ReferenceOutcome::Present);
+    ASSERT_FALSE(results["small"].fullyHashed);
+    ASSERT_EQ(results["small"].reference, root + "/store/small");
+    ASSERT_EQ(results["empty"].outcome, FileComparator::ReferenceOutcome::Present);
+    // Shares size and head with a stored file, so only the full digest tells.
+    ASSERT_EQ(results["same-head"].outcome, FileComparator::ReferenceOutcome::Absent);
+    ASSERT_TRUE(results["same-head"].fullyHashed);
+    ASSERT_NE(results["other"].outcome, FileComparator::ReferenceOutcome::Present);
+    ASSERT_FALSE(results["other"].fullyHashed);
+
+    fs::remove_all(root);
+    fs::remove(index_path);
+}
+
+TEST(FileComparatorReferenceIndexTests, TestRejectsInvalidFiles) {
+    const std::string path = "reference_invalid.idx";
+    ASSERT_THROW(FileComparator::ReferenceIndex("reference_missing.idx"), FileComparator::ReferenceIndexError);
+
+    writeFile(path, "not an index");
+    ASSERT_THROW(FileComparator::ReferenceIndex{path}, FileComparator::ReferenceIndexError);
+
+    FileComparator::ReferenceIndexWriter writer;
+    writer.add(1, 2, 3, "x");
+    writer.write(path);
+    fs::resize_file(path, fs::file_size(path) - 8);
+    ASSERT_THROW(FileComparator::ReferenceIndex{path}, FileComparator::ReferenceIndexError);
+
+    fs::remove(path);
+}
@@ -0,0 +1,143 @@
+#include "Scan.hpp"
+#include "Errors.hpp"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <latch>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace {
+    void makeScanTree(const std::string& root) {
+        fs::create_directories(root + "/a");
+        fs::create_directories(root + "/b");
+        std::ofstream(root + "/a/one.txt") << std::string(5000, '1');
+        std::ofstream(root + "/b/one.txt") << std::string(5000, '1');
+        std::ofstream(root + "/b/one-again.txt") << std::string(5000, '1');
+        std::ofstream(root + "/a/two.txt") << std::string(20, '2');
+        std::ofstream(root + "/b/two.txt") << std::string(20, '2');
+        std::ofstream(root + "/a/unique.txt") << std::string(7000, 'u');
+        std::ofstream(root + "/b/same-size.txt") << std::string(5000, 's');
+    }
+}
+
+TEST(FileComparatorScanTests, TestCallbackReceivesEveryGroupAndSummary) {
+    const std::string root = "scan_callback";
+    makeScanTree(root);
+
+    std::vector<FileComparator::DuplicateGroup> seen;
+    auto summary = FileComparator::scanGroups({root}, [&](FileComparator::DuplicateGroup&& group) {
+        seen.push_back(std::move(group));
+        return true;
+    });
+    ASSERT_EQ(seen.size(), 4);
+    ASSERT_EQ(summary.groups, 4);
+    ASSERT_EQ(summary.files, 7);
+    ASSERT_EQ(summary.duplicateGroups, 2);
+    ASSERT_EQ(summary.reclaimableBytes, 2 * 5000 + 20);
+    ASSERT_EQ(summary.errors, 0);
+    ASSERT_FALSE(summary.stopped);
+
+    FileComparator::ScanOptions options;
+    options.grouping.duplicatesOnly = true;
+    options.grouping.minSize = 100;
+    seen.clear();
+    summary = FileComparator::scanGroups({root}, [&](FileComparator::DuplicateGroup&& group) {
+        seen.push_back(std::move(group));
+        return true;
+    }, options);
+    ASSERT_EQ(seen.size(), 1);
+    ASSERT_EQ(seen[0].size, 5000);
+    ASSERT_EQ(seen[0].files.size(), 3);
+    ASSERT_EQ(summary.reclaimableBytes, 2 * 5000);
+
+    fs::remove_all(root);
+}
+
+TEST(FileComparatorScanTests, TestCallbackCanStopTheScan) {
+    const std::string root = "scan_stop";
+    makeScanTree(root);
+
+    std::size_t calls = 0;
+    auto summary = FileComparator::scanGroups({root}, [&](FileComparator::DuplicateGroup&&) {
+        ++calls;
+        return false;
+    });
+    ASSERT_EQ(calls, 1);
+    ASSERT_EQ(summary.groups, 1);
+    ASSERT_TRUE(summary.stopped);
+
+    fs::remove_all(root);
+}
+
+TEST(FileComparatorScanTests, TestStoppingSkipsQueuedHashing) {
+    const std::string root = "scan_cancel";
+    fs::create_directories(root);
+    std::ofstream(root + "/smallest.txt") << "u";   // a class of one, yielded without waiting
+    for (int i = 0; i < 500; ++i) {
+        std::ofstream(root + "/pair" + std::to_string(i) + ".txt") << std::string(100 + i / 2, 'p');
+    }
+
+    // Hold every pool thread so the scan's hash batches stay queued.
+    const std::size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::vector<std::future<void>> blockers;
+    for (std::size_t i = 0; i < threads; ++i) {
+        blockers.push_back(FileComparator::sharedThreadPool().enqueue([released] { released.wait(); }));
+    }
+
+    FileComparator::Errors::clear();
+    auto summary = FileComparator::scanGroups({root}, [](FileComparator::DuplicateGroup&&) { return false; });
+    ASSERT_TRUE(summary.stopped);
+    // A batch that still read a file would now record an open error.
+    fs::remove_all(root);
+    release.set_value();
+    for (auto& blocker : blockers) blocker.get();
+
+    // Every thread reaching the latch means every task queued before it ran.
+    std::latch drained(static_cast<std::ptrdiff_t>(threads));
+    std::vector<std::future<void>> barriers;
+    for (std::size_t i = 0; i < threads; ++i) {
+        barriers.push_back(FileComparator::sharedThreadPool().enqueue([&drained] { drained.arrive_and_wait(); }));
+    }
+    for (auto& barrier : barriers) barrier.get();
+    ASSERT_EQ(FileComparator::Errors::total(), 0);
+}
+
+TEST(FileComparatorScanTests, TestEnginesAgreeOnDuplicates) {
+    const std::string root = "scan_engines";
+    makeScanTree(root);
+
+    auto duplicateSets = [&](const FileComparator::ScanOptions& options) {
+        std::vector<std::vector<std::string>> sets;
+        for (auto& group : FileComparator::scanGroups({root}, options)) {
+            std::vector<std::string> paths;
+            for (const auto& file : group.files) paths.push_back(file.path);
+            std::sort(paths.begin(), paths.end());
+            sets.push_back(std::move(paths));
+        }
+        std::sort(sets.begin(), sets.end());
+        return sets;
+    };
+    FileComparator::ScanOptions inMemory;
+    inMemory.grouping.duplicatesOnly = true;
+    FileComparator::ScanOptions external = inMemory;
+    external.memoryBudget = 1 << 20;
+    FileComparator::ScanOptions sharded = inMemory;
+    sharded.shards = 2;
+
+    const auto expected = duplicateSets(inMemory);
+    ASSERT_EQ(expected.size(), 2);
+    ASSERT_EQ(duplicateSets(external), expected);
+    ASSERT_EQ(duplicateSets(sharded), expected);
+
+    FileComparator::ScanOptions invalid = external;
+    invalid.grouping.scanArchives = true;
+    ASSERT_THROW(FileComparator::scanGroups({root}, invalid), std::invalid_argument);
+
+    fs::remove_all(root);
+}
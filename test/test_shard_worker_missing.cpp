@@ -0,0 +1,10 @@
+#include "Sharding.hpp"
+#include <gtest/gtest.h>
+#include <stdexcept>
+
+// Built into a binary whose main never calls runShardWorker.
+TEST(FileComparatorShardWorkerMissingTests, TestShardedScanThrows) {
+    FileComparator::ShardOptions options;
+    options.workers = 2;
+    ASSERT_THROW(FileComparator::groupByContentSharded({"."}, options), std::logic_error);
+}
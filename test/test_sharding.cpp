@@ -0,0 +1,185 @@
+#include "Sharding.hpp"
+#include "ShardProtocol.hpp"
+#include <gtest/gtest.h>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <set>
+
+namespace fs = std::filesystem;
+using FileComparator::DuplicateGroup;
+
+namespace {
+    std::set<std::tuple<size_t, std::string, std::vector<std::string>>>
+    normalise(FileComparator::Generator<DuplicateGroup> groups) {
+        std::set<std::tuple<size_t, std::string, std::vector<std::string>>> result;
+        for (const auto& group : groups) {
+            std::vector<std::string> paths;
+            for (const auto& file : group.files) {
+                paths.push_back(file.path);
+            }
+            std::sort(paths.begin(), paths.end());
+            result.emplace(group.size, group.hash, std::move(paths));
+        }
+        return result;
+    }
+
+    std::string tarEntry(const std::string& name, const std::string& content) {
+        std::string header(512, '\0');
+        std::memcpy(header.data(), name.data(), name.size());
+        std::snprintf(header.data() + 100, 8, "%07o", 0644);
+        std::snprintf(header.data() + 124, 12, "%011o", static_cast<unsigned>(content.size()));
+        header[156] = '0';
+        std::memcpy(header.data() + 257, "ustar", 6);
+        std::memcpy(header.data() + 263, "00", 2);
+        std::memset(header.data() + 148, ' ', 8);
+        unsigned sum = 0;
+        for (unsigned char c : header) sum += c;
+        std::snprintf(header.data() + 148, 8, "%06o", sum);
+        return header + content + std::string((512 - content.size() % 512) % 512, '\0');
+    }
+}
+
+TEST(FileComparatorShardingTests, TestFramesSurviveArbitraryChunking) {
+    DuplicateGroup duplicate{17, "00000000deadbeef", {{"a/x.txt", "x.txt", 17, "00000000deadbeef"},
+                                                      {"b/y.txt", "y.txt", 17, "00000000deadbeef"}}};
+    DuplicateGroup unique{3, "", {{"plain", "plain", 3, ""}}};
+    std::string stream;
+    FileComparator::encodeGroup(duplicate, stream);
+    FileComparator::encodeGroup(unique, stream);
+    FileComparator::encodeError({FileComparator::Errors::Operation::Read, EIO, 12, {"bad/sector"}}, stream);
+    FileComparator::encodeEnd(stream);
+
+    FileComparator::FrameDecoder decoder;
+    std::vector<FileComparator::Frame> frames;
+    for (char byte : stream) {
+        decoder.feed(&byte, 1);
+        while (auto frame = decoder.next()) {
+            frames.push_back(std::move(*frame));
+        }
+    }
+    ASSERT_FALSE(decoder.hasPartialFrame());
+    ASSERT_EQ(frames.size(), 4);
+    ASSERT_EQ(frames[0].type, FileComparator::FrameType::Group);
+    ASSERT_EQ(frames[0].group.hash, duplicate.hash);
+    ASSERT_EQ(frames[0].group.files.size(), 2);
+    ASSERT_EQ(frames[0].group.files[1].path, "b/y.txt");
+    ASSERT_EQ(frames[0].group.files[1].name, "y.txt");
+    ASSERT_EQ(frames[1].group.size, 3);
+    ASSERT_TRUE(frames[1].group.hash.empty());
+    ASSERT_EQ(frames[2].type, FileComparator::FrameType::Error);
+    ASSERT_EQ(frames[2].error.operation, FileComparator::Errors::Operation::Read);
+    ASSERT_EQ(frames[2].error.error, EIO);
+    ASSERT_EQ(frames[2].error.count, 12);
+    ASSERT_EQ(frames[2].error.samples, std::vector<std::string>{"bad/sector"});
+    ASSERT_EQ(frames[3].type, FileComparator::FrameType::End);
+}
+
+TEST(FileComparatorShardingTests, TestMalformedFrameRejected) {
+    DuplicateGroup group{5, "", {{"file", "file", 5, ""}}};
+    std::string stream;
+    FileComparator::encodeGroup(group, stream);
+    stream[1] = static_cast<char>(stream[1] - 1);   // payload one byte short
+
+    FileComparator::FrameDecoder decoder;
+    decoder.feed(stream.data(), stream.size());
+    ASSERT_THROW(decoder.next(), FileComparator::ProtocolError);
+
+    FileComparator::FrameDecoder unknown;
+    const char frame[] = {9, 0, 0, 0, 0};
+    unknown.feed(frame, sizeof(frame));
+    ASSERT_THROW(unknown.next(), FileComparator::ProtocolError);
+}
+
+TEST(FileComparatorShardingTests, TestLargeGroupSpansFrames) {
+    DuplicateGroup group{9, "00000000deadbeef", {}};
+    for (int i = 0; i < 100; ++i) {
+        const std::string name = "file" + std::to_string(i);
+        group.files.push_back({"dir/" + name, name, 9, group.hash});
+    }
+    std::string stream;
+    FileComparator::encodeGroup(group, stream, 256);
+    FileComparator::encodeEnd(stream);
+    ASSERT_GT(stream.size(), 2 * 256);
+
+    FileComparator::FrameDecoder decoder;
+    std::vector<FileComparator::Frame> frames;
+    for (std::size_t i = 0; i < stream.size(); i += 7) {
+        decoder.feed(stream.data() + i, std::min<std::size_t>(7, stream.size() - i));
+        while (auto frame = decoder.next()) {
+            frames.push_back(std::move(*frame));
+        }
+    }
+    ASSERT_FALSE(decoder.hasPartialFrame());
+    ASSERT_EQ(frames.size(), 2);
+    ASSERT_EQ(frames[0].group.hash, group.hash);
+    ASSERT_EQ(frames[0].group.files.size(), 100);
+    ASSERT_EQ(frames[0].group.files[99].path, "dir/file99");
+    ASSERT_EQ(frames[1].type, FileComparator::FrameType::End);
+
+    DuplicateGroup tooLong{1, "", {{std::string(300, 'p'), "p", 1, ""}}};
+    ASSERT_THROW(FileComparator::encodeGroup(tooLong, stream, 256), FileComparator::ProtocolError);
+}
+
+TEST(FileComparatorShardingTests, TestShardedMatchesSingleProcess) {
+    const std::string testDir = "sharded_scan";
+    fs::create_directories(testDir + "/a");
+    fs::create_directories(testDir + "/b");
+    for (int i = 0; i < 200; ++i) {
+        const std::string dir = testDir + (i % 2 ? "/a/" : "/b/");
+        std::ofstream(dir + "file" + std::to_string(i) + ".txt") << std::string(i % 37, 'x') << (i % 50);
+    }
+
+    FileComparator::ShardOptions options;
+    options.workers = 3;
+    auto sharded = normalise(FileComparator::groupByContentSharded({testDir}, options));
+    auto single = normalise(FileComparator::groupByContent({testDir}));
+    ASSERT_EQ(sharded, single);
+
+    std::set<size_t> shards;
+    for (const auto& group : sharded) {
+        shards.insert(FileComparator::shardOfSize(std::get<0>(group), options.workers));
+    }
+    ASSERT_EQ(shards.size(), 3);
+
+    fs::remove_all(testDir);
+}
+
+TEST(FileComparatorShardingTests, TestEachArchiveReadByOneShard) {
+    const std::string testDir = "sharded_archives";
+    fs::create_directories(testDir);
+    std::multiset<std::string> expected;
+    for (int a = 0; a < 6; ++a) {
+        const std::string archive = testDir + "/bundle" + std::to_string(a) + ".tar";
+        std::string tar;
+        for (int m = 0; m < 8; ++m) {
+            const std::string member = "member" + std::to_string(m);
+            tar += tarEntry(member, std::string(10 + 7 * m + a, 'a' + m));
+            expected.insert(archive + "!/" + member);
+        }
+        std::ofstream(archive, std::ios::binary) << tar + std::string(1024, '\0');
+        expected.insert(archive);
+    }
+
+    FileComparator::ShardOptions options;
+    options.workers = 3;
+    options.grouping.scanArchives = true;
+    std::ofstream(testDir + "/broken.tar", std::ios::binary) << tarEntry("cut", std::string(2000, 'c')).substr(0, 900);
+    expected.insert(testDir + "/broken.tar");
+
+    FileComparator::Errors::clear();
+    std::multiset<std::string> listed;
+    for (const auto& group : FileComparator::groupByContentSharded({testDir}, options)) {
+        for (const auto& file : group.files) listed.insert(file.path);
+    }
+    fs::remove_all(testDir);
+    const auto errors = FileComparator::Errors::summary();
+    FileComparator::Errors::clear();
+
+    ASSERT_EQ(listed, expected);
+    // The worker that read the broken archive sent its error to this process.
+    ASSERT_EQ(errors.size(), 1);
+    ASSERT_EQ(errors[0].operation, FileComparator::Errors::Operation::Archive);
+    ASSERT_EQ(errors[0].count, 1);
+    ASSERT_EQ(errors[0].samples, std::vector<std::string>{testDir + "/broken.tar"});
+}
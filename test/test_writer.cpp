@@ -0,0 +1,65 @@
+#include "GroupWriter.hpp"
+#include <gtest/gtest.h>
+#include <sstream>
+
+using FileComparator::DuplicateGroup;
+using FileComparator::FileInfo;
+using FileComparator::GroupWriter;
+using FileComparator::OutputFormat;
+
+TEST(FileComparatorWriterTests, TestParseOutputFormat) {
+    ASSERT_EQ(FileComparator::parseOutputFormat("ndjson"), OutputFormat::Ndjson);
+    ASSERT_EQ(FileComparator::parseOutputFormat("csv"), OutputFormat::Csv);
+    ASSERT_EQ(FileComparator::parseOutputFormat("text"), OutputFormat::Text);
+    ASSERT_FALSE(FileComparator::parseOutputFormat("xml"));
+}
+
+TEST(FileComparatorWriterTests, TestNdjsonDuplicateRecord) {
+    std::ostringstream out;
+    {
+        GroupWriter writer(out, OutputFormat::Ndjson);
+        writer.writeDuplicate(DuplicateGroup{5, "abc", {
+            FileInfo{"a/x.txt", "x.txt", 5, "abc"},
+            FileInfo{"b/\"quoted\"\n.txt", "\"quoted\"\n.txt", 5, "abc"}
+        }});
+    }
+    ASSERT_EQ(out.str(),
+        "{\"kind\":\"duplicate\",\"size\":5,\"hash\":\"abc\","
+        "\"files\":[\"a/x.txt\",\"b/\\\"quoted\\\"\\n.txt\"]}\n");
+}
+
+TEST(FileComparatorWriterTests, TestCsvQuotesFields) {
+    std::ostringstream out;
+    {
+        GroupWriter writer(out, OutputFormat::Csv);
+        writer.writeUnique(FileInfo{"dir/a,b.txt", "a,b.txt", 3, "ff"});
+    }
+    ASSERT_EQ(out.str(), "unique,3,ff,\"dir/a,b.txt\"\n");
+}
+
+TEST(FileComparatorWriterTests, TestNotesOnlyInText) {
+    std::ostringstream text;
+    std::ostringstream json;
+    {
+        GroupWriter textWriter(text, OutputFormat::Text);
+        GroupWriter jsonWriter(json, OutputFormat::Ndjson);
+        textWriter.writeNote("Comparison complete.");
+        jsonWriter.writeNote("Comparison complete.");
+    }
+    ASSERT_EQ(text.str(), "Comparison complete.\n");
+    ASSERT_TRUE(json.str().empty());
+}
+
+TEST(FileComparatorWriterTests, TestBufferFlushesOnlyAtRecordBoundary) {
+    std::ostringstream out;
+    FileComparator::BufferedWriter writer(out, 8);
+    writer.write("0123456789");
+    ASSERT_TRUE(out.str().empty());
+    writer.endRecord();
+    ASSERT_EQ(out.str(), "0123456789");
+    writer.write("abc");
+    writer.endRecord();
+    ASSERT_EQ(out.str(), "0123456789");
+    writer.flush();
+    ASSERT_EQ(out.str(), "0123456789abc");
+}